@@ -0,0 +1,133 @@
+#include "hal/adc.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/rcc.h"
+
+#define ISR_ADRDY (1 << 0)
+#define ISR_CCRDY (1 << 13)
+
+#define CR_ADEN (1 << 0)
+#define CR_ADDIS (1 << 1)
+#define CR_ADSTART (1 << 2)
+#define CR_ADSTP (1 << 4)
+#define CR_ADVREGEN (1 << 28)
+#define CR_ADCAL (1u << 31)
+
+#define CFGR1_DMAEN (1 << 0)
+#define CFGR1_DMACFG (1 << 1)
+#define CFGR1_RES_POS 3
+#define CFGR1_EXTSEL_POS 6
+#define CFGR1_EXTEN_RISING (0b01 << 10)
+#define CFGR1_OVRMOD (1 << 12)
+
+#define CFGR2_OVSE (1 << 0)
+#define CFGR2_OVSR_POS 2
+#define CFGR2_OVSS_POS 5
+#define CFGR2_CKMODE_POS 30
+
+#define SMPR_SMP1_POS 0
+
+static AdcSettings adc_settings;
+static volatile uint32_t adc_overruns;
+
+static void HandleAdcDma(void *context, uint32_t events) {
+    (void)context;
+    if ((events & kDmaHalfTransfer) && (events & kDmaTransferComplete)) {
+        // Both halves finished before we got here, so the first one has already been overwritten.
+        adc_overruns++;
+    }
+    if (!adc_settings.callback) {
+        return;
+    }
+    if (events & kDmaHalfTransfer) {
+        adc_settings.callback(adc_settings.context, adc_settings.buffer, adc_settings.half_length);
+    }
+    if (events & kDmaTransferComplete) {
+        adc_settings.callback(adc_settings.context, adc_settings.buffer + adc_settings.half_length,
+                              adc_settings.half_length);
+    }
+}
+
+static void WaitForVoltageRegulator() {
+    // tADCVREG_STUP is 20 us. Each iteration is at least 3 cycles, so HCLK / 2^15 iterations take
+    // at least 90 us at any clock speed.
+    for (volatile uint32_t i = GetHclkHz() >> 15; i != 0; i--);
+}
+
+void StartAdc(AdcSettings settings) {
+    AdcRegisters *regs = ADC_REGS;
+    SET_BIT(RCC_REGS->apbenr2, RCC_APBENR2_ADCEN);
+
+    // Everything below needs the ADC disabled (ADEN = 0). Stop it before taking the new settings,
+    // so it's the previous DMA channel that gets stopped.
+    if (READ_BIT(regs->cr, CR_ADEN)) {
+        StopAdc();
+    }
+    adc_settings = settings;
+    adc_overruns = 0;
+    uint32_t cfgr2 = (settings.clock << CFGR2_CKMODE_POS);
+    if (settings.oversample) {
+        cfgr2 |= CFGR2_OVSE | (settings.oversample_ratio << CFGR2_OVSR_POS) |
+                 ((settings.oversample_shift & 0xF) << CFGR2_OVSS_POS);
+    }
+    WRITE_REG(regs->cfgr2, cfgr2);
+
+    // Power up the internal voltage regulator and calibrate.
+    SET_BIT(regs->cr, CR_ADVREGEN);
+    WaitForVoltageRegulator();
+    CLEAR_REG(regs->cfgr1);
+    SET_BIT(regs->cr, CR_ADCAL);
+    while (READ_BIT(regs->cr, CR_ADCAL));
+
+    // One scan sequence per rising trigger edge, results streamed by circular DMA. Keep converting
+    // through an overrun rather than stalling the stream.
+    WRITE_REG(regs->cfgr1, (CFGR1_DMAEN | CFGR1_DMACFG | (settings.resolution << CFGR1_RES_POS) |
+                            (settings.trigger << CFGR1_EXTSEL_POS) | CFGR1_EXTEN_RISING |
+                            CFGR1_OVRMOD));
+    WRITE_REG(regs->smpr, (settings.sample_time << SMPR_SMP1_POS));
+    WRITE_REG(regs->isr, ISR_CCRDY);
+    WRITE_REG(regs->chselr, settings.channels);
+    while (!READ_BIT(regs->isr, ISR_CCRDY));
+
+    WRITE_REG(regs->isr, ISR_ADRDY);
+    SET_BIT(regs->cr, CR_ADEN);
+    while (!READ_BIT(regs->isr, ISR_ADRDY));
+
+    DmaSettings dma_settings = {
+        .request = kDmaRequestAdc,
+        .direction = kDmaPeripheralToMemory,
+        .peripheral_width = kDma16Bit,
+        .memory_width = kDma16Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = true,
+        .priority = kDmaPriorityVeryHigh,
+    };
+    ConfigureDma(settings.dma_channel, dma_settings, HandleAdcDma, 0);
+    StartDma(settings.dma_channel, &regs->dr, settings.buffer, 2 * settings.half_length,
+             (kDmaHalfTransfer | kDmaTransferComplete));
+
+    // Arm the ADC. Conversions start on the next trigger edge.
+    SET_BIT(regs->cr, CR_ADSTART);
+}
+
+void StopAdc() {
+    AdcRegisters *regs = ADC_REGS;
+    if (READ_BIT(regs->cr, CR_ADSTART)) {
+        SET_BIT(regs->cr, CR_ADSTP);
+        while (READ_BIT(regs->cr, CR_ADSTART));
+    }
+    StopDma(adc_settings.dma_channel);
+    if (READ_BIT(regs->cr, CR_ADEN)) {
+        SET_BIT(regs->cr, CR_ADDIS);
+        while (READ_BIT(regs->cr, CR_ADEN));
+    }
+}
+
+uint32_t GetAdcOverruns() {
+    return adc_overruns;
+}
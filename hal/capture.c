@@ -0,0 +1,214 @@
+#include "hal/capture.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/timer.h"
+
+#define COUNTER_MASK 0xFFFF
+
+// DMAMUX capture/compare requests, kDmaRequestMemory marks channels without one.
+static DmaRequest CaptureRequest(Timer timer, TimerChannel channel) {
+    switch (timer) {
+        case kTimer1:
+            return kDmaRequestTim1Ch1 + channel;
+        case kTimer2:
+            return kDmaRequestTim2Ch1 + channel;
+        case kTimer3:
+            return kDmaRequestTim3Ch1 + channel;
+        case kTimer16:
+            return (channel == kTimerChannel1) ? kDmaRequestTim16Ch1 : kDmaRequestMemory;
+        case kTimer17:
+            return (channel == kTimerChannel1) ? kDmaRequestTim17Ch1 : kDmaRequestMemory;
+        default:
+            return kDmaRequestMemory;
+    }
+}
+
+// The counter extended to 32 bits with the number of wraps. The update interrupt may be pending
+// behind the one we're running in, so a set update flag with a small count means the wrap happened
+// before the count was read and hasn't been counted yet.
+static uint32_t ExtendedNow(Capture *capture) {
+    TimerRegisters *regs = TIMER_REGS(capture->settings.timer);
+    uint32_t overflows, count, pending;
+    do {
+        overflows = capture->overflows;
+        count = READ_REG(regs->cnt) & COUNTER_MASK;
+        pending = (READ_BIT(regs->sr, kTimerUpdateEvent) && count < (COUNTER_MASK / 2)) ? 1 : 0;
+        // Retry if the update interrupt preempted us and counted the wrap in the meantime.
+    } while (overflows != capture->overflows);
+    return ((overflows + pending) << 16) | count;
+}
+
+static void ProcessBlock(Capture *capture, uint32_t half) {
+    const CaptureSettings *settings = &capture->settings;
+    uint32_t length = settings->half_length;
+    const uint16_t *rise = settings->period_buffer + half * length;
+
+    // Extend the last edge of the block by how long ago it happened. That's less than a counter
+    // wrap as long as this interrupt isn't held off for 65536 ticks.
+    uint32_t now = ExtendedNow(capture);
+    uint32_t last_extended = now - ((now - rise[length - 1]) & COUNTER_MASK);
+
+    CaptureStats stats = {.min_period = UINT32_MAX};
+    uint32_t previous = capture->last_timestamp;
+    uint32_t first = 0;
+    if (!capture->primed) {
+        previous = rise[0];
+        first = 1;
+    }
+    uint32_t sum = 0;
+    for (uint32_t i = first; i < length; i++) {
+        uint32_t period = (rise[i] - previous) & COUNTER_MASK;
+        previous = rise[i];
+        sum += period;
+        if (period < stats.min_period) {
+            stats.min_period = period;
+        }
+        if (period > stats.max_period) {
+            stats.max_period = period;
+        }
+    }
+    stats.periods = length - first;
+    if (capture->primed) {
+        stats.span = last_extended - capture->last_extended;
+        // Each period that overflowed lost a multiple of 65536 ticks from `sum`.
+        stats.overflowed = (stats.span != sum);
+    } else {
+        stats.span = sum;
+    }
+
+    if (settings->measure_duty) {
+        // Both DMA streams start together, so the first falling edge either belongs to the first
+        // rising edge (offset 0), or to the period before it (offset 1). The last falling edge of
+        // the block may not have arrived yet, so only periods 0 to length - 2 are paired.
+        const uint16_t *fall = settings->duty_buffer + half * length;
+        uint32_t offset = (((fall[0] - rise[0]) & COUNTER_MASK) <
+                           ((rise[1] - rise[0]) & COUNTER_MASK)) ? 0 : 1;
+        for (uint32_t i = 0; i + 1 < length; i++) {
+            stats.high_ticks += (fall[i + offset] - rise[i]) & COUNTER_MASK;
+            stats.duty_ticks += (rise[i + 1] - rise[i]) & COUNTER_MASK;
+        }
+    }
+
+    capture->last_timestamp = rise[length - 1];
+    capture->last_extended = last_extended;
+    capture->primed = true;
+    capture->stats = stats;
+    capture->blocks++;
+    if (settings->callback) {
+        settings->callback(settings->context, &capture->stats);
+    }
+}
+
+static void HandleCaptureDma(void *context, uint32_t events) {
+    Capture *capture = context;
+    if (events & kDmaTransferError) {
+        StopCapture(capture);
+        return;
+    }
+    if (events & kDmaHalfTransfer) {
+        ProcessBlock(capture, 0);
+    }
+    if (events & kDmaTransferComplete) {
+        ProcessBlock(capture, 1);
+    }
+}
+
+static void HandleCaptureOverflow(void *context, uint32_t events) {
+    Capture *capture = context;
+    if (events & kTimerUpdateEvent) {
+        capture->overflows++;
+    }
+}
+
+bool StartCapture(Capture *capture, CaptureSettings settings) {
+    TimerChannel duty_channel = settings.channel ^ 1;
+    DmaRequest period_request = CaptureRequest(settings.timer, settings.channel);
+    DmaRequest duty_request = CaptureRequest(settings.timer, duty_channel);
+    if (period_request == kDmaRequestMemory || settings.half_length < 3 ||
+        (settings.measure_duty && duty_request == kDmaRequestMemory)) {
+        return false;
+    }
+    capture->settings = settings;
+    capture->overflows = 0;
+    capture->primed = false;
+    capture->blocks = 0;
+
+    // Free run over the full 16 bit range (TIM2 included) so timestamp differences wrap cleanly.
+    ConfigureTimer(settings.timer, (TimerTiming){.prescaler = settings.prescaler, .reload = 0xFFFF});
+    TimerCaptureSettings rising = {
+        .edge = kTimerRisingEdge, .input = kTimerInputDirect, .filter = settings.filter,
+    };
+    ConfigureTimerCapture(settings.timer, settings.channel, rising);
+    uint32_t dma_requests = (kTimerCc1Dma << settings.channel);
+
+    TimerRegisters *regs = TIMER_REGS(settings.timer);
+    DmaSettings dma_settings = {
+        .request = period_request,
+        .direction = kDmaPeripheralToMemory,
+        .peripheral_width = kDma16Bit,
+        .memory_width = kDma16Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = true,
+        .priority = kDmaPriorityVeryHigh,
+    };
+    ConfigureDma(settings.period_dma, dma_settings, HandleCaptureDma, capture);
+    StartDma(settings.period_dma, &regs->ccr[settings.channel], settings.period_buffer,
+             2 * settings.half_length, (kDmaHalfTransfer | kDmaTransferComplete | kDmaTransferError));
+
+    if (settings.measure_duty) {
+        TimerCaptureSettings falling = {
+            .edge = kTimerFallingEdge, .input = kTimerInputIndirect, .filter = settings.filter,
+        };
+        ConfigureTimerCapture(settings.timer, duty_channel, falling);
+        dma_requests |= (kTimerCc1Dma << duty_channel);
+        dma_settings.request = duty_request;
+        ConfigureDma(settings.duty_dma, dma_settings, 0, 0);
+        StartDma(settings.duty_dma, &regs->ccr[duty_channel], settings.duty_buffer,
+                 2 * settings.half_length, 0);
+    }
+
+    EnableTimerInterrupts(settings.timer, kTimerUpdateEvent, HandleCaptureOverflow, capture);
+    EnableTimerDmaRequests(settings.timer, dma_requests);
+    StartTimer(settings.timer);
+    return true;
+}
+
+void StopCapture(Capture *capture) {
+    StopTimer(capture->settings.timer);
+    EnableTimerDmaRequests(capture->settings.timer, 0);
+    EnableTimerInterrupts(capture->settings.timer, 0, 0, 0);
+    StopDma(capture->settings.period_dma);
+    if (capture->settings.measure_duty) {
+        StopDma(capture->settings.duty_dma);
+    }
+}
+
+uint32_t GetCaptureStats(Capture *capture, CaptureStats *stats) {
+    // A block can finish while copying, so retry until the count is stable.
+    uint32_t blocks;
+    do {
+        blocks = capture->blocks;
+        *stats = capture->stats;
+    } while (blocks != capture->blocks);
+    return blocks;
+}
+
+uint32_t GetCaptureFrequencyMilliHz(const CaptureStats *stats, uint32_t tick_hz) {
+    if (stats->span == 0) {
+        return 0;
+    }
+    return (uint32_t)(((uint64_t)stats->periods * tick_hz * 1000) / stats->span);
+}
+
+uint16_t GetCaptureDuty(const CaptureStats *stats) {
+    if (stats->duty_ticks == 0) {
+        return 0;
+    }
+    uint64_t duty = ((uint64_t)stats->high_ticks << 16) / stats->duty_ticks;
+    return (duty > 0xFFFF) ? 0xFFFF : (uint16_t)duty;
+}
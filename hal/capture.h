@@ -0,0 +1,80 @@
+#ifndef HAL_CAPTURE_H_
+#define HAL_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/timer.h"
+
+// DMA input capture engine for measuring pulse trains (encoders, tachometers, PPM, ...) at
+// hundreds of kHz. The timer free runs over its full 16 bit range and the DMA copies every capture
+// timestamp into a circular buffer, so there is no interrupt per edge. Statistics are computed one
+// half buffer (block) at a time from the DMA half/full transfer interrupts.
+//
+// Individual periods are differences of 16 bit timestamps, so they're exact up to 65535 ticks.
+// Longer gaps are caught by the overflow extension: the timer update interrupt (one per counter
+// wrap, not per edge) counts wraps, which turns the block boundary timestamps into extended 32 bit
+// times. The span of each block, and therefore the average frequency, stays exact even when
+// single periods overflow.
+//
+// For duty cycle, the neighbouring channel captures falling edges of the same pin (indirect input
+// mapping, i.e. CH1 <-> CH2 or CH3 <-> CH4) into a second buffer with its own DMA channel.
+
+typedef struct {
+    uint32_t periods;      // Number of rising edge to rising edge periods in the block.
+    uint32_t min_period;   // Shortest period, in timer ticks.
+    uint32_t max_period;   // Longest period (16 bit), in timer ticks.
+    uint32_t span;         // Extended time from the last edge of the previous block to the last edge
+                           // of this one, in timer ticks. span / periods is the average period.
+    uint32_t high_ticks;   // Total high time of the block's periods but the last, whose falling
+                           // edge may still be on its way (duty measurement only).
+    uint32_t duty_ticks;   // Total length of those same periods (duty measurement only).
+    bool overflowed;       // At least one period in the block was longer than 65535 ticks.
+} CaptureStats;
+
+// Called from the DMA interrupt with the statistics of each finished block.
+typedef void (*CaptureCallback)(void *context, const CaptureStats *stats);
+
+typedef struct {
+    Timer timer;
+    uint16_t prescaler;          // Tick rate = timer clock / (prescaler + 1).
+    TimerChannel channel;        // Channel whose pin carries the signal.
+    uint8_t filter;              // ICxF digital input filter, 0 (off) to 15.
+    DmaChannel period_dma;
+    uint16_t *period_buffer;     // 2 * half_length rising edge timestamps.
+    bool measure_duty;
+    DmaChannel duty_dma;
+    uint16_t *duty_buffer;       // 2 * half_length falling edge timestamps, if measure_duty.
+    uint16_t half_length;        // Edges per block, at least 3.
+    CaptureCallback callback;    // Optional.
+    void *context;
+} CaptureSettings;
+
+typedef struct {
+    CaptureSettings settings;
+    volatile uint32_t overflows;
+    uint32_t last_timestamp;     // Last rising edge of the previous block, 16 bit.
+    uint32_t last_extended;      // Same edge as an extended 32 bit time.
+    bool primed;                 // The first block only establishes the reference edge.
+    CaptureStats stats;          // Latest finished block.
+    volatile uint32_t blocks;    // Incremented after every finished block.
+} Capture;
+
+// Configure the timer and channel(s), then start capturing. Returns false if the timer or channel
+// has no DMA request (TIM14, or CH2 on TIM16/17 which only have one channel).
+bool StartCapture(Capture *capture, CaptureSettings settings);
+
+void StopCapture(Capture *capture);
+
+// Copy out the latest block's statistics. Returns the block count, so callers can tell if anything
+// new arrived since they last looked.
+uint32_t GetCaptureStats(Capture *capture, CaptureStats *stats);
+
+// Average frequency of a block in millihertz, given the tick rate. 0 if the block has no periods.
+uint32_t GetCaptureFrequencyMilliHz(const CaptureStats *stats, uint32_t tick_hz);
+
+// Average duty cycle of a block as a 0.16 fixed point fraction, i.e. 0x8000 is 50%.
+uint16_t GetCaptureDuty(const CaptureStats *stats);
+
+#endif  // HAL_CAPTURE_H_
@@ -0,0 +1,175 @@
+#include "hal/crc.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/rcc.h"
+#include "lib/crc.h"
+
+#define CR_RESET (1 << 0)
+#define CR_POLYSIZE_POS 3
+#define CR_REV_IN_MASK (3 << 5)
+#define CR_REV_IN_BYTE (1 << 5)
+#define CR_REV_IN_WORD (3 << 5)
+
+#define IS_WORD_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+
+static CrcParameters crc_parameters;
+
+static struct {
+    const uint8_t *tail;
+    uint32_t tail_count;
+    CrcCallback callback;
+    void *context;
+} crc_dma;
+
+static uint32_t PolySize(uint8_t width) {
+    switch (width) {
+        case 16:
+            return 1;
+        case 8:
+            return 2;
+        case 7:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+static void WriteBytes(const uint8_t *bytes, size_t count) {
+    volatile uint8_t *dr = (volatile uint8_t *)&CRC_REGS->dr;
+    while (count--) {
+        *dr = *bytes++;
+    }
+}
+
+void ConfigureCrc(CrcParameters parameters) {
+    SET_BIT(RCC_REGS->ahbenr, RCC_AHBENR_CRCEN);
+    crc_parameters = parameters;
+    WRITE_REG(CRC_REGS->pol, parameters.polynomial);
+    WRITE_REG(CRC_REGS->init, parameters.initial);
+    // Reflected input is reversed per byte by default, and per word while feeding whole words.
+    uint32_t cr = PolySize(parameters.width) << CR_POLYSIZE_POS;
+    if (parameters.reflect_input) {
+        cr |= CR_REV_IN_BYTE;
+    }
+    WRITE_REG(CRC_REGS->cr, cr | CR_RESET);
+}
+
+void ResetCrc() {
+    SET_BIT(CRC_REGS->cr, CR_RESET);
+}
+
+void UpdateCrc(const void *data, size_t count) {
+    const uint8_t *bytes = data;
+    if (!crc_parameters.reflect_input) {
+        WriteBytes(bytes, count);
+        return;
+    }
+    while (count && !IS_WORD_ALIGNED(bytes)) {
+        WriteBytes(bytes++, 1);
+        count--;
+    }
+    if (count >= 4) {
+        MODIFY_REG(CRC_REGS->cr, CR_REV_IN_MASK, CR_REV_IN_WORD);
+        const uint32_t *words = (const uint32_t *)bytes;
+        for (; count >= 4; count -= 4) {
+            WRITE_REG(CRC_REGS->dr, *words++);
+        }
+        MODIFY_REG(CRC_REGS->cr, CR_REV_IN_MASK, CR_REV_IN_BYTE);
+        bytes = (const uint8_t *)words;
+    }
+    WriteBytes(bytes, count);
+}
+
+uint32_t GetCrc() {
+    uint8_t width = crc_parameters.width;
+    uint32_t mask = (width == 32) ? 0xFFFFFFFF : ((1u << width) - 1);
+    uint32_t crc = READ_REG(CRC_REGS->dr) & mask;
+    if (crc_parameters.reflect_output) {
+        crc = ReflectCrcBits(crc, width);
+    }
+    return (crc ^ crc_parameters.final_xor) & mask;
+}
+
+uint32_t ComputeCrc(const void *data, size_t count) {
+    ResetCrc();
+    UpdateCrc(data, count);
+    return GetCrc();
+}
+
+static void FinishCrcDma() {
+    WriteBytes(crc_dma.tail, crc_dma.tail_count);
+    if (crc_dma.callback) {
+        crc_dma.callback(crc_dma.context, GetCrc());
+    }
+}
+
+static void HandleCrcDma(void *context, uint32_t events) {
+    DmaChannel channel = (DmaChannel)(uintptr_t)context;
+    StopDma(channel);
+    if (events & kDmaTransferError) {
+        // Only a bad address gets here. Give up without a callback.
+        return;
+    }
+    if (crc_parameters.reflect_input) {
+        MODIFY_REG(CRC_REGS->cr, CR_REV_IN_MASK, CR_REV_IN_BYTE);
+    }
+    FinishCrcDma();
+}
+
+bool StartCrcDma(DmaChannel channel, const void *data, size_t count, CrcCallback callback,
+                 void *context) {
+    const uint8_t *bytes = data;
+    // Reflected CRCs go a word at a time after the unaligned head bytes, which the CPU writes.
+    size_t head_count = 0;
+    size_t transfers = count;
+    if (crc_parameters.reflect_input) {
+        head_count = (4 - ((uintptr_t)bytes & 3)) & 3;
+        head_count = (head_count < count) ? head_count : count;
+        transfers = (count - head_count) / 4;
+    }
+    // The DMA counter is 16 bits. Check before writing anything, so the CRC state is untouched.
+    if (transfers > UINT16_MAX) {
+        return false;
+    }
+    crc_dma.callback = callback;
+    crc_dma.context = context;
+
+    DmaSettings settings = {
+        .request = kDmaRequestMemory,
+        .direction = kDmaMemoryToMemory,
+        .peripheral_width = kDma8Bit,
+        .memory_width = kDma8Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = false,
+        // Low, so the feed never holds up a peripheral's stream.
+        .priority = kDmaPriorityLow,
+    };
+    size_t tail_count = 0;
+    if (crc_parameters.reflect_input) {
+        WriteBytes(bytes, head_count);
+        bytes += head_count;
+        count -= head_count;
+        settings.peripheral_width = kDma32Bit;
+        settings.memory_width = kDma32Bit;
+        tail_count = count & 3;
+    }
+    crc_dma.tail = bytes + (count - tail_count);
+    crc_dma.tail_count = tail_count;
+    if (transfers == 0) {
+        FinishCrcDma();
+        return true;
+    }
+    if (crc_parameters.reflect_input) {
+        MODIFY_REG(CRC_REGS->cr, CR_REV_IN_MASK, CR_REV_IN_WORD);
+    }
+    ConfigureDma(channel, settings, HandleCrcDma, (void *)(uintptr_t)channel);
+    StartDma(channel, &CRC_REGS->dr, bytes, (uint16_t)transfers,
+             (kDmaTransferComplete | kDmaTransferError));
+    return true;
+}
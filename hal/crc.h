@@ -0,0 +1,55 @@
+#ifndef HAL_CRC_H_
+#define HAL_CRC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "lib/crc.h"
+
+typedef struct {
+    volatile uint32_t dr, idr, cr, reserved, init, pol;
+} CrcRegisters;
+#define CRC_BASE 0x40023000
+#define CRC_REGS ((CrcRegisters *)(CRC_BASE))
+
+// Driver for the CRC unit, which takes one data register write per byte, half word or word and
+// has the result ready by the next access. It handles any polynomial of 7, 8, 16 or 32 bits, with
+// the same CrcParameters as the table driven lib/crc, and gives the same results.
+//
+// Reflected CRCs (CRC-32 among them) are fed a word at a time, with the unit bit reversing whole
+// words, which is the same as reflecting the four bytes in memory order. Normal (MSB first) CRCs
+// go a byte at a time, because the unit takes words most significant byte first and memory is
+// little endian. The final XOR and output reflection are applied in software when the result is
+// read.
+//
+// There's a single CRC unit, so there's one computation in flight at a time.
+
+// Enable the CRC clock and program the polynomial. Also resets the computation.
+void ConfigureCrc(CrcParameters parameters);
+
+// Start a new computation from the initial value.
+void ResetCrc();
+
+void UpdateCrc(const void *data, size_t count);
+
+// The CRC of everything since the last reset.
+uint32_t GetCrc();
+
+// Reset, update and get in one go.
+uint32_t ComputeCrc(const void *data, size_t count);
+
+// Called from the DMA interrupt with the CRC once the whole buffer has been consumed.
+typedef void (*CrcCallback)(void *context, uint32_t crc);
+
+// Feed `count` bytes into the unit with a memory to memory DMA, starting from the current state,
+// and leave the CPU free meanwhile. Unaligned head and tail bytes are written by the CPU. Don't
+// touch the CRC unit until the callback has run. Buffers too short for a single DMA transfer are
+// done on the spot, with the callback called before this returns. Returns false, without touching
+// the CRC state, for more than 65535 transfers (just under 256 KiB reflected, 64 KiB otherwise);
+// split those up, the next call carries on from where the callback left off.
+bool StartCrcDma(DmaChannel channel, const void *data, size_t count, CrcCallback callback,
+                 void *context);
+
+#endif  // HAL_CRC_H_
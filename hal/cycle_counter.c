@@ -0,0 +1,8 @@
+#include "hal/cycle_counter.h"
+
+#include "hal/timer.h"
+
+void StartCycleCounter() {
+    ConfigureTimer(kTimer2, (TimerTiming){.prescaler = 0, .reload = 0xFFFFFFFF});
+    StartTimer(kTimer2);
+}
@@ -0,0 +1,18 @@
+#ifndef HAL_CYCLE_COUNTER_H_
+#define HAL_CYCLE_COUNTER_H_
+
+#include <stdint.h>
+
+#include "hal/timer.h"
+
+// The Cortex-M0+ has no DWT cycle counter, so TIM2 (the only 32 bit timer) free runs at the timer
+// clock instead. That's one count per CPU cycle as long as the APB prescaler is 1 or 2, see
+// GetTimerClockHz(). TIM2 is reserved for this once StartCycleCounter() is called.
+void StartCycleCounter();
+
+// Inline so the measurement overhead is a single load (2 cycles).
+static inline uint32_t GetCycles() {
+    return TIMER_REGS(kTimer2)->cnt;
+}
+
+#endif  // HAL_CYCLE_COUNTER_H_
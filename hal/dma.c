@@ -0,0 +1,101 @@
+#include "hal/dma.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+#include "hal/register.h"
+
+// The DmaEvent bits, which are also where their interrupt enables are in CCR.
+#define EVENT_MASK (kDmaTransferComplete | kDmaHalfTransfer | kDmaTransferError)
+
+static const Irq kDmaIrqs[kNumDmaChannels] = {
+    kIrqDma1Channel1, kIrqDma1Channel2To3, kIrqDma1Channel2To3, kIrqDma1Channel4To5,
+    kIrqDma1Channel4To5,
+};
+
+static struct {
+    DmaCallback callback;
+    void *context;
+} dma_callbacks[kNumDmaChannels];
+
+void ConfigureDma(DmaChannel channel, DmaSettings settings, DmaCallback callback, void *context) {
+    SET_BIT(RCC_REGS->ahbenr, RCC_AHBENR_DMA1EN);
+    DmaChannelRegisters *regs = &DMA1_REGS->channel[channel];
+    UPDATE_FIELDS(regs->ccr, DMA_CCR_EN, 0);
+    dma_callbacks[channel].callback = callback;
+    dma_callbacks[channel].context = context;
+
+    WRITE_FIELDS(regs->ccr, DMA_CCR_DIR, settings.direction != kDmaPeripheralToMemory,
+                 DMA_CCR_CIRC, settings.circular, DMA_CCR_PINC, settings.peripheral_increment,
+                 DMA_CCR_MINC, settings.memory_increment, DMA_CCR_PSIZE, settings.peripheral_width,
+                 DMA_CCR_MSIZE, settings.memory_width, DMA_CCR_PL, settings.priority,
+                 DMA_CCR_MEM2MEM, settings.direction == kDmaMemoryToMemory);
+    WRITE_REG(DMAMUX_REGS->ccr[channel], settings.request);
+}
+
+void StartDma(DmaChannel channel, volatile void *peripheral, const volatile void *memory,
+              uint16_t count, uint32_t events) {
+    DmaChannelRegisters *regs = &DMA1_REGS->channel[channel];
+    UPDATE_FIELDS(regs->ccr, DMA_CCR_EN, 0);
+    WRITE_FIELDS(DMA1_REGS->ifcr, DMA_IFCR_FLAGS(channel), 0xF);
+    WRITE_REG(regs->cpar, (uint32_t)peripheral);
+    WRITE_REG(regs->cmar, (uint32_t)memory);
+    WRITE_REG(regs->cndtr, count);
+    UPDATE_FIELDS(regs->ccr, DMA_CCR_TCIE, (events & kDmaTransferComplete) != 0,
+                  DMA_CCR_HTIE, (events & kDmaHalfTransfer) != 0,
+                  DMA_CCR_TEIE, (events & kDmaTransferError) != 0, DMA_CCR_EN, 1);
+    if (events & EVENT_MASK) {
+        EnableIrq(kDmaIrqs[channel]);
+    }
+}
+
+void StopDma(DmaChannel channel) {
+    UPDATE_FIELDS(DMA1_REGS->channel[channel].ccr, DMA_CCR_EN, 0, DMA_CCR_TCIE, 0,
+                  DMA_CCR_HTIE, 0, DMA_CCR_TEIE, 0);
+    WRITE_FIELDS(DMA1_REGS->ifcr, DMA_IFCR_FLAGS(channel), 0xF);
+}
+
+uint16_t GetDmaRemaining(DmaChannel channel) {
+    return READ_REG(DMA1_REGS->channel[channel].cndtr);
+}
+
+bool IsDmaBusy(DmaChannel channel) {
+    DmaChannelRegisters *regs = &DMA1_REGS->channel[channel];
+    return READ_FIELD(regs->ccr, DMA_CCR_EN) && READ_REG(regs->cndtr) != 0;
+}
+
+static void HandleDmaInterrupt(DmaChannel channel) {
+    uint32_t events = READ_FIELD(DMA1_REGS->isr, DMA_ISR_FLAGS(channel)) &
+                      READ_REG(DMA1_REGS->channel[channel].ccr) & EVENT_MASK;
+    if (events == 0) {
+        return;
+    }
+    // Clear only the flags being handled. IFCR is write-1-to-clear, so no read-modify-write.
+    WRITE_FIELDS(DMA1_REGS->ifcr, DMA_IFCR_FLAGS(channel), events);
+    if (dma_callbacks[channel].callback) {
+        dma_callbacks[channel].callback(dma_callbacks[channel].context, events);
+    }
+}
+
+void Dma1Channel1Handler() {
+    EnterIsrHook();
+    HandleDmaInterrupt(kDmaChannel1);
+    ExitIsrHook();
+}
+
+void Dma1Channel2To3Handler() {
+    EnterIsrHook();
+    HandleDmaInterrupt(kDmaChannel2);
+    HandleDmaInterrupt(kDmaChannel3);
+    ExitIsrHook();
+}
+
+void Dma1Channel4To5Handler() {
+    EnterIsrHook();
+    HandleDmaInterrupt(kDmaChannel4);
+    HandleDmaInterrupt(kDmaChannel5);
+    ExitIsrHook();
+}
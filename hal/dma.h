@@ -0,0 +1,145 @@
+#ifndef HAL_DMA_H_
+#define HAL_DMA_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/register.h"
+
+typedef struct {
+    volatile uint32_t ccr, cndtr, cpar, cmar, reserved;
+} DmaChannelRegisters;
+
+typedef struct {
+    volatile uint32_t isr, ifcr;
+    DmaChannelRegisters channel[7];
+} DmaRegisters;
+#define DMA1_BASE 0x40020000
+#define DMA1_REGS ((DmaRegisters *)(DMA1_BASE))
+
+// Fields of each channel's CCR, see hal/register.h.
+#define DMA_CCR_EN REG_FIELD_RW(0, 1)
+#define DMA_CCR_TCIE REG_FIELD_RW(1, 1)
+#define DMA_CCR_HTIE REG_FIELD_RW(2, 1)
+#define DMA_CCR_TEIE REG_FIELD_RW(3, 1)
+#define DMA_CCR_DIR REG_FIELD_RW(4, 1)
+#define DMA_CCR_CIRC REG_FIELD_RW(5, 1)
+#define DMA_CCR_PINC REG_FIELD_RW(6, 1)
+#define DMA_CCR_MINC REG_FIELD_RW(7, 1)
+#define DMA_CCR_PSIZE REG_FIELD_RW(8, 2)
+#define DMA_CCR_MSIZE REG_FIELD_RW(10, 2)
+#define DMA_CCR_PL REG_FIELD_RW(12, 2)
+#define DMA_CCR_MEM2MEM REG_FIELD_RW(14, 1)
+// A channel's nibble of ISR flags (global, transfer complete, half transfer and transfer error, so
+// the DmaEvent bits), and the IFCR bits that clear them.
+#define DMA_ISR_FLAGS(channel) REG_FIELD_RO(4 * (channel), 4)
+#define DMA_IFCR_FLAGS(channel) REG_FIELD_WO(4 * (channel), 4)
+
+// DMAMUX channel n feeds DMA channel n + 1.
+typedef struct {
+    volatile uint32_t ccr[7];
+} DmamuxRegisters;
+#define DMAMUX_BASE 0x40020800
+#define DMAMUX_REGS ((DmamuxRegisters *)(DMAMUX_BASE))
+
+typedef enum {
+    kDmaChannel1, kDmaChannel2, kDmaChannel3, kDmaChannel4, kDmaChannel5, kNumDmaChannels
+} DmaChannel;
+
+// DMAMUX request inputs, see reference manual table 59. Only the ones available on the STM32G031.
+typedef enum {
+    kDmaRequestMemory = 0,
+    kDmaRequestAdc = 5,
+    kDmaRequestI2c1Rx = 10,
+    kDmaRequestI2c1Tx = 11,
+    kDmaRequestI2c2Rx = 12,
+    kDmaRequestI2c2Tx = 13,
+    kDmaRequestLpuart1Rx = 14,
+    kDmaRequestLpuart1Tx = 15,
+    kDmaRequestSpi1Rx = 16,
+    kDmaRequestSpi1Tx = 17,
+    kDmaRequestSpi2Rx = 18,
+    kDmaRequestSpi2Tx = 19,
+    kDmaRequestTim1Ch1 = 20,
+    kDmaRequestTim1Ch2 = 21,
+    kDmaRequestTim1Ch3 = 22,
+    kDmaRequestTim1Ch4 = 23,
+    kDmaRequestTim1TrigCom = 24,
+    kDmaRequestTim1Up = 25,
+    kDmaRequestTim2Ch1 = 26,
+    kDmaRequestTim2Ch2 = 27,
+    kDmaRequestTim2Ch3 = 28,
+    kDmaRequestTim2Ch4 = 29,
+    kDmaRequestTim2Trig = 30,
+    kDmaRequestTim2Up = 31,
+    kDmaRequestTim3Ch1 = 32,
+    kDmaRequestTim3Ch2 = 33,
+    kDmaRequestTim3Ch3 = 34,
+    kDmaRequestTim3Ch4 = 35,
+    kDmaRequestTim3Trig = 36,
+    kDmaRequestTim3Up = 37,
+    kDmaRequestTim16Ch1 = 44,
+    kDmaRequestTim16Com = 45,
+    kDmaRequestTim16Up = 46,
+    kDmaRequestTim17Ch1 = 47,
+    kDmaRequestTim17Com = 48,
+    kDmaRequestTim17Up = 49,
+    kDmaRequestUsart1Rx = 50,
+    kDmaRequestUsart1Tx = 51,
+    kDmaRequestUsart2Rx = 52,
+    kDmaRequestUsart2Tx = 53,
+} DmaRequest;
+
+typedef enum {
+    kDmaPeripheralToMemory,
+    kDmaMemoryToPeripheral,
+    // Memory to memory copies run as fast as the bus allows, no request needed. The "peripheral"
+    // address is the destination, so it also works for feeding a data register (e.g. the CRC).
+    kDmaMemoryToMemory,
+} DmaDirection;
+
+typedef enum {
+    kDma8Bit, kDma16Bit, kDma32Bit
+} DmaWidth;
+
+typedef enum {
+    kDmaPriorityLow, kDmaPriorityMedium, kDmaPriorityHigh, kDmaPriorityVeryHigh
+} DmaPriority;
+
+typedef struct {
+    DmaRequest request;
+    DmaDirection direction;
+    DmaWidth peripheral_width;
+    DmaWidth memory_width;
+    bool peripheral_increment;
+    bool memory_increment;
+    bool circular;
+    DmaPriority priority;
+} DmaSettings;
+
+// Interrupt flags. These line up with each channel's nibble in DMA_ISR.
+typedef enum {
+    kDmaTransferComplete = (1 << 1),
+    kDmaHalfTransfer = (1 << 2),
+    kDmaTransferError = (1 << 3),
+} DmaEvent;
+
+// Called from the DMA interrupt handler with the (already cleared) DmaEvent flags.
+typedef void (*DmaCallback)(void *context, uint32_t events);
+
+// Enable the DMA clock, route `settings.request` to the channel and set up its mode. The channel is
+// left disabled. `callback` may be 0 if no interrupts are used.
+void ConfigureDma(DmaChannel channel, DmaSettings settings, DmaCallback callback, void *context);
+
+// Start a transfer of `count` items (not bytes) and enable the interrupts in the `events` mask.
+void StartDma(DmaChannel channel, volatile void *peripheral, const volatile void *memory,
+              uint16_t count, uint32_t events);
+
+void StopDma(DmaChannel channel);
+
+// Items left to transfer. In circular mode this counts down to 0 and wraps back to `count`.
+uint16_t GetDmaRemaining(DmaChannel channel);
+
+bool IsDmaBusy(DmaChannel channel);
+
+#endif  // HAL_DMA_H_
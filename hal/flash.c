@@ -0,0 +1,128 @@
+#include "hal/flash.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+#include "hal/nvic.h"
+
+#define KEY1 0x45670123
+#define KEY2 0xCDEF89AB
+
+#define SR_EOP (1 << 0)
+// OPERR, PROGERR, WRPERR, PGAERR, SIZERR, PGSERR, MISSERR, FASTERR, RDERR and OPTVERR.
+#define SR_ERRORS 0xC3FA
+#define SR_CFGBSY (1 << 18)
+#define CR_PG (1 << 0)
+#define CR_PER (1 << 1)
+#define CR_PNB_POS 3
+#define CR_PNB_MASK (0x3F << CR_PNB_POS)
+#define CR_STRT (1 << 16)
+#define CR_FSTPG (1 << 18)
+#define CR_LOCK (1u << 31)
+#define ECCR_ECCD (1u << 31)
+
+#define ROW_WORDS (FLASH_ROW_SIZE / 4)
+
+// Unlock the controller, wait out anything still in progress and clear the flags left over from
+// the previous operation. CFGBSY covers both the operation itself and the controller's setup.
+static void BeginOperation() {
+    FlashRegisters *regs = FLASH_REGS;
+    if (READ_BIT(regs->cr, CR_LOCK)) {
+        WRITE_REG(regs->keyr, KEY1);
+        WRITE_REG(regs->keyr, KEY2);
+    }
+    while (READ_BIT(regs->sr, SR_CFGBSY));
+    WRITE_REG(regs->sr, (SR_EOP | SR_ERRORS));
+}
+
+// Wait for the operation, clear `cr_bits` and lock the controller. Returns false on errors.
+static bool EndOperation(uint32_t cr_bits) {
+    FlashRegisters *regs = FLASH_REGS;
+    while (READ_BIT(regs->sr, SR_CFGBSY));
+    uint32_t errors = READ_BIT(regs->sr, SR_ERRORS);
+    WRITE_REG(regs->sr, (SR_EOP | SR_ERRORS));
+    CLEAR_BIT(regs->cr, cr_bits);
+    SET_BIT(regs->cr, CR_LOCK);
+    return errors == 0;
+}
+
+static uint32_t LoadWord(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+bool EraseFlashPage(uintptr_t address) {
+    FlashRegisters *regs = FLASH_REGS;
+    uint32_t page = (address - FLASH_START) / FLASH_PAGE_SIZE;
+    BeginOperation();
+    MODIFY_REG(regs->cr, CR_PNB_MASK, (CR_PER | (page << CR_PNB_POS)));
+    SET_BIT(regs->cr, CR_STRT);
+    return EndOperation(CR_PER);
+}
+
+// Fast programming needs a double word at least every ~20 us until the row is done, and stalls any
+// flash read until then, so this runs from RAM (.ramfunc is part of .data) with interrupts off,
+// reading from a RAM copy of the row. Far from flash, so it takes a long call.
+__attribute__((section(".ramfunc"), noinline, long_call))
+static void ProgramRow(volatile uint32_t *destination, const uint32_t *source) {
+    FlashRegisters *regs = FLASH_REGS;
+    uint32_t primask = EnterCritical();
+    SET_BIT(regs->cr, CR_FSTPG);
+    for (uint32_t i = 0; i < ROW_WORDS; i++) {
+        destination[i] = source[i];
+    }
+    while (READ_BIT(regs->sr, SR_CFGBSY));
+    ExitCritical(primask);
+}
+
+bool ProgramFlash(uintptr_t address, const void *data, size_t count) {
+    FlashRegisters *regs = FLASH_REGS;
+    const uint8_t *bytes = data;
+    bool ok = true;
+    while (ok && count) {
+        BeginOperation();
+        if (address % FLASH_ROW_SIZE == 0 && count >= FLASH_ROW_SIZE) {
+            uint32_t row[ROW_WORDS];
+            for (uint32_t i = 0; i < ROW_WORDS; i++) {
+                row[i] = LoadWord(&bytes[4 * i]);
+            }
+            ProgramRow((volatile uint32_t *)address, row);
+            ok = EndOperation(CR_FSTPG);
+            address += FLASH_ROW_SIZE;
+            bytes += FLASH_ROW_SIZE;
+            count -= FLASH_ROW_SIZE;
+        } else {
+            // The second word starts the programming.
+            SET_BIT(regs->cr, CR_PG);
+            ((volatile uint32_t *)address)[0] = LoadWord(bytes);
+            ((volatile uint32_t *)address)[1] = LoadWord(bytes + 4);
+            ok = EndOperation(CR_PG);
+            address += 8;
+            bytes += 8;
+            count -= 8;
+        }
+    }
+    return ok;
+}
+
+bool IsFlashErased(uintptr_t address, size_t count) {
+    const uint32_t *words = (const uint32_t *)address;
+    for (size_t i = 0; i < count / 4; i++) {
+        if (words[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The NMI for double ECC errors (see flash.h): acknowledge it and let the read go on with whatever
+// it got. Any other NMI is fatal, like in the default handler. No ISR hooks: the NMI preempts
+// their critical sections.
+void NmiHandler() {
+    if (READ_BIT(FLASH_REGS->eccr, ECCR_ECCD)) {
+        SET_BIT(FLASH_REGS->eccr, ECCR_ECCD);
+        return;
+    }
+    while(1);
+}
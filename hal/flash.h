@@ -0,0 +1,45 @@
+#ifndef HAL_FLASH_H_
+#define HAL_FLASH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t acr, reserved0, keyr, optkeyr, sr, cr, eccr, reserved1, optr;
+} FlashRegisters;
+#define FLASH_REGS_BASE 0x40022000
+#define FLASH_REGS ((FlashRegisters *)(FLASH_REGS_BASE))
+
+#define FLASH_START 0x08000000
+#define FLASH_PAGE_SIZE 2048
+#define FLASH_ROW_SIZE 256  // 32 double words, the unit of fast programming.
+
+// The part of flash the linker script keeps free of code and constants for data (its STORAGE
+// region), from storage_start up to storage_end. Page aligned.
+extern const uint8_t storage_start[], storage_end[];
+
+// Erasing and programming the main flash. Flash only programs 64 bit double words, and only erased
+// (all ones) ones, so addresses and counts are multiples of 8 and pages are erased first. Each
+// call unlocks the controller and locks it again before returning, and returns false if the
+// controller flagged an error (e.g. programming a double word that wasn't erased).
+//
+// The CPU stalls on any flash access while the controller is busy, so code keeps running (from
+// flash) at the cost of some latency, except for fast row programming: it needs the 32 double
+// words of a row written back to back, so that loop runs from RAM with interrupts masked.
+//
+// A double word torn by a reset halfway through programming fails its ECC check, which raises an
+// NMI on read. The NMI handler here clears it and carries on, so readers see garbage instead,
+// which a checksum catches (see lib/kvstore.h).
+
+// Erase the page containing `address`.
+bool EraseFlashPage(uintptr_t address);
+
+// Program `count` bytes (a multiple of 8) to `address` (8 byte aligned). Whole aligned rows go
+// through fast programming, the rest one double word at a time. `data` needs no alignment.
+bool ProgramFlash(uintptr_t address, const void *data, size_t count);
+
+// True if `count` bytes at `address` are all erased.
+bool IsFlashErased(uintptr_t address, size_t count);
+
+#endif  // HAL_FLASH_H_
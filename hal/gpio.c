@@ -5,18 +5,48 @@
 
 #include "hal/macros.h"
 #include "hal/rcc.h"
+#include "hal/register.h"
 
 void ConfigureGpio(Gpio gpio, GpioSettings settings) {
-    SET_BIT(RCC_REGS->iopenr, (1 << gpio.port));
-    MODIFY_REG(GPIO_REGS(gpio.port)->moder, (0b11 << (2 * gpio.pin)), (settings.mode << (2 * gpio.pin)));
-    if (settings.mode == kOutput) {
-        MODIFY_REG(GPIO_REGS(gpio.port)->otyper, (1 << gpio.pin), (settings.otype << gpio.pin));
-        MODIFY_REG(GPIO_REGS(gpio.port)->ospeedr, (0b11 << (2 * gpio.pin)), (settings.ospeed << (2 * gpio.pin)));
+    ConfigureGpioPins(gpio.port, GPIO_PIN(gpio.pin), settings);
+}
+
+void ConfigureGpioPins(GpioPort port, uint16_t pins, GpioSettings settings) {
+    GpioRegisters *regs = GPIO_REGS(port);
+    SET_BIT(RCC_REGS->iopenr, (1 << port));
+
+    // Gather every pin's fields first, so each register is read and written once. MODER, OSPEEDR
+    // and PUPDR have the same 2 bit fields.
+    uint32_t two_bits = 0, mode = 0, ospeed = 0, pupd = 0, otype = 0;
+    uint32_t afr_mask[2] = {0, 0}, afr[2] = {0, 0};
+    for (uint32_t pin = 0; pin < 16; pin++) {
+        if (!(pins & GPIO_PIN(pin))) {
+            continue;
+        }
+        two_bits |= FIELD_MASK(GPIO_MODER_MODE(pin));
+        mode |= FIELD_VALUE(GPIO_MODER_MODE(pin), settings.mode);
+        ospeed |= FIELD_VALUE(GPIO_OSPEEDR_OSPEED(pin), settings.ospeed);
+        pupd |= FIELD_VALUE(GPIO_PUPDR_PUPD(pin), settings.pupd);
+        otype |= FIELD_VALUE(GPIO_OTYPER_OT(pin), settings.otype);
+        afr_mask[pin / 8] |= FIELD_MASK(GPIO_AFR_AFSEL(pin));
+        afr[pin / 8] |= FIELD_VALUE(GPIO_AFR_AFSEL(pin), settings.afsel);
+    }
+
+    // Everything else first and the mode last, so the pins don't glitch through a half configured
+    // state. Alternate functions drive the pins too, so they get the output type and speed.
+    if (settings.mode == kOutput || settings.mode == kAlternateFunction) {
+        MODIFY_REG(regs->otyper, pins, otype);
+        MODIFY_REG(regs->ospeedr, two_bits, ospeed);
     }
-    MODIFY_REG(GPIO_REGS(gpio.port)->pupdr, (0b11 << (2 * gpio.pin)), (settings.pupd << (2 * gpio.pin)));
+    MODIFY_REG(regs->pupdr, two_bits, pupd);
     if (settings.mode == kAlternateFunction) {
-        MODIFY_REG(GPIO_REGS(gpio.port)->afrl, ((0b0111) << (4 * gpio.pin)), ((settings.afsel) << (4 * gpio.pin)));
+        for (uint32_t i = 0; i < 2; i++) {
+            if (afr_mask[i]) {
+                MODIFY_REG(regs->afr[i], afr_mask[i], afr[i]);
+            }
+        }
     }
+    MODIFY_REG(regs->moder, two_bits, mode);
 }
 
 void SetGpio(Gpio gpio, bool state) {
@@ -28,5 +58,5 @@ void SetGpio(Gpio gpio, bool state) {
 }
 
 bool GetGpio(Gpio gpio) {
-    return READ_BIT(GPIO_REGS(gpio.port)->idr, (1 << gpio.pin));
+    return READ_FIELD(GPIO_REGS(gpio.port)->idr, GPIO_IDR_ID(gpio.pin));
 }
\ No newline at end of file
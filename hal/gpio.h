@@ -4,12 +4,25 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "hal/register.h"
+
 typedef struct {
-    volatile uint32_t moder, otyper, ospeedr, pupdr, idr, odr, bsrr, lckr, afrl, afrh, brr;
+    volatile uint32_t moder, otyper, ospeedr, pupdr, idr, odr, bsrr, lckr, afr[2], brr;
 } GpioRegisters;
 #define GPIO_BASE 0x50000000
 #define GPIO_REGS(port) ((GpioRegisters *)(GPIO_BASE + (0x400 * (port))))
 
+// Fields of each pin, see hal/register.h. AFSEL is in afr[pin / 8].
+#define GPIO_MODER_MODE(pin) REG_FIELD_RW(2 * (pin), 2)
+#define GPIO_OTYPER_OT(pin) REG_FIELD_RW((pin), 1)
+#define GPIO_OSPEEDR_OSPEED(pin) REG_FIELD_RW(2 * (pin), 2)
+#define GPIO_PUPDR_PUPD(pin) REG_FIELD_RW(2 * (pin), 2)
+#define GPIO_IDR_ID(pin) REG_FIELD_RO((pin), 1)
+#define GPIO_AFR_AFSEL(pin) REG_FIELD_RW(4 * ((pin) % 8), 4)
+
+// A set of pins of one port, for ConfigureGpioPins().
+#define GPIO_PIN(pin) (1u << (pin))
+
 typedef enum {
     kGpioA, kGpioB, kGpioC, kGpioD, kGpioE, kGpioF
 } GpioPort;
@@ -45,6 +58,10 @@ typedef struct {
 
 void ConfigureGpio(Gpio gpio, GpioSettings settings);
 
+// Configure every pin in `pins` (GPIO_PIN()s ORed together) of `port` the same way, with one
+// read-modify-write per register, e.g. both pins of a USART.
+void ConfigureGpioPins(GpioPort port, uint16_t pins, GpioSettings settings);
+
 void SetGpio(Gpio gpio, bool state);
 
 bool GetGpio(Gpio gpio);
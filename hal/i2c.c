@@ -0,0 +1,315 @@
+#include "hal/i2c.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+
+#define CR1_PE (1 << 0)
+#define CR1_TXIE (1 << 1)
+#define CR1_RXIE (1 << 2)
+#define CR1_NACKIE (1 << 4)
+#define CR1_STOPIE (1 << 5)
+#define CR1_TCIE (1 << 6)
+#define CR1_ERRIE (1 << 7)
+#define CR1_TXDMAEN (1 << 14)
+#define CR1_RXDMAEN (1 << 15)
+#define CR1_ALWAYS_ON (CR1_PE | CR1_NACKIE | CR1_STOPIE | CR1_TCIE | CR1_ERRIE)
+#define CR2_RD_WRN (1 << 10)
+#define CR2_START (1 << 13)
+#define CR2_NBYTES_POS 16
+#define CR2_NBYTES_MASK (0xFF << CR2_NBYTES_POS)
+#define CR2_RELOAD (1 << 24)
+#define CR2_AUTOEND (1 << 25)
+#define TIMINGR_PRESC_POS 28
+#define TIMINGR_SCLDEL_POS 20
+#define TIMINGR_SDADEL_POS 16
+#define TIMINGR_SCLH_POS 8
+#define TIMEOUTR_TIMOUTEN (1 << 15)
+#define ISR_TXIS (1 << 1)
+#define ISR_RXNE (1 << 2)
+#define ISR_NACKF (1 << 4)
+#define ISR_STOPF (1 << 5)
+#define ISR_TC (1 << 6)
+#define ISR_TCR (1 << 7)
+#define ISR_BERR (1 << 8)
+#define ISR_ARLO (1 << 9)
+#define ISR_TIMEOUT (1 << 12)
+#define ICR_ALL 0x3F38
+
+// Only CFGR1 is needed, for the Fm+ drive bits.
+typedef struct {
+    volatile uint32_t cfgr1;
+} SyscfgRegisters;
+#define SYSCFG_REGS ((SyscfgRegisters *)0x40010000)
+#define CFGR1_I2C1_FMP (1 << 20)
+#define CFGR1_I2C2_FMP (1 << 21)
+
+// NBYTES is 8 bits, longer phases reload it in chunks.
+#define MAX_CHUNK 255
+
+// SCL low time before the timeout error, for a slave stuck holding the clock.
+#define TIMEOUT_MS 25
+
+// Per speed times in ns, from the reference manual's examples: at 16 MHz for Sm and Fm, at 48 MHz
+// for Fm+. SCL also spends a few kernel clocks synchronizing on each edge, which is what brings
+// the 16 MHz Fm+ example down to 1 MHz. Those delays shrink as the clock goes up, so with the 16
+// MHz times SCL would run at 1.3 MHz on a 48 or 64 MHz PCLK, and go below Fm+'s 500 ns tLOW.
+static const struct {
+    uint16_t scl_low, scl_high, scl_delay, sda_delay;
+} kI2cTimes[] = {
+    [kI2cStandard] = {5000, 4000, 1250, 500},
+    [kI2cFast] = {1250, 500, 500, 250},
+    [kI2cFastPlus] = {500, 250, 250, 0},
+};
+
+static const Irq kI2cIrqs[kNumI2cs] = {kIrqI2c1, kIrqI2c2};
+
+// `queue` runs from `tail` to `head`, both free running. The rest describes the transaction on the
+// bus: which phase it's in, the bytes left to hand to NBYTES and, without DMA, the next byte.
+static struct {
+    bool use_dma;
+    DmaChannel rx_channel, tx_channel;
+    I2cTransaction *queue[I2C_QUEUE_LENGTH];
+    volatile uint32_t head, tail;
+    I2cTransaction *volatile current;
+    bool reading;
+    uint16_t unprogrammed;
+    uint8_t *data;
+    I2cStatus status;
+} i2c_state[kNumI2cs];
+
+// Ticks of `tick_khz` to cover `ns`, rounded up.
+static uint32_t TicksFor(uint32_t ns, uint32_t tick_khz) {
+    return (ns * tick_khz + 999999) / 1000000;
+}
+
+uint32_t ComputeI2cTiming(uint32_t clock_hz, I2cSpeed speed) {
+    uint32_t clock_khz = clock_hz / 1000;
+    uint32_t presc = 0;
+    uint32_t scll, sclh, scldel, sdadel;
+    for (;; presc++) {
+        uint32_t tick_khz = clock_khz / (presc + 1);
+        scll = TicksFor(kI2cTimes[speed].scl_low, tick_khz);
+        sclh = TicksFor(kI2cTimes[speed].scl_high, tick_khz);
+        scldel = TicksFor(kI2cTimes[speed].scl_delay, tick_khz);
+        sdadel = TicksFor(kI2cTimes[speed].sda_delay, tick_khz);
+        // All but SDADEL count from 1.
+        scll = scll ? scll - 1 : 0;
+        sclh = sclh ? sclh - 1 : 0;
+        scldel = scldel ? scldel - 1 : 0;
+        if ((scll <= 0xFF && sclh <= 0xFF && scldel <= 0xF && sdadel <= 0xF) || presc == 0xF) {
+            break;
+        }
+    }
+    return (presc << TIMINGR_PRESC_POS) | (scldel << TIMINGR_SCLDEL_POS) |
+           (sdadel << TIMINGR_SDADEL_POS) | (sclh << TIMINGR_SCLH_POS) | scll;
+}
+
+void ConfigureI2c(I2c i2c, I2cSettings settings) {
+    I2cRegisters *regs = I2C_REGS(i2c);
+    // I2C1 can have other kernel clocks, but PCLK is the reset default.
+    SET_BIT(RCC_REGS->apbenr1, (i2c == kI2c1) ? RCC_APBENR1_I2C1EN : RCC_APBENR1_I2C2EN);
+    if (settings.speed == kI2cFastPlus) {
+        SET_BIT(RCC_REGS->apbenr2, RCC_APBENR2_SYSCFGEN);
+        SET_BIT(SYSCFG_REGS->cfgr1, (i2c == kI2c1) ? CFGR1_I2C1_FMP : CFGR1_I2C2_FMP);
+    }
+    GpioSettings pin = {
+        .mode = kAlternateFunction, .otype = kOpenDrain, .ospeed = kHigh, .pupd = kNone,
+        .afsel = settings.afsel,
+    };
+    ConfigureGpio(settings.scl, pin);
+    ConfigureGpio(settings.sda, pin);
+
+    i2c_state[i2c].use_dma = settings.use_dma;
+    i2c_state[i2c].rx_channel = settings.rx_channel;
+    i2c_state[i2c].tx_channel = settings.tx_channel;
+
+    uint32_t clock_hz = GetPclkHz();
+    WRITE_REG(regs->cr1, 0);
+    WRITE_REG(regs->timingr, ComputeI2cTiming(clock_hz, settings.speed));
+    // TIMEOUTA counts in units of 2048 kernel clocks.
+    uint32_t timeout = (clock_hz / 1000 * TIMEOUT_MS) / 2048 - 1;
+    WRITE_REG(regs->timeoutr, ((timeout > 0xFFF ? 0xFFF : timeout) | TIMEOUTR_TIMOUTEN));
+    WRITE_REG(regs->cr1, CR1_ALWAYS_ON);
+    EnableIrq(kI2cIrqs[i2c]);
+}
+
+// Program NBYTES with the next chunk of the phase, and whether the hardware reloads, stops, or
+// (ahead of the read phase) just stops clocking when it's done.
+static uint32_t NextChunk(I2c i2c) {
+    I2cTransaction *transaction = i2c_state[i2c].current;
+    uint32_t chunk = i2c_state[i2c].unprogrammed;
+    uint32_t cr2 = 0;
+    if (chunk > MAX_CHUNK) {
+        chunk = MAX_CHUNK;
+        cr2 |= CR2_RELOAD;
+    } else if (i2c_state[i2c].reading || transaction->read_count == 0) {
+        cr2 |= CR2_AUTOEND;
+    }
+    i2c_state[i2c].unprogrammed -= chunk;
+    return cr2 | (chunk << CR2_NBYTES_POS);
+}
+
+// Start the write or read phase, with a (repeated) START.
+static void StartPhase(I2c i2c, bool reading) {
+    I2cRegisters *regs = I2C_REGS(i2c);
+    I2cTransaction *transaction = i2c_state[i2c].current;
+    uint16_t count = reading ? transaction->read_count : transaction->write_count;
+    i2c_state[i2c].reading = reading;
+    i2c_state[i2c].unprogrammed = count;
+    i2c_state[i2c].data = reading ? transaction->read : (uint8_t *)transaction->write;
+
+    uint32_t cr1 = CR1_ALWAYS_ON;
+    if (i2c_state[i2c].use_dma && count >= I2C_DMA_THRESHOLD) {
+        DmaSettings settings = {
+            .request = reading ? ((i2c == kI2c1) ? kDmaRequestI2c1Rx : kDmaRequestI2c2Rx)
+                               : ((i2c == kI2c1) ? kDmaRequestI2c1Tx : kDmaRequestI2c2Tx),
+            .direction = reading ? kDmaPeripheralToMemory : kDmaMemoryToPeripheral,
+            .peripheral_width = kDma8Bit,
+            .memory_width = kDma8Bit,
+            .peripheral_increment = false,
+            .memory_increment = true,
+            .circular = false,
+            .priority = kDmaPriorityMedium,
+        };
+        DmaChannel channel = reading ? i2c_state[i2c].rx_channel : i2c_state[i2c].tx_channel;
+        ConfigureDma(channel, settings, 0, 0);
+        StartDma(channel, reading ? &regs->rxdr : &regs->txdr, i2c_state[i2c].data, count, 0);
+        cr1 |= reading ? CR1_RXDMAEN : CR1_TXDMAEN;
+    } else {
+        cr1 |= reading ? CR1_RXIE : CR1_TXIE;
+    }
+    WRITE_REG(regs->cr1, cr1);
+    WRITE_REG(regs->cr2, ((transaction->address << 1) | (reading ? CR2_RD_WRN : 0) |
+                          NextChunk(i2c) | CR2_START));
+}
+
+static void StartTransaction(I2c i2c, I2cTransaction *transaction) {
+    i2c_state[i2c].current = transaction;
+    i2c_state[i2c].status = kI2cDone;
+    // A read on its own skips the write phase. Nothing at all is an address probe.
+    StartPhase(i2c, transaction->write_count == 0 && transaction->read_count != 0);
+}
+
+// Start the next queued transaction if the bus is idle. Callers hold a critical section.
+static void StartQueued(I2c i2c) {
+    if (i2c_state[i2c].current || i2c_state[i2c].tail == i2c_state[i2c].head) {
+        return;
+    }
+    uint32_t tail = i2c_state[i2c].tail;
+    i2c_state[i2c].tail = tail + 1;
+    StartTransaction(i2c, i2c_state[i2c].queue[tail % I2C_QUEUE_LENGTH]);
+}
+
+static void FinishTransaction(I2c i2c) {
+    I2cTransaction *done = i2c_state[i2c].current;
+    if (i2c_state[i2c].use_dma) {
+        StopDma(i2c_state[i2c].rx_channel);
+        StopDma(i2c_state[i2c].tx_channel);
+    }
+    WRITE_REG(I2C_REGS(i2c)->cr1, CR1_ALWAYS_ON);
+    done->status = i2c_state[i2c].status;
+
+    uint32_t primask = EnterCritical();
+    i2c_state[i2c].current = 0;
+    StartQueued(i2c);
+    ExitCritical(primask);
+
+    if (done->callback) {
+        done->callback(done->context, done->status);
+    }
+}
+
+// Errors leave the state machine wherever it was, so reset it rather than wait for a STOP that may
+// never come. The reset needs PE low for three APB cycles, which reading it back covers.
+static void AbortTransaction(I2c i2c, I2cStatus status) {
+    I2cRegisters *regs = I2C_REGS(i2c);
+    WRITE_REG(regs->cr1, 0);
+    while (READ_BIT(regs->cr1, CR1_PE));
+    WRITE_REG(regs->icr, ICR_ALL);
+    i2c_state[i2c].status = status;
+    FinishTransaction(i2c);
+}
+
+HOT_FUNCTION
+static void HandleI2cInterrupt(I2c i2c) {
+    I2cRegisters *regs = I2C_REGS(i2c);
+    uint32_t isr = READ_REG(regs->isr);
+    // Only the flags whose interrupts are on. TXIS and RXNE come up during DMA phases too, but then
+    // TXDR and RXDR belong to the DMA. The data, NACK and STOP enables sit at their flags' bits.
+    uint32_t cr1 = READ_REG(regs->cr1);
+    uint32_t enabled = cr1 & (CR1_TXIE | CR1_RXIE | CR1_NACKIE | CR1_STOPIE);
+    if (cr1 & CR1_TCIE) {
+        enabled |= ISR_TC | ISR_TCR;
+    }
+    if (cr1 & CR1_ERRIE) {
+        enabled |= ISR_BERR | ISR_ARLO | ISR_TIMEOUT;
+    }
+    isr &= enabled;
+    if (!i2c_state[i2c].current) {
+        WRITE_REG(regs->icr, ICR_ALL);
+        return;
+    }
+    if (isr & (ISR_BERR | ISR_ARLO | ISR_TIMEOUT)) {
+        AbortTransaction(i2c, (isr & ISR_BERR) ? kI2cBusError :
+                              (isr & ISR_ARLO) ? kI2cArbitrationLost : kI2cTimeout);
+        return;
+    }
+    if (isr & ISR_NACKF) {
+        // The hardware sends the STOP by itself, the transaction ends on STOPF.
+        WRITE_REG(regs->icr, ISR_NACKF);
+        i2c_state[i2c].status = kI2cNack;
+    }
+    if (isr & ISR_TXIS) {
+        WRITE_REG(regs->txdr, *i2c_state[i2c].data++);
+    }
+    if (isr & ISR_RXNE) {
+        *i2c_state[i2c].data++ = READ_REG(regs->rxdr);
+    }
+    if (isr & ISR_TCR) {
+        MODIFY_REG(regs->cr2, (CR2_NBYTES_MASK | CR2_RELOAD | CR2_AUTOEND), NextChunk(i2c));
+    }
+    if (isr & ISR_TC) {
+        // The write phase is done and the read phase follows, with a repeated start.
+        StartPhase(i2c, true);
+    }
+    if (isr & ISR_STOPF) {
+        WRITE_REG(regs->icr, ISR_STOPF);
+        FinishTransaction(i2c);
+    }
+}
+
+void I2c1Handler() {
+    EnterIsrHook();
+    HandleI2cInterrupt(kI2c1);
+    ExitIsrHook();
+}
+
+void I2c2Handler() {
+    EnterIsrHook();
+    HandleI2cInterrupt(kI2c2);
+    ExitIsrHook();
+}
+
+bool QueueI2cTransaction(I2c i2c, I2cTransaction *transaction) {
+    uint32_t primask = EnterCritical();
+    if (i2c_state[i2c].head - i2c_state[i2c].tail == I2C_QUEUE_LENGTH) {
+        ExitCritical(primask);
+        return false;
+    }
+    transaction->status = kI2cPending;
+    i2c_state[i2c].queue[i2c_state[i2c].head % I2C_QUEUE_LENGTH] = transaction;
+    i2c_state[i2c].head++;
+    StartQueued(i2c);
+    ExitCritical(primask);
+    return true;
+}
+
+bool IsI2cBusy(I2c i2c) {
+    return i2c_state[i2c].current || i2c_state[i2c].head != i2c_state[i2c].tail;
+}
@@ -0,0 +1,109 @@
+#ifndef HAL_I2C_H_
+#define HAL_I2C_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+
+typedef struct {
+    volatile uint32_t cr1, cr2, oar1, oar2, timingr, timeoutr, isr, icr, pecr, rxdr, txdr;
+} I2cRegisters;
+#define I2C1_BASE 0x40005400
+#define I2C2_BASE 0x40005800
+
+typedef enum {
+    kI2c1, kI2c2, kNumI2cs
+} I2c;
+#define I2C_BASE(i2c) ((i2c) == kI2c1 ? I2C1_BASE : I2C2_BASE)
+#define I2C_REGS(i2c) ((I2cRegisters *)(I2C_BASE(i2c)))
+
+// Interrupt driven I2C master, 7 bit addresses. Transactions are a write, a read, or a write then
+// a read with a repeated start in between (the usual register read), and run from a queue in the
+// background: the interrupt handler feeds and drains the data registers, or the DMA does for
+// longer payloads, and the next transaction starts as soon as the previous one's STOP is out.
+// A sensor loop can queue all of its reads at the start of a tick and collect the results (or
+// get callbacks) later, without ever waiting on the bus:
+//
+//     static const uint8_t kAccelRegister = 0x28;
+//     static uint8_t accel[6];
+//     static I2cTransaction accel_read = {
+//         .address = 0x19, .write = &kAccelRegister, .write_count = 1, .read = accel,
+//         .read_count = 6,
+//     };
+//     ...
+//     QueueI2cTransaction(kI2c1, &accel_read);
+//     QueueI2cTransaction(kI2c1, &gyro_read);
+//     ...
+//     if (accel_read.status == kI2cDone) { ... }
+//
+// A NACK ends the transaction with a STOP and kI2cNack. Bus errors, lost arbitration and SCL held
+// low for over 25 ms (a hung slave) reset the peripheral from the interrupt handler and end the
+// transaction with the error, and the queue carries on with the next one.
+
+typedef enum {
+    kI2cStandard,  // 100 kHz
+    kI2cFast,      // 400 kHz
+    kI2cFastPlus,  // 1 MHz, which also enables the pins' Fm+ drive.
+} I2cSpeed;
+
+typedef struct {
+    I2cSpeed speed;
+    // SCL and SDA, configured by ConfigureI2c() as open drain alternate functions. E.g. I2C1 on
+    // PB6 and PB7, or I2C2 on PA11 and PA12, all AF6. The bus needs external pull-ups.
+    Gpio scl, sda;
+    uint8_t afsel;
+    // DMA for payloads of I2C_DMA_THRESHOLD bytes or more. Without it, every byte takes an
+    // interrupt.
+    bool use_dma;
+    DmaChannel rx_channel, tx_channel;
+} I2cSettings;
+
+#define I2C_DMA_THRESHOLD 8
+
+typedef enum {
+    kI2cIdle,     // Never queued.
+    kI2cPending,  // Queued or on the bus.
+    kI2cDone,
+    kI2cNack,
+    kI2cBusError,
+    kI2cArbitrationLost,
+    kI2cTimeout,
+} I2cStatus;
+
+// Called from the I2C interrupt when a transaction has ended, successfully or not.
+typedef void (*I2cCallback)(void *context, I2cStatus status);
+
+typedef struct {
+    uint8_t address;     // 7 bit, not shifted.
+    const uint8_t *write;
+    uint16_t write_count;
+    uint8_t *read;
+    uint16_t read_count;
+    I2cCallback callback;  // Optional.
+    void *context;
+    volatile I2cStatus status;  // Set by the driver.
+} I2cTransaction;
+
+// Queued transactions per I2C.
+#define I2C_QUEUE_LENGTH 8
+
+// Enable the clock, set up the pins, and compute the timing from the current PCLK (GetPclkHz()),
+// so configure the clocks first.
+void ConfigureI2c(I2c i2c, I2cSettings settings);
+
+// The TIMINGR value for `speed` with an I2C kernel clock of `clock_hz`. The SCL low and high times
+// and data delays are from the reference manual's examples (16 MHz for Sm and Fm, 48 MHz for Fm+),
+// rescaled with the smallest prescaler that fits.
+uint32_t ComputeI2cTiming(uint32_t clock_hz, I2cSpeed speed);
+
+// Queue a transaction, starting it right away if the bus is idle. Returns false if the queue is
+// full. The transaction and its buffers must stay untouched while its status is kI2cPending.
+// Safe to call from ISRs, including the callbacks.
+bool QueueI2cTransaction(I2c i2c, I2cTransaction *transaction);
+
+// True while anything is queued or on the bus.
+bool IsI2cBusy(I2c i2c);
+
+#endif  // HAL_I2C_H_
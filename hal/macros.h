@@ -9,4 +9,16 @@
 #define READ_REG(REG)                       ((REG))
 #define MODIFY_REG(REG, CLEARMASK, SETMASK) WRITE_REG((REG), (((READ_REG(REG)) & (~(CLEARMASK))) | (SETMASK)))
 
+// Code that runs per sample, per byte or in every interrupt: DSP kernels, ISR hooks, recorders and
+// the like. The default build is -O0 for the debugger's sake, where these fall behind their
+// peripherals or swamp what they measure, so they're built at -O2 there. Optimized builds (-Os,
+// see rules.bzl) leave them at the build's level like everything else. GCC doesn't inline anything
+// at -O0, not even into an -O2 function, so their small helpers are HOT_INLINE.
+#ifdef __OPTIMIZE__
+#define HOT_FUNCTION
+#else
+#define HOT_FUNCTION __attribute__((optimize("O2")))
+#endif
+#define HOT_INLINE static inline __attribute__((always_inline))
+
 #endif  // HAL_MACROS_H_
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "hal/nvic.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+#define AIRCR_VECTKEY (0x05FA << 16)
+#define AIRCR_SYSRESETREQ (1 << 2)
+
+// Only the top two bits of each 8 bit priority field are implemented.
+#define PRIORITY_SHIFT(irq) (8 * ((irq) % 4) + 6)
+
+// The IRQs at each priority level and below, kept up to date by SetIrqPriority(), so masking is a
+// single lookup. Everything starts at the highest priority.
+static uint32_t irqs_at_or_below[NUM_IRQ_PRIORITIES] = {0xFFFFFFFF};
+
+// The set/clear enable and pending registers ignore 0 bits, so plain writes are enough (and safe
+// from ISRs).
+void EnableIrq(Irq irq) {
+    WRITE_REG(NVIC_REGS->iser, (1 << irq));
+}
+
+void DisableIrq(Irq irq) {
+    WRITE_REG(NVIC_REGS->icer, (1 << irq));
+}
+
+bool IsIrqEnabled(Irq irq) {
+    return READ_BIT(NVIC_REGS->iser, (1 << irq));
+}
+
+void SetIrqPending(Irq irq) {
+    WRITE_REG(NVIC_REGS->ispr, (1 << irq));
+}
+
+void ClearIrqPending(Irq irq) {
+    WRITE_REG(NVIC_REGS->icpr, (1 << irq));
+}
+
+bool IsIrqPending(Irq irq) {
+    return READ_BIT(NVIC_REGS->ispr, (1 << irq));
+}
+
+// The M0+ only allows word accesses to the priority registers, so each update is a
+// read-modify-write of four IRQs' fields, done in a critical section.
+void SetIrqPriority(Irq irq, IrqPriority priority) {
+    uint32_t primask = EnterCritical();
+    MODIFY_REG(NVIC_REGS->ipr[irq / 4], (0x3 << PRIORITY_SHIFT(irq)),
+               (priority << PRIORITY_SHIFT(irq)));
+    for (uint32_t level = 0; level < NUM_IRQ_PRIORITIES; level++) {
+        if (level <= priority) {
+            SET_BIT(irqs_at_or_below[level], (1 << irq));
+        } else {
+            CLEAR_BIT(irqs_at_or_below[level], (1 << irq));
+        }
+    }
+    ExitCritical(primask);
+}
+
+IrqPriority GetIrqPriority(Irq irq) {
+    return (READ_REG(NVIC_REGS->ipr[irq / 4]) >> PRIORITY_SHIFT(irq)) & 0x3;
+}
+
+// SVCall is in the top byte of SHPR2, PendSV and SysTick in the top two bytes of SHPR3.
+void SetSystemPriority(SystemException exception, IrqPriority priority) {
+    volatile uint32_t *shpr = (exception == kSvc) ? &SCB_REGS->shpr2 : &SCB_REGS->shpr3;
+    uint32_t primask = EnterCritical();
+    MODIFY_REG(*shpr, (0x3 << PRIORITY_SHIFT(exception)), (priority << PRIORITY_SHIFT(exception)));
+    ExitCritical(primask);
+}
+
+// Only the IRQs this call disabled are returned, so an inner section doesn't re-enable what an
+// outer one masked. The barriers make sure none of them can still be taken once this returns.
+HOT_FUNCTION
+uint32_t MaskIrqPriority(IrqPriority priority) {
+    uint32_t primask = EnterCritical();
+    uint32_t masked = READ_REG(NVIC_REGS->iser) & irqs_at_or_below[priority];
+    WRITE_REG(NVIC_REGS->icer, masked);
+    __asm__ volatile("dsb\n"
+                     "isb" : : : "memory");
+    ExitCritical(primask);
+    return masked;
+}
+
+HOT_FUNCTION
+void UnmaskIrqPriority(uint32_t masked) {
+    // Keep the section's memory accesses from moving past the unmask.
+    __asm__ volatile("" : : : "memory");
+    WRITE_REG(NVIC_REGS->iser, masked);
+}
+
+// The first barrier lets pending writes land before the reset, the second keeps anything after the
+// request from running before it takes effect.
+void ResetSystem() {
+    __asm__ volatile("dsb" : : : "memory");
+    WRITE_REG(SCB_REGS->aircr, (AIRCR_VECTKEY | AIRCR_SYSRESETREQ));
+    __asm__ volatile("dsb" : : : "memory");
+    while(1);
+}
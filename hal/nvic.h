@@ -0,0 +1,137 @@
+#ifndef HAL_NVIC_H_
+#define HAL_NVIC_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t iser, reserved0[31], icer, reserved1[31], ispr, reserved2[31], icpr,
+                      reserved3[95], ipr[8];
+} NvicRegisters;
+#define NVIC_BASE 0xE000E100
+#define NVIC_REGS ((NvicRegisters *)(NVIC_BASE))
+
+// System control block, for the priorities of the system exceptions (SHPR2/3) among others.
+typedef struct {
+    volatile uint32_t cpuid, icsr, vtor, aircr, scr, ccr, reserved, shpr2, shpr3, shcsr;
+} ScbRegisters;
+#define SCB_BASE 0xE000ED00
+#define SCB_REGS ((ScbRegisters *)(SCB_BASE))
+
+// STM32G0xx interrupt numbers (i.e. position in the vector table after the 16 ARM entries).
+typedef enum {
+    kIrqWwdg = 0,
+    kIrqPvd = 1,
+    kIrqRtcTamp = 2,
+    kIrqFlash = 3,
+    kIrqRcc = 4,
+    kIrqExti0To1 = 5,
+    kIrqExti2To3 = 6,
+    kIrqExti4To15 = 7,
+    kIrqDma1Channel1 = 9,
+    kIrqDma1Channel2To3 = 10,
+    kIrqDma1Channel4To5 = 11,
+    kIrqAdc = 12,
+    kIrqTim1BrkUpTrgCom = 13,
+    kIrqTim1Cc = 14,
+    kIrqTim2 = 15,
+    kIrqTim3 = 16,
+    kIrqLptim1 = 17,
+    kIrqLptim2 = 18,
+    kIrqTim14 = 19,
+    kIrqTim16 = 21,
+    kIrqTim17 = 22,
+    kIrqI2c1 = 23,
+    kIrqI2c2 = 24,
+    kIrqSpi1 = 25,
+    kIrqSpi2 = 26,
+    kIrqUsart1 = 27,
+    kIrqUsart2 = 28,
+    kIrqLpuart1 = 29,
+} Irq;
+
+// The system exceptions with a configurable priority, by exception number.
+typedef enum {
+    kSvc = 11,
+    kPendSv = 14,
+    kSysTick = 15,
+} SystemException;
+
+// The M0+ implements two priority bits, so there are four levels. A lower level preempts a higher
+// one, and equal levels don't preempt each other. Everything is kIrqPriorityHighest out of reset,
+// so nothing preempts anything until bulk work (DMA completions, logging) is moved down and
+// latency sensitive handlers are left at the top.
+typedef enum {
+    kIrqPriorityHighest, kIrqPriorityHigh, kIrqPriorityLow, kIrqPriorityLowest
+} IrqPriority;
+#define NUM_IRQ_PRIORITIES 4
+
+void EnableIrq(Irq irq);
+
+void DisableIrq(Irq irq);
+
+bool IsIrqEnabled(Irq irq);
+
+// Pend an interrupt from software, as if the peripheral had raised it.
+void SetIrqPending(Irq irq);
+
+// Drop a pending request, e.g. a stale one before enabling the IRQ.
+void ClearIrqPending(Irq irq);
+
+bool IsIrqPending(Irq irq);
+
+void SetIrqPriority(Irq irq, IrqPriority priority);
+
+IrqPriority GetIrqPriority(Irq irq);
+
+void SetSystemPriority(SystemException exception, IrqPriority priority);
+
+// Short critical sections, by masking all interrupts with PRIMASK. The M0+ has no LDREX/STREX, so
+// this is the only way to make a read-modify-write atomic against ISRs. Sections nest, since
+// ExitCritical() restores whatever EnterCritical() found rather than unmasking unconditionally:
+//
+//     uint32_t primask = EnterCritical();
+//     ...
+//     ExitCritical(primask);
+__attribute__((always_inline)) static inline uint32_t EnterCritical() {
+    uint32_t primask;
+    __asm__ volatile("mrs %0, primask\n"
+                     "cpsid i" : "=r" (primask) : : "memory");
+    return primask;
+}
+
+__attribute__((always_inline)) static inline void ExitCritical(uint32_t primask) {
+    __asm__ volatile("msr primask, %0" : : "r" (primask) : "memory");
+}
+
+// Critical sections against some interrupts only. The M0+ has no BASEPRI, so this is emulated by
+// disabling the enabled IRQs at `priority` and below (numerically at or above) in the NVIC, which
+// leaves the more urgent ones running. Requests that arrive meanwhile stay pending and are taken
+// on UnmaskIrqPriority(). Sections nest like EnterCritical(), and don't touch SysTick or the other
+// system exceptions. Don't enable or disable any of the masked IRQs inside a section.
+//
+//     uint32_t masked = MaskIrqPriority(kIrqPriorityLow);
+//     ...
+//     UnmaskIrqPriority(masked);
+uint32_t MaskIrqPriority(IrqPriority priority);
+
+void UnmaskIrqPriority(uint32_t masked);
+
+// The exception being handled, from IPSR: 0 in thread mode, 15 for SysTick, 16 + Irq for
+// interrupts.
+__attribute__((always_inline)) static inline uint32_t GetActiveException() {
+    uint32_t ipsr;
+    __asm__ volatile("mrs %0, ipsr" : "=r" (ipsr));
+    return ipsr;
+}
+
+// System reset through the SCB, as if the reset pin had been pulled. RAM keeps its contents.
+__attribute__((noreturn)) void ResetSystem();
+
+// Called on entry to and exit from every interrupt handler the HAL owns (timers and DMA). The
+// defaults in system.c are weak no-ops, and lib/trace overrides them to record ISR timing.
+void EnterIsrHook();
+
+void ExitIsrHook();
+
+#endif  // HAL_NVIC_H_
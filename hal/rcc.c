@@ -0,0 +1,77 @@
+#include "hal/rcc.h"
+
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+// RCC_CFGR fields.
+#define CFGR_SWS_POS 3
+#define CFGR_SWS_MASK (0b111 << CFGR_SWS_POS)
+#define CFGR_HPRE_POS 8
+#define CFGR_HPRE_MASK (0b1111 << CFGR_HPRE_POS)
+#define CFGR_PPRE_POS 12
+#define CFGR_PPRE_MASK (0b111 << CFGR_PPRE_POS)
+
+// RCC_CR fields.
+#define CR_HSIDIV_POS 11
+#define CR_HSIDIV_MASK (0b111 << CR_HSIDIV_POS)
+
+// RCC_PLLCFGR fields.
+#define PLLCFGR_PLLSRC_MASK 0b11
+#define PLLCFGR_PLLSRC_HSE 0b11
+#define PLLCFGR_PLLM_POS 4
+#define PLLCFGR_PLLM_MASK (0b111 << PLLCFGR_PLLM_POS)
+#define PLLCFGR_PLLN_POS 8
+#define PLLCFGR_PLLN_MASK (0b1111111 << PLLCFGR_PLLN_POS)
+#define PLLCFGR_PLLR_POS 29
+#define PLLCFGR_PLLR_MASK (0b111u << PLLCFGR_PLLR_POS)
+
+// Right shifts for the AHB prescaler values 0b1000 to 0b1111 (note that /32 doesn't exist).
+static const uint8_t kHpreShifts[8] = {1, 2, 3, 4, 6, 7, 8, 9};
+
+static uint32_t GetPllrClockHz() {
+    uint32_t pllcfgr = READ_REG(RCC_REGS->pllcfgr);
+    uint32_t input_hz = ((pllcfgr & PLLCFGR_PLLSRC_MASK) == PLLCFGR_PLLSRC_HSE) ? HSE_FREQ_HZ
+                                                                               : HSI16_FREQ_HZ;
+    uint32_t m = ((pllcfgr & PLLCFGR_PLLM_MASK) >> PLLCFGR_PLLM_POS) + 1;
+    uint32_t n = (pllcfgr & PLLCFGR_PLLN_MASK) >> PLLCFGR_PLLN_POS;
+    uint32_t r = ((pllcfgr & PLLCFGR_PLLR_MASK) >> PLLCFGR_PLLR_POS) + 1;
+    // The only non power of two divisions in the clock tree. This is not a hot path.
+    return (input_hz / m) * n / r;
+}
+
+uint32_t GetSysclkHz() {
+    switch ((READ_REG(RCC_REGS->cfgr) & CFGR_SWS_MASK) >> CFGR_SWS_POS) {
+        case 0b000:
+            return HSI16_FREQ_HZ >> ((READ_REG(RCC_REGS->cr) & CR_HSIDIV_MASK) >> CR_HSIDIV_POS);
+        case 0b001:
+            return HSE_FREQ_HZ;
+        case 0b010:
+            return GetPllrClockHz();
+        case 0b011:
+            return LSI_FREQ_HZ;
+        default:
+            return LSE_FREQ_HZ;
+    }
+}
+
+uint32_t GetHclkHz() {
+    uint32_t hpre = (READ_REG(RCC_REGS->cfgr) & CFGR_HPRE_MASK) >> CFGR_HPRE_POS;
+    if (hpre < 0b1000) {
+        return GetSysclkHz();
+    }
+    return GetSysclkHz() >> kHpreShifts[hpre - 0b1000];
+}
+
+uint32_t GetPclkHz() {
+    uint32_t ppre = (READ_REG(RCC_REGS->cfgr) & CFGR_PPRE_MASK) >> CFGR_PPRE_POS;
+    if (ppre < 0b100) {
+        return GetHclkHz();
+    }
+    return GetHclkHz() >> (ppre - 0b011);
+}
+
+uint32_t GetTimerClockHz() {
+    uint32_t ppre = (READ_REG(RCC_REGS->cfgr) & CFGR_PPRE_MASK) >> CFGR_PPRE_POS;
+    return (ppre < 0b100) ? GetPclkHz() : 2 * GetPclkHz();
+}
@@ -12,4 +12,41 @@ typedef struct {
 #define RCC_BASE 0x40021000
 #define RCC_REGS ((RccRegisters *)(RCC_BASE))
 
-#endif  // HAL_RCC_H_
\ No newline at end of file
+// Peripheral clock enable bits, see reference manual section 5.4.
+#define RCC_AHBENR_DMA1EN (1 << 0)
+#define RCC_AHBENR_CRCEN (1 << 12)
+#define RCC_APBENR1_TIM2EN (1 << 0)
+#define RCC_APBENR1_TIM3EN (1 << 1)
+#define RCC_APBENR1_SPI2EN (1 << 14)
+#define RCC_APBENR1_USART2EN (1 << 17)
+#define RCC_APBENR1_I2C1EN (1 << 21)
+#define RCC_APBENR1_I2C2EN (1 << 22)
+#define RCC_APBENR2_SYSCFGEN (1 << 0)
+#define RCC_APBENR2_TIM1EN (1 << 11)
+#define RCC_APBENR2_SPI1EN (1 << 12)
+#define RCC_APBENR2_USART1EN (1 << 14)
+#define RCC_APBENR2_TIM14EN (1 << 15)
+#define RCC_APBENR2_TIM16EN (1 << 17)
+#define RCC_APBENR2_TIM17EN (1 << 18)
+#define RCC_APBENR2_ADCEN (1 << 20)
+
+// Oscillator frequencies. The MCU boots from HSI16 with no dividers, so every clock is 16 MHz
+// until someone reconfigures the RCC.
+#define HSI16_FREQ_HZ 16000000
+#define LSI_FREQ_HZ 32000
+#define LSE_FREQ_HZ 32768
+#ifndef HSE_FREQ_HZ
+#define HSE_FREQ_HZ 8000000  // The Nucleo-G031K8 feeds the ST-Link 8 MHz MCO into OSC_IN.
+#endif
+
+// Decode the current RCC configuration into clock frequencies. The HSISYS, AHB and APB dividers are
+// powers of two, so those are shifts. Only a SYSCLK from the PLL takes the (slow) software divide
+// routines, for its M and R dividers, so read these once rather than in a hot path.
+uint32_t GetSysclkHz();
+uint32_t GetHclkHz();
+uint32_t GetPclkHz();
+
+// Timer kernel clock. The timers run at PCLK, or 2x PCLK when the APB prescaler is not 1.
+uint32_t GetTimerClockHz();
+
+#endif  // HAL_RCC_H_
@@ -0,0 +1,94 @@
+#ifndef HAL_REGISTER_H_
+#define HAL_REGISTER_H_
+
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+// Named register fields, so several fields of a register are updated with one read-modify-write
+// instead of a MODIFY_REG() each, and the reads and writes a field allows are checked when it
+// compiles. A field is defined once, next to its register struct, with its position, width and
+// access (the reference manual's rw, r, w and rc_w1):
+//
+//     #define GPIO_MODER_MODE(pin) REG_FIELD_RW(2 * (pin), 2)
+//
+// and used as many times as needed, up to eight fields per access:
+//
+//     UPDATE_FIELDS(GPIO_REGS(kGpioA)->moder, GPIO_MODER_MODE(2), kAlternateFunction,
+//                   GPIO_MODER_MODE(3), kAlternateFunction);
+//     WRITE_FIELDS(DMA1_REGS->ifcr, DMA_IFCR_FLAGS(kDmaChannel2), 0xF);
+//     uint32_t mode = READ_FIELD(GPIO_REGS(kGpioA)->moder, GPIO_MODER_MODE(2));
+//
+// UPDATE_FIELDS() reads the register once, replaces the fields and writes it back once. The masks
+// and shifts are constants whenever the positions are, so all of that folds into one mask and one
+// value at compile time, even at -O0. WRITE_FIELDS() writes the fields and zeros everywhere else,
+// without reading. Values are cut to the field's width.
+//
+// The access is part of the field's type: a field is a pointer to one of the types below, cast
+// from its position and width, and never dereferenced. So _Generic() turns a read-only field in
+// UPDATE_FIELDS() or WRITE_FIELDS() into a compile error, and the same for a write-only field in
+// UPDATE_FIELDS() or READ_FIELD(), and a write-1-to-clear field in UPDATE_FIELDS() (a
+// read-modify-write would clear every flag that's set), even when the position is only known at
+// run time.
+
+typedef struct RegRw RegRw;    // Read and write.
+typedef struct RegRo RegRo;    // Read only.
+typedef struct RegWo RegWo;    // Write only, reads as 0 or garbage.
+typedef struct RegW1c RegW1c;  // Reads a flag, writing 1 clears it and 0 does nothing.
+
+#define REG_FIELD_RW(shift, width) ((RegRw *)REG_FIELD_CODE(shift, width))
+#define REG_FIELD_RO(shift, width) ((RegRo *)REG_FIELD_CODE(shift, width))
+#define REG_FIELD_WO(shift, width) ((RegWo *)REG_FIELD_CODE(shift, width))
+#define REG_FIELD_W1C(shift, width) ((RegW1c *)REG_FIELD_CODE(shift, width))
+
+// A field's position and width, and its mask and value in the register.
+#define REG_FIELD_CODE(shift, width) ((uintptr_t)(shift) | ((uintptr_t)(width) << 8))
+#define FIELD_SHIFT(field) ((uint32_t)((uintptr_t)(field) & 0xFF))
+#define FIELD_WIDTH(field) ((uint32_t)((uintptr_t)(field) >> 8))
+#define FIELD_MASK(field) ((0xFFFFFFFFu >> (32 - FIELD_WIDTH(field))) << FIELD_SHIFT(field))
+#define FIELD_VALUE(field, value) (((uint32_t)(value) << FIELD_SHIFT(field)) & FIELD_MASK(field))
+
+#define UPDATE_FIELDS(reg, ...)                                                                    \
+    MODIFY_REG((reg), REG_FOR_PAIRS(REG_UPDATE_MASK, __VA_ARGS__),                                 \
+               REG_FOR_PAIRS(REG_UPDATE_VALUE, __VA_ARGS__))
+
+#define WRITE_FIELDS(reg, ...) WRITE_REG((reg), REG_FOR_PAIRS(REG_WRITE_VALUE, __VA_ARGS__))
+
+#define READ_FIELD(reg, field)                                                                     \
+    ((READ_REG(reg) & REG_READABLE(field)) >> FIELD_SHIFT(field))
+
+// The access checks: each passes the field through if its type allows the access, and doesn't
+// compile otherwise.
+#define REG_UPDATABLE(field) _Generic((field), RegRw *: FIELD_MASK(field))
+#define REG_WRITABLE(field)                                                                        \
+    _Generic((field), RegRw *: FIELD_MASK(field), RegWo *: FIELD_MASK(field),                      \
+             RegW1c *: FIELD_MASK(field))
+#define REG_READABLE(field)                                                                        \
+    _Generic((field), RegRw *: FIELD_MASK(field), RegRo *: FIELD_MASK(field),                      \
+             RegW1c *: FIELD_MASK(field))
+
+#define REG_UPDATE_MASK(field, value) REG_UPDATABLE(field)
+#define REG_UPDATE_VALUE(field, value)                                                             \
+    (((uint32_t)(value) << FIELD_SHIFT(field)) & REG_UPDATABLE(field))
+#define REG_WRITE_VALUE(field, value)                                                              \
+    (((uint32_t)(value) << FIELD_SHIFT(field)) & REG_WRITABLE(field))
+
+// Applies `op` to each field and value pair and ORs the results, for up to eight pairs.
+#define REG_FOR_PAIRS(op, ...) REG_FOR_PAIRS_(REG_NUM_ARGS(__VA_ARGS__), op, __VA_ARGS__)
+#define REG_FOR_PAIRS_(n, op, ...) REG_FOR_PAIRS__(n, op, __VA_ARGS__)
+#define REG_FOR_PAIRS__(n, op, ...) REG_PAIRS_##n(op, __VA_ARGS__)
+#define REG_PAIRS_2(op, f, v) (op(f, v))
+#define REG_PAIRS_4(op, f, v, ...) (op(f, v) | REG_PAIRS_2(op, __VA_ARGS__))
+#define REG_PAIRS_6(op, f, v, ...) (op(f, v) | REG_PAIRS_4(op, __VA_ARGS__))
+#define REG_PAIRS_8(op, f, v, ...) (op(f, v) | REG_PAIRS_6(op, __VA_ARGS__))
+#define REG_PAIRS_10(op, f, v, ...) (op(f, v) | REG_PAIRS_8(op, __VA_ARGS__))
+#define REG_PAIRS_12(op, f, v, ...) (op(f, v) | REG_PAIRS_10(op, __VA_ARGS__))
+#define REG_PAIRS_14(op, f, v, ...) (op(f, v) | REG_PAIRS_12(op, __VA_ARGS__))
+#define REG_PAIRS_16(op, f, v, ...) (op(f, v) | REG_PAIRS_14(op, __VA_ARGS__))
+#define REG_NUM_ARGS(...)                                                                          \
+    REG_NUM_ARGS_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define REG_NUM_ARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, n,   \
+                      ...)                                                                         \
+    n
+
+#endif  // HAL_REGISTER_H_
@@ -0,0 +1,197 @@
+#include "hal/spi.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+
+#define CR1_MSTR (1 << 2)
+#define CR1_BR_POS 3
+#define CR1_SPE (1 << 6)
+#define CR1_SSI (1 << 8)
+#define CR1_SSM (1 << 9)
+#define CR2_RXDMAEN (1 << 0)
+#define CR2_TXDMAEN (1 << 1)
+#define CR2_DS_8BIT (0x7 << 8)
+#define CR2_FRXTH (1 << 12)
+#define SR_RXNE (1 << 0)
+#define SR_TXE (1 << 1)
+#define SR_BSY (1 << 7)
+
+// The data register packs two frames into a 16 bit access, so always go through a byte pointer.
+#define SPI_DR8(regs) (*(volatile uint8_t *)&(regs)->dr)
+
+// Queued chains run from `tail` to `head`, both free running. `current` is the transaction on the
+// bus, 0 when idle.
+static struct {
+    DmaChannel rx_channel, tx_channel;
+    const SpiTransaction *queue[SPI_QUEUE_LENGTH];
+    volatile uint32_t head, tail;
+    const SpiTransaction *volatile current;
+} spi_state[kNumSpis];
+
+// Sent when there's no tx buffer, and where received bytes go when there's no rx buffer.
+static const uint8_t kFill = 0xFF;
+static uint8_t discard;
+
+uint32_t ConfigureSpi(Spi spi, SpiSettings settings) {
+    SpiRegisters *regs = SPI_REGS(spi);
+    if (spi == kSpi1) {
+        SET_BIT(RCC_REGS->apbenr2, RCC_APBENR2_SPI1EN);
+    } else {
+        SET_BIT(RCC_REGS->apbenr1, RCC_APBENR1_SPI2EN);
+    }
+    spi_state[spi].rx_channel = settings.rx_channel;
+    spi_state[spi].tx_channel = settings.tx_channel;
+
+    // SCK = PCLK / 2^(br + 1).
+    uint32_t pclk = GetPclkHz();
+    uint32_t br = 0;
+    while (br < 7 && (pclk >> (br + 1)) > settings.max_hz) {
+        br++;
+    }
+
+    CLEAR_BIT(regs->cr1, CR1_SPE);
+    // RXNE at every byte (FRXTH), and software slave select held high so the SPI stays a master.
+    WRITE_REG(regs->cr2, (CR2_DS_8BIT | CR2_FRXTH));
+    WRITE_REG(regs->cr1, (settings.mode | CR1_MSTR | (br << CR1_BR_POS) | CR1_SSI | CR1_SSM |
+                          CR1_SPE));
+    return pclk >> (br + 1);
+}
+
+void TransferSpi(Spi spi, const void *tx, void *rx, size_t count) {
+    SpiRegisters *regs = SPI_REGS(spi);
+    const uint8_t *tx_bytes = tx;
+    uint8_t *rx_bytes = rx;
+    while (count--) {
+        while (!READ_BIT(regs->sr, SR_TXE));
+        SPI_DR8(regs) = tx_bytes ? *tx_bytes++ : kFill;
+        while (!READ_BIT(regs->sr, SR_RXNE));
+        uint8_t byte = SPI_DR8(regs);
+        if (rx_bytes) {
+            *rx_bytes++ = byte;
+        }
+    }
+}
+
+static void HandleSpiDone(void *context, uint32_t events);
+
+// The receive channel gets the higher priority, so the receive FIFO is always drained in time, and
+// its completion (the last byte in) marks the end of the transaction.
+static void StartTransaction(Spi spi, const SpiTransaction *transaction) {
+    SpiRegisters *regs = SPI_REGS(spi);
+    DmaSettings rx_settings = {
+        .request = (spi == kSpi1) ? kDmaRequestSpi1Rx : kDmaRequestSpi2Rx,
+        .direction = kDmaPeripheralToMemory,
+        .peripheral_width = kDma8Bit,
+        .memory_width = kDma8Bit,
+        .peripheral_increment = false,
+        .memory_increment = transaction->rx != 0,
+        .circular = false,
+        .priority = kDmaPriorityVeryHigh,
+    };
+    DmaSettings tx_settings = {
+        .request = (spi == kSpi1) ? kDmaRequestSpi1Tx : kDmaRequestSpi2Tx,
+        .direction = kDmaMemoryToPeripheral,
+        .peripheral_width = kDma8Bit,
+        .memory_width = kDma8Bit,
+        .peripheral_increment = false,
+        .memory_increment = transaction->tx != 0,
+        .circular = false,
+        .priority = kDmaPriorityHigh,
+    };
+    spi_state[spi].current = transaction;
+    SetGpio(transaction->chip_select, false);
+    // The reference manual's order: receive DMA first, then transmit.
+    ConfigureDma(spi_state[spi].rx_channel, rx_settings, HandleSpiDone, (void *)(uintptr_t)spi);
+    ConfigureDma(spi_state[spi].tx_channel, tx_settings, HandleSpiDone, (void *)(uintptr_t)spi);
+    SET_BIT(regs->cr2, CR2_RXDMAEN);
+    StartDma(spi_state[spi].rx_channel, &regs->dr, transaction->rx ? transaction->rx : &discard,
+             transaction->count, (kDmaTransferComplete | kDmaTransferError));
+    // Only its errors, or the receive channel would wait for bytes that never go out.
+    StartDma(spi_state[spi].tx_channel, &regs->dr, transaction->tx ? transaction->tx : &kFill,
+             transaction->count, kDmaTransferError);
+    SET_BIT(regs->cr2, CR2_TXDMAEN);
+}
+
+// Start the next chain from the queue if the SPI is idle. Callers hold a critical section.
+static void StartQueued(Spi spi) {
+    if (spi_state[spi].current || spi_state[spi].tail == spi_state[spi].head) {
+        return;
+    }
+    uint32_t tail = spi_state[spi].tail;
+    spi_state[spi].tail = tail + 1;
+    StartTransaction(spi, spi_state[spi].queue[tail % SPI_QUEUE_LENGTH]);
+}
+
+// Drop what an aborted transaction left in the receive FIFO once the bus has gone quiet, so it
+// doesn't end up in the next one.
+static void FlushSpi(SpiRegisters *regs) {
+    while (READ_BIT(regs->sr, SR_BSY));
+    while (READ_BIT(regs->sr, SR_RXNE)) {
+        (void)SPI_DR8(regs);
+    }
+}
+
+// Runs from the receive channel's interrupt, or the transmit channel's on an error. The next
+// transaction goes out before the callback runs, so a slow callback doesn't leave the bus idle.
+HOT_FUNCTION
+static void HandleSpiDone(void *context, uint32_t events) {
+    Spi spi = (Spi)(uintptr_t)context;
+    SpiRegisters *regs = SPI_REGS(spi);
+    const SpiTransaction *done = spi_state[spi].current;
+    if (!done) {
+        return;
+    }
+    bool ok = !(events & kDmaTransferError);
+    StopDma(spi_state[spi].rx_channel);
+    StopDma(spi_state[spi].tx_channel);
+    CLEAR_BIT(regs->cr2, (CR2_RXDMAEN | CR2_TXDMAEN));
+    if (!ok) {
+        FlushSpi(regs);
+    }
+    if (!done->keep_selected || !ok) {
+        SetGpio(done->chip_select, true);
+    }
+
+    uint32_t primask = EnterCritical();
+    spi_state[spi].current = 0;
+    if (ok && done->next) {
+        StartTransaction(spi, done->next);
+    } else {
+        StartQueued(spi);
+    }
+    ExitCritical(primask);
+
+    if (done->callback) {
+        done->callback(done->context, ok);
+    }
+    // The rest of a failed chain never runs, but whoever queued it still has to hear about it.
+    for (const SpiTransaction *dropped = ok ? 0 : done->next; dropped; dropped = dropped->next) {
+        if (dropped->callback) {
+            dropped->callback(dropped->context, false);
+        }
+    }
+}
+
+bool QueueSpiTransaction(Spi spi, const SpiTransaction *transaction) {
+    uint32_t primask = EnterCritical();
+    if (spi_state[spi].head - spi_state[spi].tail == SPI_QUEUE_LENGTH) {
+        ExitCritical(primask);
+        return false;
+    }
+    spi_state[spi].queue[spi_state[spi].head % SPI_QUEUE_LENGTH] = transaction;
+    spi_state[spi].head++;
+    StartQueued(spi);
+    ExitCritical(primask);
+    return true;
+}
+
+bool IsSpiBusy(Spi spi) {
+    return spi_state[spi].current || spi_state[spi].head != spi_state[spi].tail;
+}
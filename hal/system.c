@@ -20,16 +20,73 @@ void* _sbrk(ptrdiff_t incr) {
     return (void *)previous_heap_end;
 }
 
+// Size of the compressed .data initializers at flash_data_start, or 0 if they're stored as they
+// are. The linked ELF always has 0. tools/pack_data.py compresses them in the .bin and sets this,
+// see `pack_data` in rules.bzl.
+__attribute__((section(".data_pack"), used))
+static volatile const uint32_t packed_data_size = 0;
+
+// Decompress LZ4's block format from `src` until `dst` reaches `end`. Each sequence is a token
+// (literal count << 4 | match length - 4, 15 meaning more length bytes follow), the literals, then
+// the match's 16 bit offset back from `dst`. The last sequence is only literals. Byte loops, since
+// a match can overlap what it's copying, and not turned into memcpy() calls before .bss is set up.
+// That's HOT_FUNCTION (hal/macros.h) plus the pattern flag, which every build needs. A second
+// optimize attribute replaces the first rather than adding to it, so they go in one.
+#ifdef __OPTIMIZE__
+#define UNPACK_FUNCTION __attribute__((optimize("no-tree-loop-distribute-patterns")))
+#else
+#define UNPACK_FUNCTION __attribute__((optimize("O2", "no-tree-loop-distribute-patterns")))
+#endif
+UNPACK_FUNCTION
+static void UnpackData(const uint8_t *src, uint8_t *dst, const uint8_t *end) {
+    while (1) {
+        uint32_t token = *src++;
+        uint32_t length = token >> 4;
+        if (length == 15) {
+            uint32_t more;
+            do {
+                more = *src++;
+                length += more;
+            } while (more == 255);
+        }
+        while (length--) {
+            *dst++ = *src++;
+        }
+        if (dst >= end) {
+            return;
+        }
+
+        const uint8_t *match = dst - (src[0] | (src[1] << 8));
+        src += 2;
+        length = (token & 0xF) + 4;
+        if ((token & 0xF) == 15) {
+            uint32_t more;
+            do {
+                more = *src++;
+                length += more;
+            } while (more == 255);
+        }
+        while (length--) {
+            *dst++ = *match++;
+        }
+    }
+}
+
 __attribute__((optimize("O0")))
 void ResetHandler() {
     // Linkerscript symbols
     extern uint32_t flash_data_start, ram_data_start, ram_data_end, bss_start, bss_end;
 
-    // Copy .data from flash to RAM
-    uint32_t *flash_data_src = &flash_data_start;
-    uint32_t *ram_data_dst = &ram_data_start;
-    while (ram_data_dst < &ram_data_end) {
-        *ram_data_dst++ = *flash_data_src++;
+    // Copy .data from flash to RAM, or decompress it there if the image was packed
+    if (packed_data_size) {
+        UnpackData((const uint8_t *)&flash_data_start, (uint8_t *)&ram_data_start,
+                   (const uint8_t *)&ram_data_end);
+    } else {
+        uint32_t *flash_data_src = &flash_data_start;
+        uint32_t *ram_data_dst = &ram_data_start;
+        while (ram_data_dst < &ram_data_end) {
+            *ram_data_dst++ = *flash_data_src++;
+        }
     }
 
     // Zero-initialize .bss section
@@ -45,6 +102,51 @@ void ResetHandler() {
     while(1);
 }
 
+// Any interrupt without a handler of its own ends up here. Spin so a debugger shows where we are.
+void DefaultHandler() {
+    while(1);
+}
+
+// See hal/nvic.h. Empty unless lib/trace is linked in.
+__attribute__((weak)) void EnterIsrHook() {}
+__attribute__((weak)) void ExitIsrHook() {}
+
+// Handlers are weak aliases of DefaultHandler, so drivers (or main.c) only define the ones they use.
+#define DEFAULT_HANDLER __attribute__((weak, alias("DefaultHandler")))
+void NmiHandler() DEFAULT_HANDLER;
+void HardFaultHandler() DEFAULT_HANDLER;
+void SvcHandler() DEFAULT_HANDLER;
+void PendSvHandler() DEFAULT_HANDLER;
+void SysTickHandler() DEFAULT_HANDLER;
+void WwdgHandler() DEFAULT_HANDLER;
+void PvdHandler() DEFAULT_HANDLER;
+void RtcTampHandler() DEFAULT_HANDLER;
+void FlashHandler() DEFAULT_HANDLER;
+void RccHandler() DEFAULT_HANDLER;
+void Exti0To1Handler() DEFAULT_HANDLER;
+void Exti2To3Handler() DEFAULT_HANDLER;
+void Exti4To15Handler() DEFAULT_HANDLER;
+void Dma1Channel1Handler() DEFAULT_HANDLER;
+void Dma1Channel2To3Handler() DEFAULT_HANDLER;
+void Dma1Channel4To5Handler() DEFAULT_HANDLER;
+void AdcHandler() DEFAULT_HANDLER;
+void Timer1BrkUpTrgComHandler() DEFAULT_HANDLER;
+void Timer1CcHandler() DEFAULT_HANDLER;
+void Timer2Handler() DEFAULT_HANDLER;
+void Timer3Handler() DEFAULT_HANDLER;
+void Lptimer1Handler() DEFAULT_HANDLER;
+void Lptimer2Handler() DEFAULT_HANDLER;
+void Timer14Handler() DEFAULT_HANDLER;
+void Timer16Handler() DEFAULT_HANDLER;
+void Timer17Handler() DEFAULT_HANDLER;
+void I2c1Handler() DEFAULT_HANDLER;
+void I2c2Handler() DEFAULT_HANDLER;
+void Spi1Handler() DEFAULT_HANDLER;
+void Spi2Handler() DEFAULT_HANDLER;
+void Usart1Handler() DEFAULT_HANDLER;
+void Usart2Handler() DEFAULT_HANDLER;
+void Lpuart1Handler() DEFAULT_HANDLER;
+
 // Defined in linkerscript
 extern void InitialStackPtr();
 
@@ -55,5 +157,44 @@ __attribute__((section(".vector_table")))
 void (*const vector_table[16 + 32])() = {
     InitialStackPtr,
     ResetHandler,
-    // Other interrupt/event handler function pointers would go here.
+    NmiHandler,
+    HardFaultHandler,
+    0, 0, 0, 0, 0, 0, 0,
+    SvcHandler,
+    0, 0,
+    PendSvHandler,
+    SysTickHandler,
+    // Start of the STM32G0xx specific entries, see reference manual table 54.
+    WwdgHandler,
+    PvdHandler,
+    RtcTampHandler,
+    FlashHandler,
+    RccHandler,
+    Exti0To1Handler,
+    Exti2To3Handler,
+    Exti4To15Handler,
+    0,
+    Dma1Channel1Handler,
+    Dma1Channel2To3Handler,
+    Dma1Channel4To5Handler,
+    AdcHandler,
+    Timer1BrkUpTrgComHandler,
+    Timer1CcHandler,
+    Timer2Handler,
+    Timer3Handler,
+    Lptimer1Handler,
+    Lptimer2Handler,
+    Timer14Handler,
+    0,
+    Timer16Handler,
+    Timer17Handler,
+    I2c1Handler,
+    I2c2Handler,
+    Spi1Handler,
+    Spi2Handler,
+    Usart1Handler,
+    Usart2Handler,
+    Lpuart1Handler,
+    0,
+    0,
 };
@@ -0,0 +1,223 @@
+#include "hal/timer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+
+#define CR1_CEN (1 << 0)
+#define CR1_ARPE (1 << 7)
+#define CR2_MMS_POS 4
+#define CR2_MMS_MASK (0b111 << CR2_MMS_POS)
+#define CR2_MMS2_POS 20
+#define CR2_MMS2_MASK (0b1111 << CR2_MMS2_POS)
+#define EGR_UG (1 << 0)
+#define BDTR_MOE (1 << 15)
+
+// Each channel owns one byte of CCMR1 (channels 1 and 2) or CCMR2 (channels 3 and 4).
+#define CCMR_CCS_POS 0
+#define CCMR_OCPE (1 << 3)
+#define CCMR_OCM_POS 4
+#define CCMR_OCM_BIT3 (1 << 16)
+#define CCMR_ICF_POS 4
+#define CCMR_CHANNEL_MASK (0xFF | CCMR_OCM_BIT3)
+
+// Each channel owns a nibble of CCER.
+#define CCER_CCE (1 << 0)
+#define CCER_CCP (1 << 1)
+#define CCER_CCNP (1 << 3)
+#define CCER_CHANNEL_MASK 0xF
+
+typedef struct {
+    bool apb2;  // Clock enable bit is in RCC_APBENR2 (instead of RCC_APBENR1).
+    uint32_t rcc_enable;
+    Irq irq;
+} TimerInfo;
+
+static const TimerInfo kTimerInfo[kNumTimers] = {
+    [kTimer1] = {.apb2 = true, .rcc_enable = RCC_APBENR2_TIM1EN, .irq = kIrqTim1BrkUpTrgCom},
+    [kTimer2] = {.apb2 = false, .rcc_enable = RCC_APBENR1_TIM2EN, .irq = kIrqTim2},
+    [kTimer3] = {.apb2 = false, .rcc_enable = RCC_APBENR1_TIM3EN, .irq = kIrqTim3},
+    [kTimer14] = {.apb2 = true, .rcc_enable = RCC_APBENR2_TIM14EN, .irq = kIrqTim14},
+    [kTimer16] = {.apb2 = true, .rcc_enable = RCC_APBENR2_TIM16EN, .irq = kIrqTim16},
+    [kTimer17] = {.apb2 = true, .rcc_enable = RCC_APBENR2_TIM17EN, .irq = kIrqTim17},
+};
+
+static struct {
+    TimerCallback callback;
+    void *context;
+} timer_callbacks[kNumTimers];
+
+static volatile uint32_t *Ccmr(TimerRegisters *regs, TimerChannel channel) {
+    return (channel < kTimerChannel3) ? &regs->ccmr1 : &regs->ccmr2;
+}
+
+static uint32_t CcmrShift(TimerChannel channel) {
+    return 8 * (channel & 1);
+}
+
+TimerTiming SolveTimerTiming(Timer timer, uint32_t clock_hz, uint32_t freq_hz) {
+    return TIMER_TIMING(timer, clock_hz, freq_hz);
+}
+
+void ConfigureTimer(Timer timer, TimerTiming timing) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    if (kTimerInfo[timer].apb2) {
+        SET_BIT(RCC_REGS->apbenr2, kTimerInfo[timer].rcc_enable);
+    } else {
+        SET_BIT(RCC_REGS->apbenr1, kTimerInfo[timer].rcc_enable);
+    }
+    CLEAR_BIT(regs->cr1, CR1_CEN);
+    WRITE_REG(regs->psc, timing.prescaler);
+    WRITE_REG(regs->arr, timing.reload);
+    // Buffer ARR so period changes take effect cleanly at the next update event.
+    SET_BIT(regs->cr1, CR1_ARPE);
+    // PSC is always buffered, so force an update event to load it now. That also sets the update
+    // flag, which would fire a spurious interrupt as soon as it's enabled, so clear it.
+    WRITE_REG(regs->egr, EGR_UG);
+    WRITE_REG(regs->sr, 0);
+}
+
+void StartTimer(Timer timer) {
+    SET_BIT(TIMER_REGS(timer)->cr1, CR1_CEN);
+}
+
+void StopTimer(Timer timer) {
+    CLEAR_BIT(TIMER_REGS(timer)->cr1, CR1_CEN);
+}
+
+void ConfigureTimerOutput(Timer timer, TimerChannel channel, TimerOutputMode mode,
+                          uint32_t compare) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    uint32_t shift = CcmrShift(channel);
+    // CCxS = 0 (output), preload enabled so CCR writes land on update events (no glitches).
+    MODIFY_REG(*Ccmr(regs, channel), (CCMR_CHANNEL_MASK << shift),
+               (((mode << CCMR_OCM_POS) | CCMR_OCPE) << shift));
+    WRITE_REG(regs->ccr[channel], compare);
+    MODIFY_REG(regs->ccer, (CCER_CHANNEL_MASK << (4 * channel)), (CCER_CCE << (4 * channel)));
+    if (timer == kTimer1 || timer == kTimer16 || timer == kTimer17) {
+        // Timers with break/dead-time support also need the main output enable.
+        SET_BIT(regs->bdtr, BDTR_MOE);
+    }
+}
+
+void SetTimerCompare(Timer timer, TimerChannel channel, uint32_t compare) {
+    WRITE_REG(TIMER_REGS(timer)->ccr[channel], compare);
+}
+
+void SetTimerDuty(Timer timer, TimerChannel channel, uint16_t duty) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    uint64_t period = (uint64_t)READ_REG(regs->arr) + 1;
+    WRITE_REG(regs->ccr[channel], (uint32_t)((period * duty) >> 16));
+}
+
+void ConfigureTimerCapture(Timer timer, TimerChannel channel, TimerCaptureSettings settings) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    uint32_t shift = CcmrShift(channel);
+    uint32_t polarity = 0;
+    if (settings.edge == kTimerFallingEdge) {
+        polarity = CCER_CCP;
+    } else if (settings.edge == kTimerBothEdges) {
+        polarity = CCER_CCP | CCER_CCNP;
+    }
+    // Disable the channel first, CCxS is only writable while CCxE is cleared.
+    CLEAR_BIT(regs->ccer, (CCER_CCE << (4 * channel)));
+    MODIFY_REG(*Ccmr(regs, channel), (CCMR_CHANNEL_MASK << shift),
+               (((settings.input << CCMR_CCS_POS) | ((settings.filter & 0xF) << CCMR_ICF_POS))
+                << shift));
+    MODIFY_REG(regs->ccer, (CCER_CHANNEL_MASK << (4 * channel)),
+               ((polarity | CCER_CCE) << (4 * channel)));
+}
+
+uint32_t GetTimerCapture(Timer timer, TimerChannel channel) {
+    return READ_REG(TIMER_REGS(timer)->ccr[channel]);
+}
+
+void EnableTimerInterrupts(Timer timer, uint32_t events, TimerCallback callback, void *context) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    Irq irq = kTimerInfo[timer].irq;
+    DisableIrq(irq);
+    if (timer == kTimer1) {
+        DisableIrq(kIrqTim1Cc);
+    }
+    timer_callbacks[timer].callback = callback;
+    timer_callbacks[timer].context = context;
+    WRITE_REG(regs->dier, ((READ_REG(regs->dier) & ~0xFF) | (events & 0xFF)));
+    if (events == 0) {
+        return;
+    }
+    EnableIrq(irq);
+    if (timer == kTimer1) {
+        EnableIrq(kIrqTim1Cc);
+    }
+}
+
+void SetTimerTriggerOutput(Timer timer, TimerTriggerOutput trigger) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    if (timer == kTimer1) {
+        // The first 8 MMS2 values match MMS.
+        MODIFY_REG(regs->cr2, (CR2_MMS_MASK | CR2_MMS2_MASK),
+                   ((trigger << CR2_MMS_POS) | (trigger << CR2_MMS2_POS)));
+    } else {
+        MODIFY_REG(regs->cr2, CR2_MMS_MASK, (trigger << CR2_MMS_POS));
+    }
+}
+
+void EnableTimerDmaRequests(Timer timer, uint32_t requests) {
+    MODIFY_REG(TIMER_REGS(timer)->dier, (0x7F << 8), (requests & (0x7F << 8)));
+}
+
+static void HandleTimerInterrupt(Timer timer) {
+    TimerRegisters *regs = TIMER_REGS(timer);
+    uint32_t events = READ_REG(regs->sr) & READ_REG(regs->dier) & 0xFF;
+    // Status flags are cleared by writing 0, and writing 1 has no effect. So write back only the
+    // flags being handled, without a read-modify-write that could drop a freshly set flag.
+    WRITE_REG(regs->sr, ~events);
+    if (timer_callbacks[timer].callback) {
+        timer_callbacks[timer].callback(timer_callbacks[timer].context, events);
+    }
+}
+
+void Timer1BrkUpTrgComHandler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer1);
+    ExitIsrHook();
+}
+
+void Timer1CcHandler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer1);
+    ExitIsrHook();
+}
+
+void Timer2Handler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer2);
+    ExitIsrHook();
+}
+
+void Timer3Handler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer3);
+    ExitIsrHook();
+}
+
+void Timer14Handler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer14);
+    ExitIsrHook();
+}
+
+void Timer16Handler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer16);
+    ExitIsrHook();
+}
+
+void Timer17Handler() {
+    EnterIsrHook();
+    HandleTimerInterrupt(kTimer17);
+    ExitIsrHook();
+}
@@ -0,0 +1,148 @@
+#ifndef HAL_TIMER_H_
+#define HAL_TIMER_H_
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t cr1, cr2, smcr, dier, sr, egr, ccmr1, ccmr2, ccer, cnt, psc, arr, rcr, ccr[4],
+                      bdtr, dcr, dmar, or1, ccmr3, ccr5, ccr6, af1, af2, tisel;
+} TimerRegisters;
+#define TIM1_BASE 0x40012C00
+#define TIM2_BASE 0x40000000
+#define TIM3_BASE 0x40000400
+#define TIM14_BASE 0x40002000
+#define TIM16_BASE 0x40014400
+#define TIM17_BASE 0x40014800
+
+// General purpose and advanced control timers available on the STM32G031.
+typedef enum {
+    kTimer1, kTimer2, kTimer3, kTimer14, kTimer16, kTimer17, kNumTimers
+} Timer;
+
+// Folds to a constant address when `timer` is a constant.
+#define TIMER_BASE(timer)                                                                          \
+    ((timer) == kTimer1 ? TIM1_BASE : (timer) == kTimer2 ? TIM2_BASE                               \
+   : (timer) == kTimer3 ? TIM3_BASE : (timer) == kTimer14 ? TIM14_BASE                             \
+   : (timer) == kTimer16 ? TIM16_BASE : TIM17_BASE)
+#define TIMER_REGS(timer) ((TimerRegisters *)(TIMER_BASE(timer)))
+
+typedef enum {
+    kTimerChannel1, kTimerChannel2, kTimerChannel3, kTimerChannel4
+} TimerChannel;
+
+// Status/interrupt flags. These bits line up in both TIMx_SR and TIMx_DIER.
+typedef enum {
+    kTimerUpdateEvent = (1 << 0),
+    kTimerCc1Event = (1 << 1),
+    kTimerCc2Event = (1 << 2),
+    kTimerCc3Event = (1 << 3),
+    kTimerCc4Event = (1 << 4),
+    kTimerTriggerEvent = (1 << 6),
+} TimerEvent;
+
+// DMA request enables in TIMx_DIER. Route the matching DmaRequest to a DMA channel to use them.
+typedef enum {
+    kTimerUpdateDma = (1 << 8),
+    kTimerCc1Dma = (1 << 9),
+    kTimerCc2Dma = (1 << 10),
+    kTimerCc3Dma = (1 << 11),
+    kTimerCc4Dma = (1 << 12),
+} TimerDmaRequest;
+
+// Trigger output (TRGO) sources, i.e. the MMS field in TIMx_CR2. Used to trigger the ADC or other
+// timers in lock step.
+typedef enum {
+    kTimerTriggerReset, kTimerTriggerEnable, kTimerTriggerUpdate, kTimerTriggerComparePulse,
+    kTimerTriggerOc1Ref, kTimerTriggerOc2Ref, kTimerTriggerOc3Ref, kTimerTriggerOc4Ref
+} TimerTriggerOutput;
+
+// Values of the OCxM field in TIMx_CCMRx.
+typedef enum {
+    kTimerFrozen, kTimerActiveOnMatch, kTimerInactiveOnMatch, kTimerToggle, kTimerForceInactive,
+    kTimerForceActive, kTimerPwm1, kTimerPwm2
+} TimerOutputMode;
+
+typedef enum {
+    kTimerRisingEdge, kTimerFallingEdge, kTimerBothEdges
+} TimerCaptureEdge;
+
+// Which input a capture channel latches on: its own pin (direct), or its neighbour's pin
+// (indirect, i.e. CH1 <-> CH2 and CH3 <-> CH4). Indirect mode lets two channels capture both edges
+// of a single pin, like the PWM input mode in the reference manual.
+typedef enum {
+    kTimerInputDirect = 0b01, kTimerInputIndirect = 0b10
+} TimerCaptureInput;
+
+typedef struct {
+    TimerCaptureEdge edge;
+    TimerCaptureInput input;
+    uint8_t filter;  // ICxF digital filter, 0 (off) to 15.
+} TimerCaptureSettings;
+
+// Counter clock = timer clock / (prescaler + 1) and period = (reload + 1) counter ticks.
+typedef struct {
+    uint32_t prescaler;
+    uint32_t reload;
+} TimerTiming;
+
+// Prescaler/reload solver. For a given timer clock and update frequency, the smallest prescaler
+// whose reload still fits in the counter gives the finest resolution (the most PWM steps). These
+// are plain constant expressions, so with constant inputs they fold at compile time, even at -O0:
+//
+//     static const TimerTiming kPwmTiming = TIMER_TIMING(kTimer3, HSI16_FREQ_HZ, 1000);
+//
+// With runtime inputs they fall back to a 64 bit software divide, so keep them out of hot paths.
+#define TIMER_MAX_RELOAD(timer) ((timer) == kTimer2 ? 0xFFFFFFFFu : 0xFFFFu)
+#define TIMER_MAX_PRESCALER 0xFFFFu
+#define TIMER_PRESCALER(timer, clock_hz, freq_hz)                                                  \
+    ((uint32_t)(((uint64_t)(clock_hz) - 1) /                                                       \
+                ((uint64_t)(freq_hz) * ((uint64_t)TIMER_MAX_RELOAD(timer) + 1))))
+#define TIMER_RELOAD(timer, clock_hz, freq_hz)                                                     \
+    ((uint32_t)((((uint64_t)(clock_hz) +                                                           \
+                  ((uint64_t)TIMER_PRESCALER(timer, clock_hz, freq_hz) + 1) * (freq_hz) / 2) /     \
+                 (((uint64_t)TIMER_PRESCALER(timer, clock_hz, freq_hz) + 1) * (freq_hz))) - 1))
+#define TIMER_TIMING(timer, clock_hz, freq_hz)                                                     \
+    ((TimerTiming){.prescaler = TIMER_PRESCALER(timer, clock_hz, freq_hz),                         \
+                   .reload = TIMER_RELOAD(timer, clock_hz, freq_hz)})
+// False when the frequency is out of reach of the timer (too fast, or too slow for the prescaler).
+// Handy in a _Static_assert next to a TIMER_TIMING.
+#define TIMER_TIMING_VALID(timer, clock_hz, freq_hz)                                               \
+    ((uint64_t)(freq_hz) != 0 && (uint64_t)(freq_hz) * 2 <= (uint64_t)(clock_hz) &&                \
+     TIMER_PRESCALER(timer, clock_hz, freq_hz) <= TIMER_MAX_PRESCALER)
+
+// Runtime version of TIMER_TIMING, e.g. SolveTimerTiming(kTimer3, GetTimerClockHz(), 1000).
+TimerTiming SolveTimerTiming(Timer timer, uint32_t clock_hz, uint32_t freq_hz);
+
+// Called from the timer's interrupt handler with the (already cleared) TimerEvent flags.
+typedef void (*TimerCallback)(void *context, uint32_t events);
+
+// Enable the timer clock and load the prescaler and reload values. The timer is left stopped.
+void ConfigureTimer(Timer timer, TimerTiming timing);
+
+void StartTimer(Timer timer);
+
+void StopTimer(Timer timer);
+
+// Output compare and PWM. Remember to put the pin in the timer's alternate function mode.
+void ConfigureTimerOutput(Timer timer, TimerChannel channel, TimerOutputMode mode,
+                          uint32_t compare);
+
+void SetTimerCompare(Timer timer, TimerChannel channel, uint32_t compare);
+
+// Duty cycle as a 0.16 fixed point fraction of the period, i.e. 0x8000 is 50%.
+void SetTimerDuty(Timer timer, TimerChannel channel, uint16_t duty);
+
+void ConfigureTimerCapture(Timer timer, TimerChannel channel, TimerCaptureSettings settings);
+
+uint32_t GetTimerCapture(Timer timer, TimerChannel channel);
+
+// Route TimerEvent interrupts to `callback`. Pass a 0 mask to disable them again.
+void EnableTimerInterrupts(Timer timer, uint32_t events, TimerCallback callback, void *context);
+
+// Select the TRGO source. On TIM1 this sets TRGO2 (the one the ADC listens to) as well.
+void SetTimerTriggerOutput(Timer timer, TimerTriggerOutput trigger);
+
+// Set the TimerDmaRequest enables. Pass a 0 mask to disable them again.
+void EnableTimerDmaRequests(Timer timer, uint32_t requests);
+
+#endif  // HAL_TIMER_H_
@@ -0,0 +1,106 @@
+#include "hal/usart.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/rcc.h"
+
+#define CR1_UE (1 << 0)
+#define CR1_RE (1 << 2)
+#define CR1_TE (1 << 3)
+#define CR3_DMAR (1 << 6)
+#define CR3_DMAT (1 << 7)
+#define CR3_OVRDIS (1 << 12)
+#define ISR_RXNE (1 << 5)
+#define ISR_TC (1 << 6)
+#define ISR_TXE (1 << 7)
+#define ICR_TCCF (1 << 6)
+
+static struct {
+    UsartCallback callback;
+    void *context;
+} usart_dma[kNumUsarts];
+
+void ConfigureUsart(Usart usart, uint32_t baud) {
+    UsartRegisters *regs = USART_REGS(usart);
+    if (usart == kUsart1) {
+        SET_BIT(RCC_REGS->apbenr2, RCC_APBENR2_USART1EN);
+    } else {
+        SET_BIT(RCC_REGS->apbenr1, RCC_APBENR1_USART2EN);
+    }
+    CLEAR_BIT(regs->cr1, CR1_UE);
+    // Oversampling by 16, rounded to the nearest divider. Runs once, so the division is fine.
+    WRITE_REG(regs->brr, (GetPclkHz() + baud / 2) / baud);
+    WRITE_REG(regs->cr1, (CR1_TE | CR1_RE | CR1_UE));
+}
+
+void WriteUsart(Usart usart, const void *data, size_t count) {
+    UsartRegisters *regs = USART_REGS(usart);
+    const uint8_t *bytes = data;
+    while (count--) {
+        while (!READ_BIT(regs->isr, ISR_TXE));
+        WRITE_REG(regs->tdr, *bytes++);
+    }
+    while (!READ_BIT(regs->isr, ISR_TC));
+}
+
+bool ReadUsart(Usart usart, uint8_t *byte) {
+    UsartRegisters *regs = USART_REGS(usart);
+    if (!READ_BIT(regs->isr, ISR_RXNE)) {
+        return false;
+    }
+    *byte = (uint8_t)READ_REG(regs->rdr);
+    return true;
+}
+
+static void HandleUsartDma(void *context, uint32_t events) {
+    Usart usart = (Usart)(uintptr_t)context;
+    if (usart_dma[usart].callback) {
+        usart_dma[usart].callback(usart_dma[usart].context, !(events & kDmaTransferError));
+    }
+}
+
+void StartUsartDma(Usart usart, DmaChannel channel, const void *data, uint16_t count,
+                   UsartCallback callback, void *context) {
+    UsartRegisters *regs = USART_REGS(usart);
+    usart_dma[usart].callback = callback;
+    usart_dma[usart].context = context;
+    DmaSettings settings = {
+        .request = (usart == kUsart1) ? kDmaRequestUsart1Tx : kDmaRequestUsart2Tx,
+        .direction = kDmaMemoryToPeripheral,
+        .peripheral_width = kDma8Bit,
+        .memory_width = kDma8Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = false,
+        .priority = kDmaPriorityLow,
+    };
+    ConfigureDma(channel, settings, HandleUsartDma, (void *)(uintptr_t)usart);
+    SET_BIT(regs->cr3, CR3_DMAT);
+    StartDma(channel, &regs->tdr, data, count, (kDmaTransferComplete | kDmaTransferError));
+}
+
+// With overrun detection off, a byte the DMA misses is simply overwritten instead of stopping the
+// receiver until ORE is cleared.
+void StartUsartReceiveDma(Usart usart, DmaChannel channel, void *buffer, uint16_t count) {
+    UsartRegisters *regs = USART_REGS(usart);
+    DmaSettings settings = {
+        .request = (usart == kUsart1) ? kDmaRequestUsart1Rx : kDmaRequestUsart2Rx,
+        .direction = kDmaPeripheralToMemory,
+        .peripheral_width = kDma8Bit,
+        .memory_width = kDma8Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = true,
+        .priority = kDmaPriorityHigh,
+    };
+    ConfigureDma(channel, settings, 0, 0);
+    // OVRDIS can only change while the USART is disabled.
+    CLEAR_BIT(regs->cr1, CR1_UE);
+    SET_BIT(regs->cr3, (CR3_DMAR | CR3_OVRDIS));
+    SET_BIT(regs->cr1, CR1_UE);
+    StartDma(channel, &regs->rdr, buffer, count, 0);
+}
@@ -0,0 +1,51 @@
+#ifndef HAL_USART_H_
+#define HAL_USART_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+
+typedef struct {
+    volatile uint32_t cr1, cr2, cr3, brr, gtpr, rtor, rqr, isr, icr, rdr, tdr, presc;
+} UsartRegisters;
+#define USART1_BASE 0x40013800
+#define USART2_BASE 0x40004400
+
+typedef enum {
+    kUsart1, kUsart2, kNumUsarts
+} Usart;
+
+#define USART_BASE(usart) ((usart) == kUsart1 ? USART1_BASE : USART2_BASE)
+#define USART_REGS(usart) ((UsartRegisters *)(USART_BASE(usart)))
+
+// Asynchronous 8N1 serial. The baud rate divider comes from the current PCLK (GetPclkHz()), so
+// configure the clocks first. Put the pins in kAlternateFunction mode too. On the Nucleo-G031K8,
+// the ST-Link virtual COM port is USART2 on PA2 (TX) and PA3 (RX), both AF1.
+
+// Called from the DMA interrupt once the last byte of a transmission has been handed to the USART
+// (it's still shifting out), with `ok` set. A DMA transfer error stops the transmission part way,
+// and then `ok` is false.
+typedef void (*UsartCallback)(void *context, bool ok);
+
+// Enable the clock, and enable the transmitter and receiver at `baud`.
+void ConfigureUsart(Usart usart, uint32_t baud);
+
+// Blocking transmit.
+void WriteUsart(Usart usart, const void *data, size_t count);
+
+// Non-blocking receive. Returns false if no byte has arrived.
+bool ReadUsart(Usart usart, uint8_t *byte);
+
+// Transmit `count` bytes with the DMA in the background. `data` must stay untouched until the
+// callback runs.
+void StartUsartDma(Usart usart, DmaChannel channel, const void *data, uint16_t count,
+                   UsartCallback callback, void *context);
+
+// Receive into `buffer` with the DMA in circular mode, from now on. Byte n lands at
+// buffer[n % count], so the write position is count - GetDmaRemaining(channel). Nothing stops the
+// DMA from lapping the reader, so size the buffer (or flow control the sender) accordingly.
+void StartUsartReceiveDma(Usart usart, DmaChannel channel, void *buffer, uint16_t count);
+
+#endif  // HAL_USART_H_
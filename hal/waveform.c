@@ -0,0 +1,138 @@
+#include "hal/waveform.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/timer.h"
+
+#define DCR_DBA_POS 0
+#define DCR_DBL_POS 8
+// DMAR burst base address of TIMx_CCR1, in words from the start of the timer registers.
+#define DCR_DBA_CCR1 13
+
+// DMAMUX update requests, kDmaRequestMemory marks timers without one.
+static const DmaRequest kUpdateRequests[kNumTimers] = {
+    [kTimer1] = kDmaRequestTim1Up,
+    [kTimer2] = kDmaRequestTim2Up,
+    [kTimer3] = kDmaRequestTim3Up,
+    [kTimer14] = kDmaRequestMemory,
+    [kTimer16] = kDmaRequestTim16Up,
+    [kTimer17] = kDmaRequestTim17Up,
+};
+
+static uint16_t *Half(const WaveformSettings *settings, int8_t half) {
+    return settings->buffer + half * settings->half_length * settings->num_channels;
+}
+
+// Fill `half` with the refill callback, and note if that was the end of the waveform.
+static void Refill(Waveform *waveform, int8_t half) {
+    const WaveformSettings *settings = &waveform->settings;
+    if (!settings->refill(settings->context, Half(settings, half),
+                          settings->half_length * settings->num_channels)) {
+        waveform->final_half = half;
+    }
+}
+
+// Hold the last sample(s) of the final half, in case the DMA wraps into `half` before the engine
+// gets to stop it.
+static void FillIdle(Waveform *waveform, int8_t half) {
+    const WaveformSettings *settings = &waveform->settings;
+    uint32_t count = settings->half_length * settings->num_channels;
+    const uint16_t *last = Half(settings, waveform->final_half) + count - settings->num_channels;
+    uint16_t *samples = Half(settings, half);
+    for (uint32_t i = 0; i < count; i += settings->num_channels) {
+        for (uint32_t channel = 0; channel < settings->num_channels; channel++) {
+            samples[i + channel] = last[channel];
+        }
+    }
+}
+
+static void HandleHalfPlayed(Waveform *waveform, int8_t half) {
+    if (!waveform->running) {
+        return;
+    }
+    if (waveform->final_played) {
+        StopWaveform(waveform);
+    } else if (waveform->final_half == half) {
+        // Its last sample(s) only went into the CCRs' preload at this update, and play for the next
+        // period. The other half holds them, so stop once that has played too.
+        waveform->final_played = true;
+    } else if (waveform->final_half >= 0) {
+        FillIdle(waveform, half);
+    } else {
+        Refill(waveform, half);
+    }
+}
+
+static void HandleWaveformDma(void *context, uint32_t events) {
+    Waveform *waveform = context;
+    if (events & kDmaTransferError) {
+        StopWaveform(waveform);
+        return;
+    }
+    // Both flags can be set at once if this interrupt was held off for long. Handle them in the
+    // order the halves played.
+    if (events & kDmaHalfTransfer) {
+        HandleHalfPlayed(waveform, 0);
+    }
+    if (events & kDmaTransferComplete) {
+        HandleHalfPlayed(waveform, 1);
+    }
+}
+
+bool StartWaveform(Waveform *waveform, WaveformSettings settings) {
+    if (kUpdateRequests[settings.timer] == kDmaRequestMemory ||
+        2 * (uint32_t)settings.half_length * settings.num_channels > UINT16_MAX) {
+        return false;
+    }
+    waveform->settings = settings;
+    waveform->final_half = -1;
+    waveform->final_played = false;
+    Refill(waveform, 0);
+    if (waveform->final_half < 0) {
+        Refill(waveform, 1);
+    } else {
+        FillIdle(waveform, 1);
+    }
+
+    TimerRegisters *regs = TIMER_REGS(settings.timer);
+    volatile uint32_t *destination = &regs->ccr[settings.first_channel];
+    if (settings.num_channels > 1) {
+        // Each update event now asks for num_channels transfers, all through DMAR.
+        WRITE_REG(regs->dcr, (((settings.num_channels - 1) << DCR_DBL_POS) |
+                              ((DCR_DBA_CCR1 + settings.first_channel) << DCR_DBA_POS)));
+        destination = &regs->dmar;
+    }
+    DmaSettings dma_settings = {
+        .request = kUpdateRequests[settings.timer],
+        .direction = kDmaMemoryToPeripheral,
+        // 16 bit samples get zero extended, so the 32 bit CCRs of TIM2 work too.
+        .peripheral_width = kDma32Bit,
+        .memory_width = kDma16Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = true,
+        .priority = kDmaPriorityHigh,
+    };
+    ConfigureDma(settings.dma_channel, dma_settings, HandleWaveformDma, waveform);
+    waveform->running = true;
+    StartDma(settings.dma_channel, destination, settings.buffer,
+             2 * settings.half_length * settings.num_channels,
+             (kDmaHalfTransfer | kDmaTransferComplete | kDmaTransferError));
+    EnableTimerDmaRequests(settings.timer, kTimerUpdateDma);
+    StartTimer(settings.timer);
+    return true;
+}
+
+void StopWaveform(Waveform *waveform) {
+    StopTimer(waveform->settings.timer);
+    EnableTimerDmaRequests(waveform->settings.timer, 0);
+    StopDma(waveform->settings.dma_channel);
+    waveform->running = false;
+}
+
+bool IsWaveformRunning(const Waveform *waveform) {
+    return waveform->running;
+}
@@ -0,0 +1,58 @@
+#ifndef HAL_WAVEFORM_H_
+#define HAL_WAVEFORM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/timer.h"
+
+// DMA fed timer waveforms. On every update event the DMA copies the next compare value(s) from a
+// double buffered sample array into the timer's CCR register(s), so every PWM period can have its
+// own duty cycle with no CPU work per period. Useful for WS2812 style LED strips (one sample per
+// bit), stepper microstep tables, or PWM audio.
+//
+// With `num_channels` > 1 the samples are interleaved (ch1, ch2, ..., ch1, ch2, ...) and written
+// with a DMAR burst to consecutive channels starting at `first_channel`.
+//
+// The timer has to be set up first with ConfigureTimer() and ConfigureTimerOutput() for each
+// channel (usually in kTimerPwm1 mode). TIM14 has no DMA request, so it can't be used here.
+
+// Fill `samples` (`count` values, already interleaved) with the next part of the waveform. This
+// runs from the DMA interrupt while the other half of the buffer plays, so it has one half buffer
+// worth of update periods to finish. Return false once the waveform is done; the samples written
+// in that call still play out, then the engine holds the last one(s) for up to another half buffer
+// of periods and stops itself.
+typedef bool (*WaveformRefill)(void *context, uint16_t *samples, uint32_t count);
+
+typedef struct {
+    Timer timer;
+    TimerChannel first_channel;
+    uint8_t num_channels;
+    DmaChannel dma_channel;
+    // Double buffer of 2 * half_length * num_channels samples, at most 65535 (the DMA's count).
+    uint16_t *buffer;
+    uint16_t half_length;
+    WaveformRefill refill;
+    void *context;
+} WaveformSettings;
+
+typedef struct {
+    WaveformSettings settings;
+    // Which half holds the last samples (0 or 1), or -1 while the waveform keeps going.
+    volatile int8_t final_half;
+    // Set once the final half has been handed to the timer. The engine stops after the next half.
+    volatile bool final_played;
+    volatile bool running;
+} Waveform;
+
+// Prime both halves with the refill callback, then start the DMA and the timer. Returns false if
+// the timer has no DMA request, or the buffer is longer than the DMA can count.
+bool StartWaveform(Waveform *waveform, WaveformSettings settings);
+
+// Stop the DMA and the timer immediately.
+void StopWaveform(Waveform *waveform);
+
+bool IsWaveformRunning(const Waveform *waveform);
+
+#endif  // HAL_WAVEFORM_H_
@@ -0,0 +1,150 @@
+#include "lib/bench.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+#if defined(__arm__)
+#include "hal/cycle_counter.h"
+#include "hal/rcc.h"
+
+#define BENCH_UNIT "cycles"
+
+uint32_t GetBenchTime() {
+    return GetCycles();
+}
+
+static void StartBenchTime() {
+    StartCycleCounter();
+}
+
+static uint32_t GetBenchClockHz() {
+    return GetTimerClockHz();
+}
+#else
+#include <time.h>
+
+#define BENCH_UNIT "ns"
+
+uint32_t GetBenchTime() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+
+static void StartBenchTime() {}
+
+static uint32_t GetBenchClockHz() {
+    return 1000000000;
+}
+#endif
+
+static struct {
+    BenchWriter writer;
+    const char *suite;
+    uint32_t overhead;  // Minimum time RunBench() measures for an empty function.
+    uint32_t count;
+} bench;
+
+static void WriteText(const char *text) {
+    size_t length = 0;
+    while (text[length]) {
+        length++;
+    }
+    bench.writer(text, length);
+}
+
+static void WriteNumber(uint32_t value) {
+    char digits[10];
+    size_t i = sizeof(digits);
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    bench.writer(&digits[i], sizeof(digits) - i);
+}
+
+// Names are written as they are, so keep quotes and backslashes out of them.
+static void WriteField(const char *key, const char *text, uint32_t value, const char *separator) {
+    WriteText("\"");
+    WriteText(key);
+    WriteText("\": ");
+    if (text) {
+        WriteText("\"");
+        WriteText(text);
+        WriteText("\"");
+    } else {
+        WriteNumber(value);
+    }
+    WriteText(separator);
+}
+
+static void DoNothing(void *context) {
+    (void)context;
+}
+
+// Times calls to `function`, minus `overhead`. Hot, to keep the harness's share of each measurement
+// small and steady.
+HOT_FUNCTION
+static BenchResult TimeCalls(BenchFunction function, void *context, uint32_t overhead) {
+    BenchResult result = {0};
+    function(context);
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        uint32_t start = GetBenchTime();
+        function(context);
+        uint32_t time = GetBenchTime() - start;
+        AddBenchSample(&result, time > overhead ? time - overhead : 0);
+    }
+    return result;
+}
+
+void StartBench(const char *suite, BenchWriter writer) {
+    bench.writer = writer;
+    bench.suite = suite;
+    bench.count = 0;
+    StartBenchTime();
+    bench.overhead = TimeCalls(DoNothing, 0, 0).min;
+    WriteText("{");
+    WriteField("suite", suite, 0, ", ");
+    WriteField("unit", BENCH_UNIT, 0, ", ");
+    WriteField("clock_hz", 0, GetBenchClockHz(), "}\n");
+}
+
+BenchResult RunBench(const char *name, BenchFunction function, void *context) {
+    BenchResult result = TimeCalls(function, context, bench.overhead);
+    ReportBench(name, result);
+    return result;
+}
+
+void ReportBench(const char *name, BenchResult result) {
+    WriteText("{");
+    WriteField("bench", name, 0, ", ");
+    WriteField("min", 0, result.min, ", ");
+    WriteField("mean", 0, result.mean, ", ");
+    WriteField("max", 0, result.max, ", ");
+    WriteField("iterations", 0, result.iterations, "}\n");
+    bench.count++;
+}
+
+void AddBenchSample(BenchResult *result, uint32_t sample) {
+    if (result->iterations == 0 || sample < result->min) {
+        result->min = sample;
+    }
+    if (sample > result->max) {
+        result->max = sample;
+    }
+    result->total += sample;
+    result->iterations++;
+    result->mean = result->total / result->iterations;
+}
+
+uint32_t GetBenchOverhead() {
+    return bench.overhead;
+}
+
+void FinishBench() {
+    WriteText("{");
+    WriteField("done", bench.suite, 0, ", ");
+    WriteField("count", 0, bench.count, "}\n");
+}
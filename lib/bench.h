@@ -0,0 +1,61 @@
+#ifndef LIB_BENCH_H_
+#define LIB_BENCH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Microbenchmark harness. RunBench() times a function call by call, subtracts the harness's own
+// overhead (measured on an empty function), and reports the fastest, mean and slowest call as one
+// line of JSON, so a script can collect the numbers and compare them against a baseline
+// (tools/bench_compare.py). The minimum is the number to track: interrupts and other noise only
+// ever add time.
+//
+// On the target, time is in cycles from the TIM2 cycle counter (hal/cycle_counter.h), which
+// StartBench() takes over. Built for the host (anything that isn't __arm__), the same code times
+// in nanoseconds with clock_gettime(), so portable benchmarks run on a PC or in CI too.
+//
+// Output goes through `writer`, e.g. a WriteUsart() wrapper on the target or stdout on the host:
+//
+//     {"suite": "hal_bench", "unit": "cycles", "clock_hz": 16000000}
+//     {"bench": "gpio.set_gpio", "min": 14, "mean": 14, "max": 16, "iterations": 64}
+//     {"done": "hal_bench", "count": 1}
+
+// Calls timed per benchmark.
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 64
+#endif
+
+typedef void (*BenchWriter)(const char *text, size_t length);
+
+typedef void (*BenchFunction)(void *context);
+
+// Time per call, in cycles or nanoseconds.
+typedef struct {
+    uint32_t min, mean, max;
+    uint32_t iterations;
+    uint32_t total;  // Sum of all calls, for the mean.
+} BenchResult;
+
+// Start the timer, measure the harness overhead and write the suite's header line.
+void StartBench(const char *suite, BenchWriter writer);
+
+// Call `function` once to warm up, then BENCH_ITERATIONS times timed, and report the result.
+BenchResult RunBench(const char *name, BenchFunction function, void *context);
+
+// Report a result measured some other way, e.g. from inside an interrupt handler. Fill it in with
+// AddBenchSample(), starting from a zeroed BenchResult.
+void ReportBench(const char *name, BenchResult result);
+
+void AddBenchSample(BenchResult *result, uint32_t sample);
+
+// Write the closing line, with the number of benchmarks reported.
+void FinishBench();
+
+// The benchmark clock, for timing things RunBench() can't.
+uint32_t GetBenchTime();
+
+// The harness overhead RunBench() subtracts, measured by StartBench(). Subtract it from times taken
+// with GetBenchTime() too, so they compare with RunBench()'s.
+uint32_t GetBenchOverhead();
+
+#endif  // LIB_BENCH_H_
@@ -0,0 +1,277 @@
+#include "lib/boot.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+#include "lib/crc.h"
+
+#if defined(__arm__)
+#include "hal/nvic.h"
+
+void RequestUpdate() {
+    *(volatile uint32_t *)BOOT_REQUEST_ADDRESS = BOOT_REQUEST_MAGIC;
+    ResetSystem();
+}
+
+bool TakeUpdateRequest() {
+    volatile uint32_t *request = (volatile uint32_t *)BOOT_REQUEST_ADDRESS;
+    bool requested = *request == BOOT_REQUEST_MAGIC;
+    *request = 0;
+    return requested;
+}
+#endif
+
+static const ImageHeader *GetHeader(const BootFlash *flash, BootSlot slot) {
+    return (const ImageHeader *)flash->slots[slot];
+}
+
+uintptr_t GetImageStart(const BootFlash *flash, BootSlot slot) {
+    return flash->slots[slot] + BOOT_HEADER_SIZE;
+}
+
+bool IsImageValid(const BootFlash *flash, BootSlot slot) {
+    const ImageHeader *header = GetHeader(flash, slot);
+    if (header->magic != BOOT_IMAGE_MAGIC || header->size == 0 || header->size % 8 ||
+        header->size > flash->slot_size - BOOT_HEADER_SIZE) {
+        return false;
+    }
+    const void *image = (const void *)GetImageStart(flash, slot);
+    return ComputeTableCrc(&kCrc32Table, image, header->size) == header->crc;
+}
+
+// Newest first, so the older image's CRC only gets checked if the newer one is broken.
+BootSlot FindBootSlot(const BootFlash *flash) {
+    const ImageHeader *a = GetHeader(flash, kBootSlotA);
+    const ImageHeader *b = GetHeader(flash, kBootSlotB);
+    bool b_first = b->magic == BOOT_IMAGE_MAGIC &&
+                   (a->magic != BOOT_IMAGE_MAGIC || b->sequence > a->sequence);
+    BootSlot first = b_first ? kBootSlotB : kBootSlotA;
+    BootSlot second = b_first ? kBootSlotA : kBootSlotB;
+    if (IsImageValid(flash, first)) {
+        return first;
+    }
+    if (IsImageValid(flash, second)) {
+        return second;
+    }
+    return kNumBootSlots;
+}
+
+static uint32_t LoadWord(const uint8_t *bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void Respond(UpdateReceiver *receiver, UpdateFrameType type, uint32_t offset) {
+    struct {
+        UpdateFrameHeader header;
+        uint32_t crc;
+    } response = {.header = {.sync = UPDATE_SYNC, .type = type, .length = 0, .offset = offset}};
+    response.crc = ComputeTableCrc(&kCrc32Table, &response.header, sizeof(response.header));
+    receiver->send(receiver->context, &response, sizeof(response));
+}
+
+static void Fail(UpdateReceiver *receiver, UpdateError error) {
+    receiver->started = false;
+    Respond(receiver, kUpdateFailed, error);
+}
+
+// Erase the pages the new image will take, header page first, so the slot is invalid from the
+// first erase on. A repeated start frame (the host retries until it sees kUpdateReady) only gets
+// its answer again, as long as no data has come in yet.
+static void HandleStart(UpdateReceiver *receiver, const uint8_t *payload, uint16_t length) {
+    const BootFlash *flash = receiver->flash;
+    if (length != sizeof(receiver->start)) {
+        return;
+    }
+    bool repeat = receiver->started && receiver->expected == 0;
+    for (uint32_t i = 0; i < 4; i++) {
+        uint32_t word = LoadWord(&payload[4 * i]);
+        repeat = repeat && receiver->start[i] == word;
+        receiver->start[i] = word;
+    }
+    if (repeat) {
+        Respond(receiver, kUpdateReady, receiver->slot);
+        return;
+    }
+
+    receiver->slot = (FindBootSlot(flash) == kBootSlotA) ? kBootSlotB : kBootSlotA;
+    receiver->size = receiver->start[2 * receiver->slot];
+    receiver->crc = receiver->start[2 * receiver->slot + 1];
+    if (receiver->size == 0 || receiver->size % 8 ||
+        receiver->size > flash->slot_size - BOOT_HEADER_SIZE) {
+        Fail(receiver, kUpdateTooLarge);
+        return;
+    }
+    uintptr_t slot = flash->slots[receiver->slot];
+    for (uint32_t page = 0; page < BOOT_HEADER_SIZE + receiver->size; page += flash->page_size) {
+        if (!flash->erase_page(slot + page)) {
+            Fail(receiver, kUpdateFlashError);
+            return;
+        }
+    }
+    receiver->started = true;
+    receiver->nak_sent = false;
+    receiver->expected = 0;
+    Respond(receiver, kUpdateReady, receiver->slot);
+}
+
+// Frames before the expected offset are repeats (the host timed out on a lost acknowledgement), so
+// acknowledge them again. Frames after it mean something went missing.
+static void HandleData(UpdateReceiver *receiver, uint32_t offset, const uint8_t *payload,
+                       uint16_t length) {
+    const BootFlash *flash = receiver->flash;
+    if (!receiver->started) {
+        return;
+    }
+    if (offset < receiver->expected) {
+        Respond(receiver, kUpdateAck, receiver->expected);
+        return;
+    }
+    if (offset > receiver->expected) {
+        if (!receiver->nak_sent) {
+            receiver->nak_sent = true;
+            Respond(receiver, kUpdateNak, receiver->expected);
+        }
+        return;
+    }
+    if (length % 8 || offset + length > receiver->size) {
+        Fail(receiver, kUpdateTooLarge);
+        return;
+    }
+    if (!flash->program(GetImageStart(flash, receiver->slot) + offset, payload, length)) {
+        Fail(receiver, kUpdateFlashError);
+        return;
+    }
+    receiver->expected += length;
+    receiver->nak_sent = false;
+    Respond(receiver, kUpdateAck, receiver->expected);
+}
+
+// Check the image as it ended up in flash, then commit it: size and CRC first, the magic word and
+// sequence number last.
+static bool HandleFinish(UpdateReceiver *receiver) {
+    const BootFlash *flash = receiver->flash;
+    if (!receiver->started || receiver->expected != receiver->size) {
+        Fail(receiver, kUpdateIncomplete);
+        return false;
+    }
+    const void *image = (const void *)GetImageStart(flash, receiver->slot);
+    if (ComputeTableCrc(&kCrc32Table, image, receiver->size) != receiver->crc) {
+        Fail(receiver, kUpdateBadCrc);
+        return false;
+    }
+    BootSlot other = (receiver->slot == kBootSlotA) ? kBootSlotB : kBootSlotA;
+    ImageHeader header = {
+        .magic = BOOT_IMAGE_MAGIC,
+        .sequence = IsImageValid(flash, other) ? GetHeader(flash, other)->sequence + 1 : 1,
+        .size = receiver->size,
+        .crc = receiver->crc,
+    };
+    uintptr_t slot = flash->slots[receiver->slot];
+    if (!flash->program(slot + 8, &header.size, 8) || !flash->program(slot, &header, 8)) {
+        Fail(receiver, kUpdateFlashError);
+        return false;
+    }
+    receiver->started = false;
+    Respond(receiver, kUpdateDone, header.sequence);
+    return true;
+}
+
+static bool HandleFrame(UpdateReceiver *receiver) {
+    const UpdateFrameHeader *header = &receiver->frame.header;
+    const uint8_t *payload = &receiver->frame.bytes[sizeof(UpdateFrameHeader)];
+    switch (header->type) {
+        case kUpdateStart:
+            HandleStart(receiver, payload, header->length);
+            return false;
+        case kUpdateData:
+            HandleData(receiver, header->offset, payload, header->length);
+            return false;
+        case kUpdateFinish:
+            return HandleFinish(receiver);
+        default:
+            return false;
+    }
+}
+
+// Drop `count` bytes from the front of the frame buffer.
+static void DropBytes(UpdateReceiver *receiver, uint32_t count) {
+    for (uint32_t i = count; i < receiver->count; i++) {
+        receiver->frame.bytes[i - count] = receiver->frame.bytes[i];
+    }
+    receiver->count -= count;
+}
+
+// After garbage or a corrupted frame, realign on the next sync byte.
+static void Resync(UpdateReceiver *receiver) {
+    uint32_t skip = 1;
+    while (skip < receiver->count && receiver->frame.bytes[skip] != UPDATE_SYNC) {
+        skip++;
+    }
+    DropBytes(receiver, skip);
+}
+
+// Bytes until the buffered frame's header, or the whole frame, is complete.
+static uint32_t GetMissingBytes(const UpdateReceiver *receiver) {
+    if (receiver->count < sizeof(UpdateFrameHeader)) {
+        return sizeof(UpdateFrameHeader) - receiver->count;
+    }
+    return sizeof(UpdateFrameHeader) + receiver->frame.header.length + 4 - receiver->count;
+}
+
+void StartUpdateReceiver(UpdateReceiver *receiver, const BootFlash *flash, UpdateSend send,
+                         void *context) {
+    receiver->flash = flash;
+    receiver->send = send;
+    receiver->context = context;
+    receiver->started = false;
+    receiver->count = 0;
+}
+
+// Bytes are copied in up to the next point where there's something to check, so the checks run
+// once per frame rather than once per byte.
+HOT_FUNCTION
+bool ReceiveUpdate(UpdateReceiver *receiver, const uint8_t *data, size_t count) {
+    bool done = false;
+    while (count) {
+        uint32_t missing = GetMissingBytes(receiver);
+        uint32_t n = (missing < count) ? missing : count;
+        for (uint32_t i = 0; i < n; i++) {
+            receiver->frame.bytes[receiver->count + i] = data[i];
+        }
+        receiver->count += n;
+        data += n;
+        count -= n;
+
+        while (receiver->count) {
+            if (receiver->frame.bytes[0] != UPDATE_SYNC) {
+                Resync(receiver);
+                continue;
+            }
+            if (receiver->count < sizeof(UpdateFrameHeader)) {
+                break;
+            }
+            uint32_t size = sizeof(UpdateFrameHeader) + receiver->frame.header.length + 4;
+            if (receiver->frame.header.length > UPDATE_MAX_PAYLOAD) {
+                Resync(receiver);
+                continue;
+            }
+            if (receiver->count < size) {
+                break;
+            }
+            uint32_t crc = ComputeTableCrc(&kCrc32Table, receiver->frame.bytes, size - 4);
+            if (LoadWord(&receiver->frame.bytes[size - 4]) != crc) {
+                if (receiver->started && !receiver->nak_sent) {
+                    receiver->nak_sent = true;
+                    Respond(receiver, kUpdateNak, receiver->expected);
+                }
+                Resync(receiver);
+                continue;
+            }
+            done |= HandleFrame(receiver);
+            DropBytes(receiver, size);
+        }
+    }
+    return done;
+}
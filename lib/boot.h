@@ -0,0 +1,161 @@
+#ifndef LIB_BOOT_H_
+#define LIB_BOOT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A/B firmware updates over a serial link, shared by the bootloader (projects/bootloader) and the
+// applications it starts. Flash is split four ways (the hal/stm32g031x8xx_boot.ld and _slot_a/b.ld
+// linker scripts, which must agree with the numbers here):
+//
+//     0x08000000  bootloader   8 KiB
+//     0x08002000  slot A      24 KiB
+//     0x08008000  slot B      24 KiB
+//     0x0800E000  storage      8 KiB (hal/flash.h)
+//
+// A slot holds an ImageHeader in its first 256 bytes, then the image: an application linked for
+// that slot, vector table first. At reset, the bootloader starts the valid image with the highest
+// sequence number. Updates are written to the other slot, so the running image stays intact as a
+// fallback until the new one is complete. The new image's header is written last, after the whole
+// image has been checked against its CRC-32, and its magic word is the very last double word, so
+// the switch to the new slot happens in one flash write: a reset at any point before it leaves the
+// old image running.
+//
+// Applications enter the bootloader's update mode with RequestUpdate(). The bootloader also stays
+// in update mode when neither slot holds a valid image.
+
+#define BOOT_SLOT_A 0x08002000
+#define BOOT_SLOT_B 0x08008000
+#define BOOT_SLOT_SIZE 0x6000
+// The image starts this far into its slot. A multiple of 256, as the vector table needs.
+#define BOOT_HEADER_SIZE 0x100
+
+// The last RAM double word, which the boot and slot linker scripts leave out of RAM, so a request
+// written there survives the reset.
+#define BOOT_REQUEST_ADDRESS 0x20001FF8
+#define BOOT_REQUEST_MAGIC 0x54445055  // "UPDT"
+
+typedef enum {
+    kBootSlotA, kBootSlotB, kNumBootSlots
+} BootSlot;
+
+typedef struct {
+    uint32_t magic;     // BOOT_IMAGE_MAGIC once the image is complete.
+    uint32_t sequence;  // One more than the other slot's at the time of the update.
+    uint32_t size;      // Bytes, a multiple of 8.
+    uint32_t crc;       // CRC-32 (lib/crc.h) of the image.
+} ImageHeader;
+#define BOOT_IMAGE_MAGIC 0x474D4931  // "1IMG"
+
+// The slots and the functions to write them. The bootloader uses the real thing (hal/flash.h); a
+// host build can point this at a RAM simulation, as lib/boot_test.c does.
+typedef struct {
+    uintptr_t slots[kNumBootSlots];
+    uint32_t slot_size;
+    uint32_t page_size;
+    bool (*erase_page)(uintptr_t address);
+    bool (*program)(uintptr_t address, const void *data, size_t count);
+} BootFlash;
+
+// Checks the image's CRC, so this reads the whole image.
+bool IsImageValid(const BootFlash *flash, BootSlot slot);
+
+// The slot to boot, or kNumBootSlots if neither holds a valid image.
+BootSlot FindBootSlot(const BootFlash *flash);
+
+// Where the image in `slot` starts, which is its vector table.
+uintptr_t GetImageStart(const BootFlash *flash, BootSlot slot);
+
+#if defined(__arm__)
+// For applications: reset into the bootloader's update mode.
+__attribute__((noreturn)) void RequestUpdate();
+
+// For the bootloader: true if the application asked for an update. Clears the request, so a second
+// reset boots the application again.
+bool TakeUpdateRequest();
+#endif
+
+// The update protocol. Both directions use the same frames: an UpdateFrameHeader, `length` bytes
+// of payload, and the CRC-32 of both. The host streams the image in frames of up to
+// UPDATE_MAX_PAYLOAD bytes with up to UPDATE_WINDOW of them unacknowledged. The device programs
+// each frame as it comes in (whole 256 byte frames are one fast programming row) and acknowledges
+// it with the offset it expects next, which also covers lost acknowledgements. A bad or out of
+// order frame gets a NAK with the offset the host has to go back to (go-back-N). The window has to
+// fit the device's receive buffer, so nothing is lost while it's busy with the flash.
+//
+//     host                             device
+//     kUpdateStart (sizes, CRCs)  ->
+//                                 <-   erase the other slot, kUpdateReady (slot)
+//     kUpdateData (offset 0)      ->
+//     kUpdateData (offset 256)    ->   program, kUpdateAck (256)
+//     ...                         <-   ...
+//     kUpdateFinish               ->
+//                                 <-   check the CRC, write the header, kUpdateDone, reset
+//
+// Every image is linked for one slot, so the start frame carries both, and the ready frame says
+// which one to send.
+
+#define UPDATE_SYNC 0x5A
+#define UPDATE_MAX_PAYLOAD 256
+#define UPDATE_WINDOW 4
+#define UPDATE_BAUD 1000000
+
+typedef enum {
+    // Host to device.
+    kUpdateStart = 0x01,   // Payload: size and CRC of the slot A image, then of the slot B image.
+    kUpdateData = 0x02,    // Offset into the image. Payload: a multiple of 8 bytes.
+    kUpdateFinish = 0x03,
+    // Device to host, no payload.
+    kUpdateReady = 0x81,   // Offset: the slot to send.
+    kUpdateAck = 0x82,     // Offset: the next one expected.
+    kUpdateNak = 0x83,     // Offset: where to resend from.
+    kUpdateDone = 0x84,    // Offset: the new image's sequence number. The device resets next.
+    kUpdateFailed = 0x85,  // Offset: an UpdateError. Start over.
+} UpdateFrameType;
+
+typedef enum {
+    kUpdateTooLarge = 1,
+    kUpdateFlashError,
+    kUpdateIncomplete,
+    kUpdateBadCrc,
+} UpdateError;
+
+typedef struct {
+    uint8_t sync;  // UPDATE_SYNC
+    uint8_t type;  // UpdateFrameType
+    uint16_t length;
+    uint32_t offset;
+} UpdateFrameHeader;
+
+#define UPDATE_FRAME_SIZE (sizeof(UpdateFrameHeader) + UPDATE_MAX_PAYLOAD + 4)
+
+// Sends a response frame.
+typedef void (*UpdateSend)(void *context, const void *data, size_t count);
+
+// The device side of the protocol, independent of where the bytes come from.
+typedef struct {
+    const BootFlash *flash;
+    UpdateSend send;
+    void *context;
+    bool started;
+    bool nak_sent;    // Since the last frame in order, so a burst of bad frames gets one NAK.
+    BootSlot slot;    // Being written.
+    uint32_t size, crc;
+    uint32_t expected;
+    uint32_t start[4];  // The start frame's payload, to recognize a repeat.
+    uint32_t count;     // Bytes in `frame`.
+    union {
+        UpdateFrameHeader header;
+        uint8_t bytes[UPDATE_FRAME_SIZE];
+    } frame;
+} UpdateReceiver;
+
+void StartUpdateReceiver(UpdateReceiver *receiver, const BootFlash *flash, UpdateSend send,
+                         void *context);
+
+// Process received bytes, in any pieces. Returns true once the new image is in place and
+// kUpdateDone has been sent.
+bool ReceiveUpdate(UpdateReceiver *receiver, const uint8_t *data, size_t count);
+
+#endif  // LIB_BOOT_H_
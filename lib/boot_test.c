@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lib/boot.h"
+
+// A simulated device for testing lib/boot's update receiver and FindBootSlot() on the host, run by
+// tools/uploader_test.py. The two slots are RAM with the STM32G0's flash rules, kept in a file
+// between runs, so a run is one boot of the device:
+//
+//     boot_test FLASH receive [CUT before|torn|after]
+//         Receive an update from stdin, answer on stdout, and exit once it's done (the device
+//         resets) or stdin closes. With CUT, the power goes at that program or erase step, before
+//         it, halfway through it (a torn double word reads as garbage) or right after it.
+//     boot_test FLASH boot
+//         Print the slot FindBootSlot() picks ("A", "B" or "none") and its sequence number.
+//
+// Either way, the number of program and erase steps goes to stderr, e.g. "steps: 42". Build with
+//
+//     gcc -O2 -I. lib/boot_test.c lib/boot.c lib/crc.c -o boot_test
+
+#define PAGE_SIZE 2048
+
+typedef enum {
+    kCutBefore,
+    kCutTorn,
+    kCutAfter,
+} CutMode;
+
+static uint8_t flash[kNumBootSlots * BOOT_SLOT_SIZE] __attribute__((aligned(8)));
+static const char *flash_path;
+
+static uint32_t steps;
+static uint32_t cut_at;
+static CutMode cut_mode;
+
+static void SaveFlash() {
+    FILE *file = fopen(flash_path, "wb");
+    if (!file || fwrite(flash, 1, sizeof(flash), file) != sizeof(flash) || fclose(file)) {
+        fprintf(stderr, "can't write %s\n", flash_path);
+        exit(1);
+    }
+}
+
+static void LoadFlash() {
+    memset(flash, 0xFF, sizeof(flash));
+    FILE *file = fopen(flash_path, "rb");
+    if (file) {
+        size_t count = fread(flash, 1, sizeof(flash), file);
+        (void)count;
+        fclose(file);
+    }
+}
+
+static void Exit(int status) {
+    SaveFlash();
+    fprintf(stderr, "steps: %u\n", steps);
+    exit(status);
+}
+
+// A call the flash would have rejected. The receiver should never make one.
+static void Violation(const char *what, uintptr_t address) {
+    fprintf(stderr, "flash violation: %s at 0x%lx\n", what,
+            (unsigned long)(address - (uintptr_t)flash));
+    Exit(3);
+}
+
+static bool InFlash(uintptr_t address, size_t count) {
+    return address >= (uintptr_t)flash && address + count <= (uintptr_t)flash + sizeof(flash);
+}
+
+// Counts the step, and cuts the power if it's the one. Returns true if the cut comes right after
+// it.
+static bool Step(uint8_t *bytes, size_t count, bool erase) {
+    if (++steps != cut_at) {
+        return false;
+    }
+    if (cut_mode == kCutTorn) {
+        for (size_t i = 0; i < count; i++) {
+            bytes[i] = erase ? (bytes[i] | (uint8_t)rand()) : (uint8_t)rand();
+        }
+        if (!erase) {
+            bytes[0] &= 0x7F;
+        }
+    }
+    if (cut_mode != kCutAfter) {
+        Exit(2);
+    }
+    return true;
+}
+
+static bool EraseSimulatedPage(uintptr_t address) {
+    if (!InFlash(address, PAGE_SIZE) || (address - (uintptr_t)flash) % PAGE_SIZE) {
+        Violation("erase", address);
+    }
+    bool cut_after = Step((uint8_t *)address, PAGE_SIZE, true);
+    memset((uint8_t *)address, 0xFF, PAGE_SIZE);
+    if (cut_after) {
+        Exit(2);
+    }
+    return true;
+}
+
+// Only whole, aligned, erased double words, and bits only ever go from 1 to 0.
+static bool ProgramSimulatedFlash(uintptr_t address, const void *data, size_t count) {
+    if (!InFlash(address, count) || address % 8 || count % 8) {
+        Violation("program", address);
+    }
+    const uint8_t *bytes = data;
+    for (size_t offset = 0; offset < count; offset += 8) {
+        uint8_t *double_word = (uint8_t *)address + offset;
+        for (uint32_t i = 0; i < 8; i++) {
+            if (double_word[i] != 0xFF) {
+                Violation("program over data", (uintptr_t)double_word);
+            }
+        }
+        bool cut_after = Step(double_word, 8, false);
+        for (uint32_t i = 0; i < 8; i++) {
+            double_word[i] &= bytes[offset + i];
+        }
+        if (cut_after) {
+            Exit(2);
+        }
+    }
+    return true;
+}
+
+static const BootFlash kFlash = {
+    .slots = {(uintptr_t)flash, (uintptr_t)flash + BOOT_SLOT_SIZE},
+    .slot_size = BOOT_SLOT_SIZE,
+    .page_size = PAGE_SIZE,
+    .erase_page = EraseSimulatedPage,
+    .program = ProgramSimulatedFlash,
+};
+
+static void Send(void *context, const void *data, size_t count) {
+    (void)context;
+    const uint8_t *bytes = data;
+    while (count) {
+        ssize_t written = write(STDOUT_FILENO, bytes, count);
+        if (written <= 0) {
+            Exit(1);
+        }
+        bytes += written;
+        count -= (size_t)written;
+    }
+}
+
+static int Receive() {
+    static UpdateReceiver receiver;
+    StartUpdateReceiver(&receiver, &kFlash, Send, 0);
+    uint8_t buffer[512];
+    while (1) {
+        ssize_t count = read(STDIN_FILENO, buffer, sizeof(buffer));
+        if (count <= 0) {
+            return 1;
+        }
+        if (ReceiveUpdate(&receiver, buffer, (size_t)count)) {
+            return 0;
+        }
+    }
+}
+
+static int Boot() {
+    BootSlot slot = FindBootSlot(&kFlash);
+    if (slot == kNumBootSlots) {
+        printf("none\n");
+    } else {
+        printf("%c %u\n", "AB"[slot], ((const ImageHeader *)kFlash.slots[slot])->sequence);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s FLASH receive [CUT before|torn|after] | boot\n", argv[0]);
+        return 1;
+    }
+    flash_path = argv[1];
+    LoadFlash();
+    if (strcmp(argv[2], "receive") == 0) {
+        if (argc == 5) {
+            cut_at = (uint32_t)strtoul(argv[3], 0, 0);
+            cut_mode = strcmp(argv[4], "before") == 0 ? kCutBefore
+                       : strcmp(argv[4], "torn") == 0 ? kCutTorn
+                                                      : kCutAfter;
+        }
+        Exit(Receive());
+    }
+    if (strcmp(argv[2], "boot") == 0) {
+        Exit(Boot());
+    }
+    fprintf(stderr, "unknown command %s\n", argv[2]);
+    return 1;
+}
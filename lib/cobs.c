@@ -0,0 +1,190 @@
+#include "lib/cobs.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+void StartCobsEncoder(CobsEncoder *encoder, uint8_t *buffer, uint32_t size, uint32_t head) {
+    encoder->buffer = buffer;
+    encoder->size = size;
+    encoder->head = head;
+    encoder->open = false;
+}
+
+// Leave room for a block's code byte at the head.
+static void OpenBlock(CobsEncoder *encoder) {
+    encoder->code = encoder->head;
+    if (++encoder->head == encoder->size) {
+        encoder->head = 0;
+    }
+    encoder->run = 1;
+    encoder->open = true;
+}
+
+void BeginCobsFrame(CobsEncoder *encoder) {
+    OpenBlock(encoder);
+}
+
+// A block ends at a zero, which its code stands for, or after 254 bytes with code 0xFF, which
+// stands for no zero. The next block only opens once there's a byte for it, so a frame that ends
+// right after a full block doesn't get an extra code byte.
+HOT_FUNCTION
+void EncodeCobs(CobsEncoder *encoder, const void *data, uint32_t count) {
+    const uint8_t *bytes = data;
+    uint8_t *buffer = encoder->buffer;
+    uint32_t size = encoder->size;
+    uint32_t head = encoder->head;
+    uint32_t code = encoder->code;
+    uint8_t run = encoder->run;
+    bool open = encoder->open;
+    for (uint32_t i = 0; i < count; i++) {
+        uint8_t byte = bytes[i];
+        if (!open) {
+            code = head;
+            if (++head == size) {
+                head = 0;
+            }
+            run = 1;
+            open = true;
+        }
+        if (byte == 0) {
+            buffer[code] = run;
+            code = head;
+            if (++head == size) {
+                head = 0;
+            }
+            run = 1;
+            continue;
+        }
+        buffer[head] = byte;
+        if (++head == size) {
+            head = 0;
+        }
+        if (++run == 0xFF) {
+            buffer[code] = run;
+            open = false;
+        }
+    }
+    encoder->head = head;
+    encoder->code = code;
+    encoder->run = run;
+    encoder->open = open;
+}
+
+uint32_t EndCobsFrame(CobsEncoder *encoder) {
+    if (encoder->open) {
+        encoder->buffer[encoder->code] = encoder->run;
+        encoder->open = false;
+    }
+    encoder->buffer[encoder->head] = 0;
+    if (++encoder->head == encoder->size) {
+        encoder->head = 0;
+    }
+    return encoder->head;
+}
+
+void StartCobsDecoder(CobsDecoder *decoder, uint8_t *buffer, uint32_t size, uint32_t read,
+                      uint32_t max_length) {
+    decoder->buffer = buffer;
+    decoder->size = size;
+    decoder->max_length = max_length;
+    decoder->read = read;
+    // The first frame's payload goes where its first code byte is.
+    decoder->write = read;
+    decoder->start = read;
+    decoder->length = 0;
+    decoder->block = 0;
+    decoder->zero = false;
+    decoder->started = false;
+    decoder->dropping = false;
+    decoder->dropped = 0;
+}
+
+// The frame in progress is kept in locals, which the compiler can't keep in registers across the
+// stores to the buffer if they're behind `decoder`.
+HOT_FUNCTION
+bool DecodeCobs(CobsDecoder *decoder, uint32_t end, CobsFrame *frame) {
+    uint8_t *buffer = decoder->buffer;
+    uint32_t size = decoder->size;
+    uint32_t max_length = decoder->max_length;
+    uint32_t read = decoder->read;
+    uint32_t write = decoder->write;
+    uint32_t length = decoder->length;
+    uint8_t block = decoder->block;
+    bool zero = decoder->zero;
+    bool started = decoder->started;
+    bool dropping = decoder->dropping;
+    bool found = false;
+    while (read != end) {
+        uint8_t byte = buffer[read];
+        if (++read == size) {
+            read = 0;
+        }
+
+        if (byte == 0) {
+            found = started && !dropping && !block;
+            if (found) {
+                // The last block's zero isn't part of the payload.
+                uint32_t first = size - decoder->start;
+                if (length <= first) {
+                    first = length;
+                }
+                frame->data[0] = buffer + decoder->start;
+                frame->length[0] = first;
+                frame->data[1] = buffer;
+                frame->length[1] = length - first;
+            } else if (started || dropping) {
+                decoder->dropped++;
+            }
+            // Otherwise it was nothing but a zero, e.g. one sent to flush out noise.
+            decoder->start = write = read;
+            length = 0;
+            block = 0;
+            started = false;
+            dropping = false;
+            if (found) {
+                break;
+            }
+            continue;
+        }
+
+        if (dropping) {
+            continue;
+        }
+        if (block) {
+            block--;
+        } else {
+            // A code byte: the previous block's zero, if it had one, then the new block.
+            bool put = started && zero;
+            started = true;
+            block = byte - 1;
+            zero = byte != 0xFF;
+            if (!put) {
+                continue;
+            }
+            byte = 0;
+        }
+        if (length == max_length) {
+            dropping = true;
+            continue;
+        }
+        buffer[write] = byte;
+        if (++write == size) {
+            write = 0;
+        }
+        length++;
+    }
+    decoder->read = read;
+    decoder->write = write;
+    decoder->length = length;
+    decoder->block = block;
+    decoder->zero = zero;
+    decoder->started = started;
+    decoder->dropping = dropping;
+    return found;
+}
+
+uint32_t GetCobsDropped(const CobsDecoder *decoder) {
+    return decoder->dropped;
+}
@@ -0,0 +1,99 @@
+#ifndef LIB_COBS_H_
+#define LIB_COBS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Consistent Overhead Byte Stuffing, for framing binary messages on a byte stream like a UART.
+// Every frame is encoded without zero bytes and ends in a zero, so the receiver finds the frame
+// boundaries by looking for zeros, and after noise or a dropped byte it's back in sync at the next
+// one. The overhead is one byte per 254 bytes of payload, plus the zero. Framing isn't checking:
+// noise can still turn one frame into two that both decode, so put a CRC (lib/crc.h) in the
+// payload.
+//
+// Both sides work in place on ring buffers, so nothing gets copied twice. The encoder writes
+// straight into a transmit ring (the one a DMA drains, say), a piece of the frame at a time. The
+// decoder works through a receive ring (the one a circular DMA fills, see StartUsartReceiveDma()),
+// writing each frame's payload back over its own encoded bytes, which are always at least one
+// byte ahead of it, and hands out the payload where it is. Each byte is looked at once.
+//
+//     static uint8_t rx[512];
+//     static CobsDecoder decoder;
+//     StartUsartReceiveDma(kUsart2, kDmaChannel2, rx, sizeof(rx));
+//     StartCobsDecoder(&decoder, rx, sizeof(rx), 0, MAX_MESSAGE);
+//     ...
+//     uint32_t end = (sizeof(rx) - GetDmaRemaining(kDmaChannel2)) % sizeof(rx);
+//     CobsFrame frame;
+//     while (DecodeCobs(&decoder, end, &frame)) {
+//         HandleMessage(frame);
+//     }
+//
+// Ring positions are indices from 0 to size - 1, and the ring can be any size. A plain buffer is
+// a ring that doesn't wrap.
+
+// Largest encoding of `count` bytes of payload, with the trailing zero.
+#define COBS_MAX_ENCODED_SIZE(count) ((count) + (count) / 254 + 2)
+
+typedef struct {
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t head;  // Where the next byte goes.
+    uint32_t code;  // Position of the current block's code byte, which is written last.
+    uint8_t run;    // The code so far: 1 + the block's bytes.
+    bool open;      // A block is in progress, with its code byte at `code`.
+} CobsEncoder;
+
+// Encode into `buffer`, a ring of `size` bytes, starting at `head`.
+void StartCobsEncoder(CobsEncoder *encoder, uint8_t *buffer, uint32_t size, uint32_t head);
+
+// Start a frame. Make sure there's room for COBS_MAX_ENCODED_SIZE() of its payload after the head
+// first: the encoder doesn't check.
+void BeginCobsFrame(CobsEncoder *encoder);
+
+// Add `count` bytes to the frame's payload. Call as often as needed.
+void EncodeCobs(CobsEncoder *encoder, const void *data, uint32_t count);
+
+// Finish the frame with its zero. Returns the new head: the whole frame, up to there, is ready to
+// send.
+uint32_t EndCobsFrame(CobsEncoder *encoder);
+
+// A decoded payload, in the receive ring. It's in two parts if it wraps around the end of the
+// ring, otherwise the second part is empty.
+typedef struct {
+    const uint8_t *data[2];
+    uint32_t length[2];
+} CobsFrame;
+
+typedef struct {
+    uint8_t *buffer;
+    uint32_t size;
+    uint32_t max_length;
+    uint32_t read;    // Next encoded byte.
+    uint32_t write;   // Where the next payload byte goes. Never ahead of `read`.
+    uint32_t start;   // Where the current frame's payload starts.
+    uint32_t length;  // Of the current frame's payload so far.
+    uint8_t block;    // Payload bytes left in the current block.
+    bool zero;        // The current block ends in a zero, unless it's the frame's last.
+    bool started;     // Got the current frame's first code byte.
+    bool dropping;    // Skipping to the end of a bad frame.
+    uint32_t dropped;
+} CobsDecoder;
+
+// Decode from `buffer`, a ring of `size` bytes, starting at `read`. Frames with more than
+// `max_length` bytes of payload get dropped.
+void StartCobsDecoder(CobsDecoder *decoder, uint8_t *buffer, uint32_t size, uint32_t read,
+                      uint32_t max_length);
+
+// Decode what has arrived, up to but not including position `end`, until the end of the next
+// frame. Returns true with the frame's payload in `frame`, and false once everything up to `end`
+// is decoded without finishing a frame. The payload stays where it is until whatever fills the
+// ring comes round to it again, so handle it within a ring's worth of bytes.
+//
+// Frames that are too long or don't decode (a zero in the middle of a block, from a lost byte,
+// say) are dropped and counted.
+bool DecodeCobs(CobsDecoder *decoder, uint32_t end, CobsFrame *frame);
+
+// Frames dropped so far.
+uint32_t GetCobsDropped(const CobsDecoder *decoder);
+
+#endif  // LIB_COBS_H_
@@ -0,0 +1,220 @@
+#include "lib/control_loop.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "hal/adc.h"
+#include "hal/macros.h"
+#include "hal/rcc.h"
+#include "hal/timer.h"
+
+// ADC trigger sources, false for timers that aren't one.
+static bool AdcTriggerOf(Timer timer, AdcTrigger *trigger) {
+    switch (timer) {
+        case kTimer1:
+            *trigger = kAdcTriggerTim1Trgo2;
+            return true;
+        case kTimer2:
+            *trigger = kAdcTriggerTim2Trgo;
+            return true;
+        case kTimer3:
+            *trigger = kAdcTriggerTim3Trgo;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint32_t CountChannels(uint32_t channels) {
+    uint32_t count = 0;
+    for (; channels; channels &= channels - 1) {
+        count++;
+    }
+    return count;
+}
+
+static void ClearStats(ControlStats *stats) {
+    *stats = (ControlStats){.min_latency = UINT32_MAX, .min_execution = UINT32_MAX};
+}
+
+static void AddToHistogram(uint32_t *histogram, uint32_t shift, uint32_t value) {
+    uint32_t bin = value >> shift;
+    histogram[bin < CONTROL_HISTOGRAM_BINS ? bin : CONTROL_HISTOGRAM_BINS - 1]++;
+}
+
+// Runs once per period.
+HOT_FUNCTION
+static void RunStep(ControlLoop *loop, const uint16_t *samples, uint32_t count) {
+    const ControlLoopSettings *settings = &loop->settings;
+    TimerRegisters *regs = TIMER_REGS(settings->timer);
+    uint32_t start = READ_REG(regs->cnt);
+    if (settings->adc_sync) {
+        // There's no timer interrupt to clear the update flag, so clear this period's here. Writing
+        // 1 to the other flags leaves them alone.
+        WRITE_REG(regs->sr, ~kTimerUpdateEvent);
+    }
+    settings->step(settings->context, samples, count);
+    // The flag first: if the update comes between the two reads, the counter has wrapped below
+    // `start`, which gives it away just the same.
+    bool overrun = READ_BIT(regs->sr, kTimerUpdateEvent);
+    uint32_t end = READ_REG(regs->cnt);
+    overrun = overrun || end < start;
+    uint32_t execution = end - start + (overrun ? loop->period_ticks : 0);
+
+    ControlStats *stats = &loop->stats;
+    if (loop->reset_requested) {
+        ClearStats(stats);
+        loop->reset_requested = false;
+    }
+    stats->iterations++;
+    if (start < stats->min_latency) {
+        stats->min_latency = start;
+    }
+    if (start > stats->max_latency) {
+        stats->max_latency = start;
+    }
+    if (execution < stats->min_execution) {
+        stats->min_execution = execution;
+    }
+    if (execution > stats->max_execution) {
+        stats->max_execution = execution;
+    }
+    stats->total_latency += start;
+    stats->total_execution += execution;
+    AddToHistogram(stats->latency, settings->latency_shift, start);
+    AddToHistogram(stats->execution, settings->execution_shift, execution);
+
+    bool over_budget = settings->budget_ticks && execution > settings->budget_ticks;
+    stats->overruns += overrun;
+    stats->over_budget += over_budget;
+    loop->updates++;
+
+    if (overrun || over_budget) {
+        if (settings->on_fault) {
+            settings->on_fault(settings->context, overrun ? kControlOverrun : kControlOverBudget,
+                               execution);
+        }
+        if (settings->stop_on_fault) {
+            StopControlLoop(loop);
+        }
+    }
+}
+
+static void HandleControlTimer(void *context, uint32_t events) {
+    if (events & kTimerUpdateEvent) {
+        RunStep(context, 0, 0);
+    }
+}
+
+static void HandleControlSamples(void *context, const uint16_t *samples, uint32_t count) {
+    RunStep(context, samples, count);
+}
+
+bool StartControlLoop(ControlLoop *loop, ControlLoopSettings settings) {
+    uint32_t clock_hz = GetTimerClockHz();
+    if (!settings.step || !TIMER_TIMING_VALID(settings.timer, clock_hz, settings.rate_hz) ||
+        settings.latency_shift > 31 || settings.execution_shift > 31) {
+        return false;
+    }
+    AdcTrigger trigger;
+    if (settings.adc_sync) {
+        if (!AdcTriggerOf(settings.timer, &trigger) || settings.adc.channels == 0) {
+            return false;
+        }
+        // One scan per block, so there's a callback, and a step, per trigger.
+        settings.adc.trigger = trigger;
+        settings.adc.half_length = CountChannels(settings.adc.channels);
+        settings.adc.callback = HandleControlSamples;
+        settings.adc.context = loop;
+    }
+    loop->settings = settings;
+    TimerTiming timing = SolveTimerTiming(settings.timer, clock_hz, settings.rate_hz);
+    loop->tick_hz = clock_hz / (timing.prescaler + 1);
+    loop->period_ticks = timing.reload + 1;
+    loop->rate_hz = loop->tick_hz / loop->period_ticks;
+    ClearStats(&loop->stats);
+    loop->updates = 0;
+    loop->reset_requested = false;
+    loop->running = true;
+
+    ConfigureTimer(settings.timer, timing);
+    if (settings.adc_sync) {
+        SetTimerTriggerOutput(settings.timer, kTimerTriggerUpdate);
+        StartAdc(settings.adc);
+    } else {
+        EnableTimerInterrupts(settings.timer, kTimerUpdateEvent, HandleControlTimer, loop);
+    }
+    StartTimer(settings.timer);
+    return true;
+}
+
+void StopControlLoop(ControlLoop *loop) {
+    StopTimer(loop->settings.timer);
+    if (loop->settings.adc_sync) {
+        StopAdc();
+    } else {
+        EnableTimerInterrupts(loop->settings.timer, 0, 0, 0);
+    }
+    loop->running = false;
+}
+
+bool IsControlLoopRunning(const ControlLoop *loop) {
+    return loop->running;
+}
+
+uint32_t GetControlRateHz(const ControlLoop *loop) {
+    return loop->rate_hz;
+}
+
+uint32_t GetControlTickHz(const ControlLoop *loop) {
+    return loop->tick_hz;
+}
+
+uint32_t GetControlStats(ControlLoop *loop, ControlStats *stats) {
+    // A period can finish while copying, so retry until the count is stable. `stats` isn't
+    // volatile, so keep the compiler from moving the copy outside the two reads of the count.
+    uint32_t updates;
+    do {
+        updates = loop->updates;
+        __asm__ volatile("" : : : "memory");
+        *stats = loop->stats;
+        __asm__ volatile("" : : : "memory");
+    } while (updates != loop->updates);
+    return updates;
+}
+
+void ResetControlStats(ControlLoop *loop) {
+    if (loop->running) {
+        loop->reset_requested = true;
+    } else {
+        ClearStats(&loop->stats);
+    }
+}
+
+void *GetControlBufferToWrite(ControlBuffer *buffer) {
+    return buffer->buffers[(buffer->published + 1) & 1];
+}
+
+void PublishControlBuffer(ControlBuffer *buffer) {
+    // Keep the writes to the buffer from moving past the publish. The M0+ doesn't reorder memory
+    // accesses, so only the compiler needs telling.
+    __asm__ volatile("" : : : "memory");
+    buffer->published++;
+}
+
+const void *GetControlBufferToRead(const ControlBuffer *buffer) {
+    return buffer->buffers[buffer->published & 1];
+}
+
+uint32_t ReadControlBuffer(const ControlBuffer *buffer, void *out) {
+    // The writer starts on the buffer being copied as soon as it has published the other one, so
+    // any publish during the copy means starting over.
+    uint32_t published;
+    do {
+        published = buffer->published;
+        memcpy(out, buffer->buffers[published & 1], buffer->size);
+        __asm__ volatile("" : : : "memory");
+    } while (published != buffer->published);
+    return published;
+}
@@ -0,0 +1,166 @@
+#ifndef LIB_CONTROL_LOOP_H_
+#define LIB_CONTROL_LOOP_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/adc.h"
+#include "hal/timer.h"
+
+// Fixed rate control loops, e.g. motor current or PWM regulation at 10 to 50 kHz. A timer's update
+// event starts every period, so the rate comes from the timer and not from how long the code
+// takes, and the step function runs once per period from an interrupt:
+//
+// - Timer driven: the step runs from the timer's update interrupt.
+// - ADC synchronized: the update event triggers an ADC scan of `adc.channels` instead (TIM1, TIM2
+//   or TIM3 only, the ADC's trigger sources), and the step runs from the DMA interrupt with that
+//   period's samples. So the step always sees samples taken at the same point of the period.
+//
+// Every period is measured against the timer's counter, which restarts from 0 at each update
+// event: the latency from the update to the step starting (its spread is the loop's jitter), and
+// the step's execution time. Both go into min/max and a histogram, in timer ticks, which are CPU
+// cycles with the prescaler at 0 (any rate above the timer clock / 65536 on a 16 bit timer) and
+// the APB prescaler at 1. A step still running when the next period starts is an overrun, and one
+// that takes longer than `budget_ticks` is over budget. Either can call `on_fault`, and stop the
+// loop so the fault handler can put the outputs in a safe state. The bookkeeping adds around a
+// hundred cycles per period after the step, so leave room for it in the budget.
+//
+// Nothing else should preempt the loop's interrupt (the timer's, or the DMA channel's) if the
+// jitter matters: leave it at kIrqPriorityHighest and move the rest down with SetIrqPriority().
+//
+// lib/control_loop_test.c checks the bookkeeping and the double buffer on the host, against a
+// simulated timer.
+//
+//     static void Step(void *context, const uint16_t *samples, uint32_t count) { ... }
+//
+//     static ControlLoop loop;
+//     ControlLoopSettings settings = {
+//         .timer = kTimer3, .rate_hz = 20000, .step = Step, .budget_ticks = 2000,
+//         .latency_shift = 2, .execution_shift = 6,
+//     };
+//     StartControlLoop(&loop, settings);
+
+// Buckets per histogram. Bucket i counts values from i << shift up to ((i + 1) << shift) - 1,
+// and the last one everything above as well.
+#define CONTROL_HISTOGRAM_BINS 16
+
+typedef enum {
+    kControlOverrun,      // The step ran into the next period.
+    kControlOverBudget,   // The step took longer than `budget_ticks`, but finished in its period.
+} ControlFault;
+
+// Called from the loop's interrupt once per period. `samples` holds one scan of the ADC channels in
+// ascending order when ADC synchronized, and is 0 (with a `count` of 0) otherwise.
+typedef void (*ControlStep)(void *context, const uint16_t *samples, uint32_t count);
+
+// Called from the loop's interrupt right after a step that overran or went over budget, with the
+// step's execution time.
+typedef void (*ControlFaultHandler)(void *context, ControlFault fault, uint32_t ticks);
+
+typedef struct {
+    Timer timer;                 // Any but TIM2 while it's the cycle counter.
+    uint32_t rate_hz;            // Rounded to what the timer can do, see GetControlRateHz().
+    ControlStep step;
+    void *context;               // Passed to `step` and `on_fault`.
+    uint32_t budget_ticks;       // Execution time allowed per step, 0 for no budget.
+    ControlFaultHandler on_fault;  // Optional.
+    bool stop_on_fault;
+    uint8_t latency_shift;       // Histogram bucket widths, as powers of 2 ticks.
+    uint8_t execution_shift;
+    bool adc_sync;
+    // Channels, resolution, sample time, clock, oversampling, DMA channel and a buffer of twice the
+    // number of channels, when `adc_sync` is set. The trigger, block length and callback are the
+    // loop's.
+    AdcSettings adc;
+} ControlLoopSettings;
+
+// Timings are in timer ticks, see GetControlTickHz().
+typedef struct {
+    uint32_t iterations;
+    uint32_t overruns;
+    uint32_t over_budget;        // Including the overruns, if there's a budget.
+    uint32_t min_latency;        // From the update event to the step starting.
+    uint32_t max_latency;
+    uint32_t min_execution;
+    uint32_t max_execution;
+    uint64_t total_latency;      // For the means.
+    uint64_t total_execution;
+    uint32_t latency[CONTROL_HISTOGRAM_BINS];
+    uint32_t execution[CONTROL_HISTOGRAM_BINS];
+} ControlStats;
+
+typedef struct {
+    ControlLoopSettings settings;
+    uint32_t rate_hz;
+    uint32_t tick_hz;
+    uint32_t period_ticks;
+    ControlStats stats;
+    volatile uint32_t updates;   // Incremented after every update of `stats`.
+    volatile bool reset_requested;
+    volatile bool running;
+} ControlLoop;
+
+// Configure the timer (and the ADC), and start the loop. Returns false if the rate is out of the
+// timer's reach, or when ADC synchronized, the timer can't trigger the ADC or there are no
+// channels.
+bool StartControlLoop(ControlLoop *loop, ControlLoopSettings settings);
+
+// Stop the timer (and the ADC). Safe from the step or fault handler too.
+void StopControlLoop(ControlLoop *loop);
+
+bool IsControlLoopRunning(const ControlLoop *loop);
+
+// The actual loop rate, and the rate the timings are counted in.
+uint32_t GetControlRateHz(const ControlLoop *loop);
+
+uint32_t GetControlTickHz(const ControlLoop *loop);
+
+// Copy out the statistics so far, from code the loop's interrupt can preempt. Returns the number of
+// updates, so callers can tell if anything changed since they last looked.
+uint32_t GetControlStats(ControlLoop *loop, ControlStats *stats);
+
+// Start the statistics over from the next period, e.g. once the loop has settled.
+void ResetControlStats(ControlLoop *loop);
+
+// A double buffer for handing a struct of setpoints to the loop or telemetry back from it, without
+// locks or disabling interrupts. One side writes the buffer that isn't the latest and then
+// publishes it, the other side reads the latest. Write the whole struct each time: the buffer
+// being written holds the one before the latest, not the latest.
+//
+//     static Setpoints setpoints[2];
+//     static ControlBuffer setpoint_buffer = CONTROL_BUFFER(setpoints);
+//
+//     // Main loop.
+//     Setpoints *next = GetControlBufferToWrite(&setpoint_buffer);
+//     next->current_ma = 1500;
+//     PublishControlBuffer(&setpoint_buffer);
+//
+//     // Step.
+//     const Setpoints *latest = GetControlBufferToRead(&setpoint_buffer);
+//
+// For telemetry the other way around, the step writes and publishes, and the main loop copies the
+// latest out with ReadControlBuffer(), which starts over if the step published during the copy.
+// There's only ever one writer per buffer.
+typedef struct {
+    void *buffers[2];
+    size_t size;
+    volatile uint32_t published;  // Number of publishes, buffers[published & 1] is the latest.
+} ControlBuffer;
+
+#define CONTROL_BUFFER(pair)                                                                       \
+    {.buffers = {&(pair)[0], &(pair)[1]}, .size = sizeof((pair)[0]), .published = 0}
+
+void *GetControlBufferToWrite(ControlBuffer *buffer);
+
+void PublishControlBuffer(ControlBuffer *buffer);
+
+// The latest buffer, for a reader the writer can't preempt, i.e. the step reading what the main
+// loop wrote. It stays intact until the reader returns.
+const void *GetControlBufferToRead(const ControlBuffer *buffer);
+
+// Copy the latest buffer to `out`, for a reader the writer can preempt. Returns the number of
+// publishes so far.
+uint32_t ReadControlBuffer(const ControlBuffer *buffer, void *out);
+
+#endif  // LIB_CONTROL_LOOP_H_
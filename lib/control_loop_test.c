@@ -0,0 +1,363 @@
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "hal/timer.h"
+
+// Host test of lib/control_loop against a simulated timer:
+//
+//     gcc -O2 -I. lib/control_loop_test.c -o control_loop_test && ./control_loop_test
+//
+// The loop's timer registers are a struct in RAM, and the timer and ADC drivers are stand-ins
+// that remember what the loop asked for. Each simulated period sets the counter to the interrupt's
+// latency and calls the loop's callback, and the step runs the counter on by its execution time,
+// setting the update flag if it wraps. The statistics are checked against a reference, for both
+// modes, with overruns, steps over budget, resets and stopping on a fault. Last, a SIGALRM timer
+// preempts the main loop the way the loop's interrupt would, while it copies out and resets the
+// statistics and copies out the telemetry, and every copy has to be consistent.
+
+static TimerRegisters timer;
+#undef TIMER_REGS
+#define TIMER_REGS(timer_) (&timer)
+#include "lib/control_loop.c"
+
+#define CLOCK_HZ 64000000
+#define RATE_HZ 20000
+#define PERIOD (CLOCK_HZ / RATE_HZ)
+#define BUDGET 2000
+#define NUM_PERIODS 5000
+#define NUM_PREEMPTIONS 20000
+
+static uint32_t failures;
+
+// The stand-ins for the drivers.
+static TimerCallback timer_callback;
+static void *timer_context;
+static uint32_t timer_events;
+static TimerTriggerOutput trigger_output;
+static AdcSettings adc;
+static bool adc_running;
+
+uint32_t GetTimerClockHz() {
+    return CLOCK_HZ;
+}
+
+TimerTiming SolveTimerTiming(Timer timer_, uint32_t clock_hz, uint32_t freq_hz) {
+    return TIMER_TIMING(timer_, clock_hz, freq_hz);
+}
+
+void ConfigureTimer(Timer timer_, TimerTiming timing) {
+    (void)timer_;
+    memset(&timer, 0, sizeof(timer));
+    timer.psc = timing.prescaler;
+    timer.arr = timing.reload;
+}
+
+void StartTimer(Timer timer_) {
+    (void)timer_;
+    timer.cr1 = 1;
+}
+
+void StopTimer(Timer timer_) {
+    (void)timer_;
+    timer.cr1 = 0;
+}
+
+void EnableTimerInterrupts(Timer timer_, uint32_t events, TimerCallback callback, void *context) {
+    (void)timer_;
+    timer_events = events;
+    timer_callback = callback;
+    timer_context = context;
+}
+
+void SetTimerTriggerOutput(Timer timer_, TimerTriggerOutput trigger) {
+    (void)timer_;
+    trigger_output = trigger;
+}
+
+void StartAdc(AdcSettings settings) {
+    adc = settings;
+    adc_running = true;
+}
+
+void StopAdc() {
+    adc_running = false;
+}
+
+// What the step saw, and how long it takes.
+static uint32_t step_ticks;
+static uint32_t steps;
+static const uint16_t *step_samples;
+static uint32_t step_count;
+static uint16_t samples[3] = {100, 200, 300};
+
+// The faults reported, and the ticks of the last.
+static uint32_t faults[2];
+static uint32_t fault_ticks;
+
+static void Step(void *context, const uint16_t *samples_, uint32_t count) {
+    (void)context;
+    steps++;
+    step_samples = samples_;
+    step_count = count;
+    timer.cnt += step_ticks;
+    if (timer.cnt > timer.arr) {
+        timer.cnt -= timer.arr + 1;
+        timer.sr |= kTimerUpdateEvent;
+    }
+}
+
+static void HandleFault(void *context, ControlFault fault, uint32_t ticks) {
+    (void)context;
+    faults[fault]++;
+    fault_ticks = ticks;
+}
+
+// One period: the update event, `latency` ticks until the interrupt gets to the step, and a step
+// that takes `execution` ticks (up to a period past the next update). Nothing happens once the loop
+// has stopped.
+static void RunPeriod(uint32_t latency, uint32_t execution) {
+    if (!timer.cr1) {
+        return;
+    }
+    timer.cnt = latency;
+    step_ticks = execution;
+    if (adc_running) {
+        // Nothing clears the update flag but the loop itself.
+        timer.sr |= kTimerUpdateEvent;
+        adc.callback(adc.context, samples, adc.half_length);
+    } else if (timer_callback) {
+        // The timer driver clears the flags before calling back.
+        timer.sr &= ~kTimerUpdateEvent;
+        timer_callback(timer_context, kTimerUpdateEvent);
+    }
+}
+
+// The statistics the loop should have, worked out the obvious way.
+static void AddReference(ControlStats *stats, const ControlLoopSettings *settings, uint32_t latency,
+                         uint32_t execution) {
+    stats->iterations++;
+    stats->min_latency = latency < stats->min_latency ? latency : stats->min_latency;
+    stats->max_latency = latency > stats->max_latency ? latency : stats->max_latency;
+    stats->min_execution = execution < stats->min_execution ? execution : stats->min_execution;
+    stats->max_execution = execution > stats->max_execution ? execution : stats->max_execution;
+    stats->total_latency += latency;
+    stats->total_execution += execution;
+    uint32_t bin = latency >> settings->latency_shift;
+    stats->latency[bin < CONTROL_HISTOGRAM_BINS ? bin : CONTROL_HISTOGRAM_BINS - 1]++;
+    bin = execution >> settings->execution_shift;
+    stats->execution[bin < CONTROL_HISTOGRAM_BINS ? bin : CONTROL_HISTOGRAM_BINS - 1]++;
+    stats->overruns += latency + execution > PERIOD - 1;
+    stats->over_budget += settings->budget_ticks && execution > settings->budget_ticks;
+}
+
+static void Check(const char *what, bool ok) {
+    if (!ok && failures++ < 10) {
+        printf("FAIL %s\n", what);
+    }
+}
+
+static bool SameStats(const ControlStats *a, const ControlStats *b) {
+    bool same = a->iterations == b->iterations && a->overruns == b->overruns &&
+                a->over_budget == b->over_budget && a->min_latency == b->min_latency &&
+                a->max_latency == b->max_latency && a->min_execution == b->min_execution &&
+                a->max_execution == b->max_execution && a->total_latency == b->total_latency &&
+                a->total_execution == b->total_execution;
+    for (uint32_t i = 0; i < CONTROL_HISTOGRAM_BINS; i++) {
+        same = same && a->latency[i] == b->latency[i] && a->execution[i] == b->execution[i];
+    }
+    return same;
+}
+
+static uint32_t random_state = 1;
+
+static uint32_t Random(uint32_t range) {
+    random_state = random_state * 1664525 + 1013904223;
+    return (random_state >> 8) % range;
+}
+
+static ControlLoopSettings Settings(bool adc_sync) {
+    return (ControlLoopSettings){
+        .timer = kTimer3, .rate_hz = RATE_HZ, .step = Step, .budget_ticks = BUDGET,
+        .on_fault = HandleFault, .latency_shift = 4, .execution_shift = 8, .adc_sync = adc_sync,
+        .adc = {.channels = (1 << 0) | (1 << 4) | (1 << 9), .dma_channel = kDmaChannel1},
+    };
+}
+
+// Periods of assorted latencies and execution times, some over budget and a few overruns, and a
+// reset halfway.
+static void TestStats(bool adc_sync) {
+    static ControlLoop loop;
+    ControlLoopSettings settings = Settings(adc_sync);
+    Check("start", StartControlLoop(&loop, settings));
+    Check("rate", GetControlRateHz(&loop) == RATE_HZ && GetControlTickHz(&loop) == CLOCK_HZ);
+    if (adc_sync) {
+        Check("adc trigger", adc_running && adc.trigger == kAdcTriggerTim3Trgo &&
+                             adc.half_length == 3 && trigger_output == kTimerTriggerUpdate);
+    } else {
+        Check("timer interrupt", !adc_running && timer_events == kTimerUpdateEvent);
+    }
+
+    ControlStats reference;
+    ClearStats(&reference);
+    memset(faults, 0, sizeof(faults));
+    uint32_t expected_faults[2] = {0, 0};
+    steps = 0;
+    for (uint32_t period = 0; period < NUM_PERIODS; period++) {
+        if (period == NUM_PERIODS / 2) {
+            ResetControlStats(&loop);
+            ClearStats(&reference);
+        }
+        uint32_t latency = 20 + Random(300);
+        uint32_t execution = period % 97 == 13 ? PERIOD + Random(PERIOD / 2)
+                             : period % 11 == 5 ? BUDGET + 1 + Random(500)
+                                                : 100 + Random(BUDGET - 100);
+        RunPeriod(latency, execution);
+        AddReference(&reference, &settings, latency, execution);
+        if (latency + execution > PERIOD - 1) {
+            expected_faults[kControlOverrun]++;
+        } else if (execution > BUDGET) {
+            expected_faults[kControlOverBudget]++;
+        }
+        Check("execution passed to the fault handler",
+              fault_ticks == execution || !(execution > BUDGET));
+    }
+
+    ControlStats stats;
+    Check("updates", GetControlStats(&loop, &stats) == NUM_PERIODS);
+    Check(adc_sync ? "statistics, adc synchronized" : "statistics, timer driven",
+          SameStats(&stats, &reference));
+    Check("overruns happened", stats.overruns > 0 && stats.over_budget > stats.overruns);
+    Check("faults", faults[kControlOverrun] == expected_faults[kControlOverrun] &&
+                    faults[kControlOverBudget] == expected_faults[kControlOverBudget]);
+    Check("steps", steps == NUM_PERIODS);
+    Check("samples", adc_sync ? step_samples == samples && step_count == 3
+                              : step_samples == 0 && step_count == 0);
+
+    StopControlLoop(&loop);
+    Check("stop", !IsControlLoopRunning(&loop) && !timer.cr1 && !adc_running &&
+                  (adc_sync || !timer_callback));
+    ResetControlStats(&loop);
+    GetControlStats(&loop, &stats);
+    Check("reset while stopped", stats.iterations == 0 && stats.min_latency == UINT32_MAX);
+}
+
+static void TestStopOnFault() {
+    static ControlLoop loop;
+    ControlLoopSettings settings = Settings(false);
+    settings.stop_on_fault = true;
+    StartControlLoop(&loop, settings);
+    steps = 0;
+    RunPeriod(50, 1000);
+    RunPeriod(50, BUDGET + 10);
+    RunPeriod(50, 1000);
+    Check("stop on fault", !IsControlLoopRunning(&loop) && steps == 2);
+}
+
+static void TestSettings() {
+    static ControlLoop loop;
+    ControlLoopSettings settings = Settings(true);
+    settings.timer = kTimer14;
+    Check("adc synchronized, timer that can't trigger the adc", !StartControlLoop(&loop, settings));
+    settings = Settings(true);
+    settings.adc.channels = 0;
+    Check("adc synchronized, no channels", !StartControlLoop(&loop, settings));
+    settings = Settings(false);
+    settings.rate_hz = CLOCK_HZ;
+    Check("rate out of reach", !StartControlLoop(&loop, settings));
+    settings.rate_hz = 0;
+    Check("no rate", !StartControlLoop(&loop, settings));
+    settings = Settings(false);
+    settings.step = 0;
+    Check("no step", !StartControlLoop(&loop, settings));
+}
+
+// The telemetry the step publishes on every period of the preemption test: every field is the
+// period number, so a torn copy shows. Big enough that the copy takes a while.
+#define TELEMETRY_VALUES 1024
+
+typedef struct {
+    uint32_t values[TELEMETRY_VALUES];
+} Telemetry;
+
+static Telemetry telemetry[2];
+static ControlBuffer telemetry_buffer = CONTROL_BUFFER(telemetry);
+static ControlLoop preempting_loop;
+static volatile uint32_t preemptions;
+
+static void PublishingStep(void *context, const uint16_t *samples_, uint32_t count) {
+    (void)samples_;
+    (void)count;
+    (void)context;
+    Telemetry *next = GetControlBufferToWrite(&telemetry_buffer);
+    for (uint32_t i = 0; i < TELEMETRY_VALUES; i++) {
+        next->values[i] = preemptions;
+    }
+    PublishControlBuffer(&telemetry_buffer);
+    timer.cnt += 500;
+}
+
+// Two periods per preemption, as if the main loop was held off for both, so the second one writes
+// the buffer the main loop may be copying. Every period the same, so the totals are the count of
+// them times that.
+static void HandleAlarm(int signal) {
+    (void)signal;
+    preemptions++;
+    RunPeriod(100, 500);
+    RunPeriod(100, 500);
+}
+
+static void TestPreemption() {
+    ControlLoopSettings settings = Settings(false);
+    settings.step = PublishingStep;
+    StartControlLoop(&preempting_loop, settings);
+    signal(SIGALRM, HandleAlarm);
+    struct itimerval interval = {.it_interval = {0, 20}, .it_value = {0, 20}};
+    setitimer(ITIMER_REAL, &interval, 0);
+
+    uint32_t copies = 0;
+    bool stats_ok = true, telemetry_ok = true;
+    while (preemptions < NUM_PREEMPTIONS) {
+        // Now and then start over, which the loop's interrupt does for the main loop.
+        if (copies % 16 == 15) {
+            ResetControlStats(&preempting_loop);
+        }
+        ControlStats stats;
+        uint32_t updates = GetControlStats(&preempting_loop, &stats);
+        uint32_t latency_count = 0, execution_count = 0;
+        for (uint32_t i = 0; i < CONTROL_HISTOGRAM_BINS; i++) {
+            latency_count += stats.latency[i];
+            execution_count += stats.execution[i];
+        }
+        stats_ok = stats_ok && stats.iterations <= updates && latency_count == stats.iterations &&
+                   execution_count == stats.iterations &&
+                   stats.total_latency == 100ull * stats.iterations &&
+                   stats.total_execution == 500ull * stats.iterations;
+
+        Telemetry latest;
+        uint32_t published = ReadControlBuffer(&telemetry_buffer, &latest);
+        for (uint32_t i = 0; i < TELEMETRY_VALUES; i++) {
+            telemetry_ok = telemetry_ok && (!published || latest.values[i] == latest.values[0]);
+        }
+        copies++;
+    }
+    interval = (struct itimerval){0};
+    setitimer(ITIMER_REAL, &interval, 0);
+    StopControlLoop(&preempting_loop);
+    Check("statistics copied while preempted", stats_ok);
+    Check("telemetry copied while preempted", telemetry_ok);
+    printf("preemptions: %u, copies: %u\n", preemptions, copies);
+}
+
+int main() {
+    TestSettings();
+    TestStats(false);
+    TestStats(true);
+    TestStopOnFault();
+    TestPreemption();
+    printf("failures: %u\n", failures);
+    return failures != 0;
+}
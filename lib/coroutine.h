@@ -0,0 +1,105 @@
+#ifndef LIB_COROUTINE_H_
+#define LIB_COROUTINE_H_
+
+#include <stdint.h>
+
+// Stackless coroutines (a.k.a. protothreads) for asynchronous driver code.
+//
+// A coroutine is a plain C function that takes a Coroutine pointer and returns a CoStatus. The only
+// state kept between calls is the 2 byte resume point inside the Coroutine, so local variables do
+// NOT survive a wait or a yield. Keep anything that must outlive one in a struct (or static) next
+// to the Coroutine. Resuming a coroutine is just a function call plus a switch on the resume point.
+//
+// Example, blinking the LED while main() keeps calling Blink() from its super loop:
+//
+//     static Coroutine blink_co;
+//     static uint32_t blink_deadline;
+//
+//     CoStatus Blink(Coroutine *co) {
+//         CO_BEGIN(co);
+//         while (1) {
+//             SetGpio(kLed, !GetGpio(kLed));
+//             blink_deadline = systick + 500;
+//             CO_WAIT_UNTIL(co, CO_DEADLINE_REACHED(systick, blink_deadline));
+//         }
+//         CO_END(co);
+//     }
+//
+// The resume point is implemented with a switch statement (Duff's device), so a coroutine body
+// can't wait or yield from inside its own switch statement, and only one CO_* wait/yield statement
+// may appear per source line.
+
+typedef struct {
+    uint16_t resume_line;
+} Coroutine;
+
+// Ordered so that CO_ALIVE() is a single compare.
+typedef enum {
+    kCoWaiting, kCoYielded, kCoExited, kCoEnded
+} CoStatus;
+
+// Reset a coroutine so the next call starts from CO_BEGIN. A zero-initialized Coroutine (e.g. a
+// static) is already in this state.
+#define CO_INIT(co) ((co)->resume_line = 0)
+
+// True while a coroutine call returned kCoWaiting or kCoYielded.
+#define CO_ALIVE(status) ((status) < kCoExited)
+
+// Wrap-safe check for free running tick counters, e.g. a SysTick millisecond count.
+#define CO_DEADLINE_REACHED(now, deadline) ((int32_t)((uint32_t)(now) - (uint32_t)(deadline)) >= 0)
+
+#define CO_BEGIN(co)                                                                               \
+    switch ((co)->resume_line) {                                                                   \
+        case 0:
+
+#define CO_END(co)                                                                                 \
+    }                                                                                              \
+    (co)->resume_line = 0;                                                                         \
+    return kCoEnded
+
+// Return kCoWaiting until `condition` is true, re-evaluating it every time the coroutine resumes.
+#define CO_WAIT_UNTIL(co, condition)                                                               \
+    do {                                                                                           \
+        (co)->resume_line = __LINE__;                                                              \
+        __attribute__((fallthrough));                                                              \
+        case __LINE__:                                                                             \
+            if (!(condition)) {                                                                    \
+                return kCoWaiting;                                                                 \
+            }                                                                                      \
+    } while (0)
+
+#define CO_WAIT_WHILE(co, condition) CO_WAIT_UNTIL(co, !(condition))
+
+// Give other coroutines a turn, resuming right after this statement on the next call.
+#define CO_YIELD(co)                                                                               \
+    do {                                                                                           \
+        (co)->resume_line = __LINE__;                                                              \
+        return kCoYielded;                                                                         \
+        case __LINE__:;                                                                            \
+    } while (0)
+
+// Run a child coroutine until it exits or ends, e.g. CO_WAIT_CHILD(co, ReadSensor(&read_co)).
+#define CO_WAIT_CHILD(co, child_call) CO_WAIT_WHILE(co, CO_ALIVE(child_call))
+
+// Restart `child` from its beginning, then run it to completion.
+#define CO_SPAWN(co, child, child_call)                                                            \
+    do {                                                                                           \
+        CO_INIT(child);                                                                            \
+        CO_WAIT_CHILD(co, child_call);                                                             \
+    } while (0)
+
+// Leave the coroutine early. The next call starts from CO_BEGIN again.
+#define CO_EXIT(co)                                                                                \
+    do {                                                                                           \
+        (co)->resume_line = 0;                                                                     \
+        return kCoExited;                                                                          \
+    } while (0)
+
+// Start over from CO_BEGIN on the next call.
+#define CO_RESTART(co)                                                                             \
+    do {                                                                                           \
+        (co)->resume_line = 0;                                                                     \
+        return kCoWaiting;                                                                         \
+    } while (0)
+
+#endif  // LIB_COROUTINE_H_
@@ -0,0 +1,63 @@
+#ifndef LIB_CRC_H_
+#define LIB_CRC_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Table driven CRC in plain C, one table lookup per byte. It takes the same parameters as the
+// hardware CRC unit (hal/crc.h) and produces identical results, so host tools, other targets and
+// the firmware all agree on the same checksum.
+//
+// Parameters follow the usual Rocksoft model (as in the "CRC RevEng" catalogue): the polynomial is
+// in normal form without the top bit, and `initial` is the register value before any data, before
+// reflection.
+
+typedef struct {
+    uint32_t polynomial;
+    uint8_t width;             // 7, 8, 16 or 32 (the sizes the hardware supports).
+    uint32_t initial;
+    bool reflect_input;
+    bool reflect_output;
+    uint32_t final_xor;
+} CrcParameters;
+
+// CRC-32 as used by zlib, Ethernet and PNG. "123456789" -> 0xCBF43926.
+#define CRC32_PARAMETERS                                                                           \
+    ((CrcParameters){.polynomial = 0x04C11DB7, .width = 32, .initial = 0xFFFFFFFF,                 \
+                     .reflect_input = true, .reflect_output = true, .final_xor = 0xFFFFFFFF})
+// CRC-16/CCITT-FALSE (a.k.a. CRC-16/IBM-3740). "123456789" -> 0x29B1.
+#define CRC16_CCITT_PARAMETERS                                                                     \
+    ((CrcParameters){.polynomial = 0x1021, .width = 16, .initial = 0xFFFF,                         \
+                     .reflect_input = false, .reflect_output = false, .final_xor = 0})
+// CRC-8/SMBUS. "123456789" -> 0xF4.
+#define CRC8_PARAMETERS                                                                            \
+    ((CrcParameters){.polynomial = 0x07, .width = 8, .initial = 0,                                 \
+                     .reflect_input = false, .reflect_output = false, .final_xor = 0})
+
+typedef struct {
+    CrcParameters parameters;
+    uint32_t entries[256];
+} CrcTable;
+
+// Ready made CRC-32 table, in flash.
+extern const CrcTable kCrc32Table;
+
+// Build the table for any other parameters. It's 1 KiB, so on the target prefer a static const
+// CrcTable built on the host (or kCrc32Table) over one in RAM.
+void InitCrcTable(CrcTable *table, CrcParameters parameters);
+
+// Incremental use: crc = StartTableCrc(t); crc = UpdateTableCrc(t, crc, ...); FinishTableCrc(t, crc).
+uint32_t StartTableCrc(const CrcTable *table);
+
+uint32_t UpdateTableCrc(const CrcTable *table, uint32_t crc, const void *data, size_t count);
+
+uint32_t FinishTableCrc(const CrcTable *table, uint32_t crc);
+
+// All of the above in one go.
+uint32_t ComputeTableCrc(const CrcTable *table, const void *data, size_t count);
+
+// Reverse the low `width` bits of `value`.
+uint32_t ReflectCrcBits(uint32_t value, uint8_t width);
+
+#endif  // LIB_CRC_H_
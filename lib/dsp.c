@@ -0,0 +1,208 @@
+#include "lib/dsp.h"
+
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+// Round a Q30 (Q15 x Q15) accumulator back to Q15.
+HOT_INLINE q15_t RoundQ30ToQ15(int64_t acc) {
+    return SaturateQ15((int32_t)((acc + (1 << 14)) >> 15));
+}
+
+HOT_INLINE q31_t MultiplyQ31(q31_t a, q31_t b) {
+    if (a == Q31_MIN && b == Q31_MIN) {
+        return Q31_MAX;
+    }
+    int32_t a_high = a >> 16;
+    int32_t b_high = b >> 16;
+    uint32_t a_low = (uint32_t)a & 0xFFFF;
+    uint32_t b_low = (uint32_t)b & 0xFFFF;
+    int32_t cross1 = a_high * (int32_t)b_low;
+    int32_t cross2 = (int32_t)a_low * b_high;
+    uint32_t low = a_low * b_low;
+    // Carry out of the low 32 bits of the full 64 bit product.
+    uint32_t middle = (low >> 16) + ((uint32_t)cross1 & 0xFFFF) + ((uint32_t)cross2 & 0xFFFF);
+    int32_t high = a_high * b_high + (cross1 >> 16) + (cross2 >> 16) + (int32_t)(middle >> 16);
+    return (q31_t)(((uint32_t)high << 1) | ((middle >> 15) & 1));
+}
+
+HOT_FUNCTION q31_t MulQ31(q31_t a, q31_t b) {
+    return MultiplyQ31(a, b);
+}
+
+HOT_FUNCTION void ConvertAdcToQ15(const uint16_t *samples, q15_t *out, uint32_t count,
+                                  uint8_t bits) {
+    uint32_t shift = 16 - bits;
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = (q15_t)((int32_t)((uint32_t)samples[i] << shift) - 32768);
+    }
+}
+
+void InitFirQ15(FirQ15 *fir, const q15_t *coeffs, q15_t *state, uint16_t num_taps) {
+    fir->coeffs = coeffs;
+    fir->state = state;
+    fir->num_taps = num_taps;
+    fir->index = 0;
+    for (uint32_t i = 0; i < 2 * (uint32_t)num_taps; i++) {
+        state[i] = 0;
+    }
+}
+
+// Push one sample into the doubled delay line. The newest sample is at state[index], the oldest at
+// state[index + num_taps - 1].
+HOT_INLINE void PushFirQ15(FirQ15 *fir, q15_t sample) {
+    uint32_t index = (fir->index == 0) ? fir->num_taps - 1 : fir->index - 1;
+    fir->state[index] = sample;
+    fir->state[index + fir->num_taps] = sample;
+    fir->index = index;
+}
+
+// Unrolled by 4 to amortize the loop overhead. That's about all the low registers the M0+ has.
+HOT_INLINE q15_t DotFirQ15(const FirQ15 *fir) {
+    const q15_t *h = fir->coeffs;
+    const q15_t *x = fir->state + fir->index;
+    int64_t acc = 0;
+    uint32_t taps = fir->num_taps;
+    while (taps >= 4) {
+        acc += (int32_t)h[0] * x[0];
+        acc += (int32_t)h[1] * x[1];
+        acc += (int32_t)h[2] * x[2];
+        acc += (int32_t)h[3] * x[3];
+        h += 4;
+        x += 4;
+        taps -= 4;
+    }
+    while (taps--) {
+        acc += (int32_t)*h++ * *x++;
+    }
+    return RoundQ30ToQ15(acc);
+}
+
+HOT_FUNCTION void RunFirQ15(FirQ15 *fir, const q15_t *in, q15_t *out, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        PushFirQ15(fir, in[i]);
+        out[i] = DotFirQ15(fir);
+    }
+}
+
+void InitDecimatorQ15(DecimatorQ15 *decimator, const q15_t *coeffs, q15_t *state, uint16_t num_taps,
+                      uint8_t factor) {
+    InitFirQ15(&decimator->fir, coeffs, state, num_taps);
+    decimator->factor = factor;
+    decimator->phase = 0;
+}
+
+HOT_FUNCTION uint32_t RunDecimatorQ15(DecimatorQ15 *decimator, const q15_t *in, q15_t *out,
+                                      uint32_t count) {
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        PushFirQ15(&decimator->fir, in[i]);
+        if (++decimator->phase == decimator->factor) {
+            decimator->phase = 0;
+            out[written++] = DotFirQ15(&decimator->fir);
+        }
+    }
+    return written;
+}
+
+void InitBiquadQ15(BiquadQ15 *biquad, const q15_t *coeffs, q15_t *state, uint8_t num_stages) {
+    biquad->coeffs = coeffs;
+    biquad->state = state;
+    biquad->num_stages = num_stages;
+    for (uint32_t i = 0; i < 4 * (uint32_t)num_stages; i++) {
+        state[i] = 0;
+    }
+}
+
+HOT_FUNCTION void RunBiquadQ15(BiquadQ15 *biquad, const q15_t *in, q15_t *out, uint32_t count) {
+    const q15_t *in_stage = in;
+    for (uint32_t stage = 0; stage < biquad->num_stages; stage++) {
+        const q15_t *c = biquad->coeffs + 5 * stage;
+        q15_t *s = biquad->state + 4 * stage;
+        // Keep the coefficients and state in locals for the whole block.
+        int32_t b0 = c[0], b1 = c[1], b2 = c[2], a1 = c[3], a2 = c[4];
+        int32_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+        for (uint32_t i = 0; i < count; i++) {
+            int32_t x0 = in_stage[i];
+            // Every product fits in 32 bits, only the sum needs 64.
+            int64_t acc = b0 * x0;
+            acc += b1 * x1;
+            acc += b2 * x2;
+            acc -= a1 * y1;
+            acc -= a2 * y2;
+            // Q14 coefficients, so round off 14 bits instead of 15.
+            int32_t y0 = SaturateQ15((int32_t)((acc + (1 << 13)) >> 14));
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            out[i] = (q15_t)y0;
+        }
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+        in_stage = out;
+    }
+}
+
+void InitBiquadQ31(BiquadQ31 *biquad, const q31_t *coeffs, q31_t *state, uint8_t num_stages) {
+    biquad->coeffs = coeffs;
+    biquad->state = state;
+    biquad->num_stages = num_stages;
+    for (uint32_t i = 0; i < 4 * (uint32_t)num_stages; i++) {
+        state[i] = 0;
+    }
+}
+
+HOT_FUNCTION void RunBiquadQ31(BiquadQ31 *biquad, const q31_t *in, q31_t *out, uint32_t count) {
+    const q31_t *in_stage = in;
+    for (uint32_t stage = 0; stage < biquad->num_stages; stage++) {
+        const q31_t *c = biquad->coeffs + 5 * stage;
+        q31_t *s = biquad->state + 4 * stage;
+        q31_t x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+        for (uint32_t i = 0; i < count; i++) {
+            q31_t x0 = in_stage[i];
+            int64_t acc = (int64_t)MultiplyQ31(c[0], x0) + MultiplyQ31(c[1], x1) +
+                          MultiplyQ31(c[2], x2) - MultiplyQ31(c[3], y1) - MultiplyQ31(c[4], y2);
+            // Q30 coefficients, so scale back up by one bit.
+            q31_t y0 = SaturateQ31(acc * 2);
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            out[i] = y0;
+        }
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+        in_stage = out;
+    }
+}
+
+void InitMovingAverageQ15(MovingAverageQ15 *average, q15_t *history, uint8_t log2_length) {
+    average->history = history;
+    average->sum = 0;
+    average->index = 0;
+    average->log2_length = log2_length;
+    for (uint32_t i = 0; i < (1u << log2_length); i++) {
+        history[i] = 0;
+    }
+}
+
+HOT_FUNCTION void RunMovingAverageQ15(MovingAverageQ15 *average, const q15_t *in, q15_t *out,
+                                      uint32_t count) {
+    uint32_t mask = (1u << average->log2_length) - 1;
+    int32_t sum = average->sum;
+    uint32_t index = average->index;
+    for (uint32_t i = 0; i < count; i++) {
+        q15_t sample = in[i];
+        sum += sample - average->history[index];
+        average->history[index] = sample;
+        index = (index + 1) & mask;
+        out[i] = (q15_t)(sum >> average->log2_length);
+    }
+    average->sum = sum;
+    average->index = index;
+}
@@ -0,0 +1,117 @@
+#ifndef LIB_DSP_H_
+#define LIB_DSP_H_
+
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+// Fixed point DSP kernels for the Cortex-M0+, which has no FPU and no DSP/SIMD instructions but
+// does have a single cycle 32x32 -> 32 bit multiplier. Q15 products are exact 32 bit MULS results,
+// and sums of them go into 64 bit accumulators (an ADDS/ADCS pair), so there's no intermediate
+// rounding or overflow inside a kernel. Results saturate once, on the way out.
+//
+// Everything is plain integer C with no floating point and no division, so host builds produce
+// bit-identical output for validation. (Right shifts of negative values are arithmetic on GCC for
+// both the host and the target.)
+//
+// Kernels work on blocks, to plug straight into the AdcCallback of hal/adc:
+//
+//     void HandleSamples(void *context, const uint16_t *samples, uint32_t count) {
+//         ConvertAdcToQ15(samples, block, count, 12);
+//         RunFirQ15(&fir, block, block, count);
+//         ...
+//     }
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15_MAX INT16_MAX
+#define Q15_MIN INT16_MIN
+#define Q31_MAX INT32_MAX
+#define Q31_MIN INT32_MIN
+
+// Constant conversion, e.g. Q15(0.5). Only meant for constant expressions.
+#define Q15(x) ((q15_t)((x) >= 1.0 ? Q15_MAX : (x) * 32768.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define Q31(x) ((q31_t)((x) >= 1.0 ? Q31_MAX : (x) * 2147483648.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+HOT_INLINE q15_t SaturateQ15(int32_t x) {
+    return (x > Q15_MAX) ? Q15_MAX : (x < Q15_MIN) ? Q15_MIN : (q15_t)x;
+}
+
+HOT_INLINE q31_t SaturateQ31(int64_t x) {
+    return (x > Q31_MAX) ? Q31_MAX : (x < Q31_MIN) ? Q31_MIN : (q31_t)x;
+}
+
+// Q31 x Q31 -> Q31 (truncated). There is no 32x32 -> 64 bit multiply instruction, so this is built
+// from four 16x16 MULS, which is cheaper than the generic __aeabi_lmul.
+q31_t MulQ31(q31_t a, q31_t b);
+
+// Unsigned ADC samples (right aligned, `bits` wide) to signed Q15 centred on mid scale.
+void ConvertAdcToQ15(const uint16_t *samples, q15_t *out, uint32_t count, uint8_t bits);
+
+// FIR filter with a circular delay line. The delay line is stored twice back to back, so the
+// taps are always one contiguous run and the inner loop needs no wrap check or modulo.
+typedef struct {
+    const q15_t *coeffs;   // num_taps coefficients, h[0] first.
+    q15_t *state;          // 2 * num_taps samples, zero initialized.
+    uint16_t num_taps;
+    uint16_t index;
+} FirQ15;
+
+void InitFirQ15(FirQ15 *fir, const q15_t *coeffs, q15_t *state, uint16_t num_taps);
+
+// `in` and `out` may be the same buffer.
+void RunFirQ15(FirQ15 *fir, const q15_t *in, q15_t *out, uint32_t count);
+
+// FIR decimator. Only every `factor`-th output is computed, so the cost per input sample is
+// num_taps / factor multiplies. Returns the number of output samples written.
+typedef struct {
+    FirQ15 fir;
+    uint8_t factor;
+    uint8_t phase;
+} DecimatorQ15;
+
+void InitDecimatorQ15(DecimatorQ15 *decimator, const q15_t *coeffs, q15_t *state, uint16_t num_taps,
+                      uint8_t factor);
+
+uint32_t RunDecimatorQ15(DecimatorQ15 *decimator, const q15_t *in, q15_t *out, uint32_t count);
+
+// Cascade of direct form 1 biquads. Coefficients are {b0, b1, b2, a1, a2} per stage in Q14 (i.e.
+// Q15 scaled down by 2, so |a1| up to 2 fits), with the a coefficients' signs as in
+// y = b0 x0 + b1 x1 + b2 x2 - a1 y1 - a2 y2.
+typedef struct {
+    const q15_t *coeffs;   // 5 * num_stages coefficients.
+    q15_t *state;          // 4 * num_stages values {x1, x2, y1, y2}, zero initialized.
+    uint8_t num_stages;
+} BiquadQ15;
+
+void InitBiquadQ15(BiquadQ15 *biquad, const q15_t *coeffs, q15_t *state, uint8_t num_stages);
+
+void RunBiquadQ15(BiquadQ15 *biquad, const q15_t *in, q15_t *out, uint32_t count);
+
+// Same as BiquadQ15 with Q31 data and Q30 coefficients, for low cutoff filters where Q15 rounding
+// noise in the feedback path is too much. Roughly 4x the cost.
+typedef struct {
+    const q31_t *coeffs;
+    q31_t *state;
+    uint8_t num_stages;
+} BiquadQ31;
+
+void InitBiquadQ31(BiquadQ31 *biquad, const q31_t *coeffs, q31_t *state, uint8_t num_stages);
+
+void RunBiquadQ31(BiquadQ31 *biquad, const q31_t *in, q31_t *out, uint32_t count);
+
+// Moving average over a power of two window, kept as a running sum: one add, one subtract and one
+// shift per sample regardless of the window length.
+typedef struct {
+    q15_t *history;        // 2^log2_length samples, zero initialized.
+    int32_t sum;
+    uint16_t index;
+    uint8_t log2_length;
+} MovingAverageQ15;
+
+void InitMovingAverageQ15(MovingAverageQ15 *average, q15_t *history, uint8_t log2_length);
+
+void RunMovingAverageQ15(MovingAverageQ15 *average, const q15_t *in, q15_t *out, uint32_t count);
+
+#endif  // LIB_DSP_H_
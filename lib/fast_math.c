@@ -0,0 +1,97 @@
+#include "lib/fast_math.h"
+
+#include <stdint.h>
+
+// sin(i * 90 / 256 degrees) in Q15 for i = 0 to 256, clamped to Q15_MAX at the top.
+static const q15_t kQuarterSine[257] = {
+    0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+    2411, 2611, 2811, 3012, 3212, 3412, 3612, 3812, 4011, 4211, 4410, 4609,
+    4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6787, 6983,
+    7180, 7376, 7571, 7767, 7962, 8157, 8351, 8546, 8740, 8933, 9127, 9319,
+    9512, 9704, 9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+    11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463, 13646, 13828,
+    14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269, 15447, 15624, 15800, 15976,
+    16151, 16326, 16500, 16673, 16846, 17018, 17190, 17361, 17531, 17700, 17869, 18037,
+    18205, 18372, 18538, 18703, 18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001,
+    20160, 20318, 20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+    22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312, 23453, 23593,
+    23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680, 24812, 24943, 25073, 25202,
+    25330, 25457, 25583, 25708, 25833, 25956, 26078, 26199, 26320, 26439, 26557, 26674,
+    26791, 26906, 27020, 27133, 27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002,
+    28106, 28209, 28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+    29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038, 30118, 30196,
+    30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784, 30853, 30920, 30986, 31050,
+    31114, 31177, 31238, 31298, 31357, 31415, 31471, 31527, 31581, 31634, 31686, 31737,
+    31786, 31834, 31881, 31927, 31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251,
+    32286, 32319, 32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+    32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738, 32746, 32753,
+    32758, 32762, 32766, 32767, 32767,
+};
+
+void InitDivider(Divider *divider, uint32_t divisor) {
+    uint32_t log2 = DIVIDER_LOG2(divisor);
+    divider->divisor = divisor;
+    divider->multiplier = DIVIDER_MULTIPLIER(divisor);
+    divider->multiplier16 = DIVIDER_MULTIPLIER16(divisor);
+    divider->shift1 = (log2 > 0) ? 1 : 0;
+    divider->shift2 = (log2 > 0) ? log2 - 1 : 0;
+    divider->shift16 = DIVIDER_SHIFT16(divisor);
+}
+
+uint32_t SqrtU32(uint32_t x) {
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+uint32_t Log2U32(uint32_t x) {
+    uint32_t log2 = 0;
+    if (x >= (1u << 16)) {
+        x >>= 16;
+        log2 += 16;
+    }
+    if (x >= (1u << 8)) {
+        x >>= 8;
+        log2 += 8;
+    }
+    if (x >= (1u << 4)) {
+        x >>= 4;
+        log2 += 4;
+    }
+    if (x >= (1u << 2)) {
+        x >>= 2;
+        log2 += 2;
+    }
+    if (x >= (1u << 1)) {
+        log2 += 1;
+    }
+    return log2;
+}
+
+q15_t SinQ15(uint16_t angle) {
+    // Fold into the first quadrant: 14 bits of position, mirrored in the second and fourth.
+    uint32_t x = angle & 0x3FFF;
+    if (angle & 0x4000) {
+        x = 0x4000 - x;
+    }
+    // 8 bits of table index, 6 bits of interpolation.
+    uint32_t index = x >> 6;
+    int32_t fraction = x & 0x3F;
+    int32_t value = kQuarterSine[index];
+    if (fraction) {
+        value += ((kQuarterSine[index + 1] - value) * fraction) >> 6;
+    }
+    return (q15_t)((angle & 0x8000) ? -value : value);
+}
@@ -0,0 +1,103 @@
+#ifndef LIB_FAST_MATH_H_
+#define LIB_FAST_MATH_H_
+
+#include <stdint.h>
+
+#include "lib/dsp.h"
+
+// Division free integer math for the Cortex-M0+. There's no divide instruction, so every runtime
+// `/` or `%` is a call to libgcc's __aeabi_uidiv, which costs tens of cycles (and worse for 64
+// bit). GCC can't turn a constant divisor into a multiply here either, because the M0+ has no
+// 32x32 -> 64 bit multiply, so even `x / 10` ends up in libgcc.
+//
+// Dividing by a divisor that doesn't change (a baud rate, a buffer length, ticks per millisecond)
+// is instead done by multiplying with its precomputed reciprocal (Granlund and Montgomery's
+// "magic number" method), with a cheaper path for numerators that fit in 16 bits. Results are
+// exact, i.e. identical to `/` and `%`, for every numerator.
+
+// Ceiling of log2(d), for constant expressions. (GCC folds __builtin_clz of a constant. At
+// runtime it's a libgcc call, since there's no CLZ instruction either.)
+#define DIVIDER_LOG2(d) ((uint32_t)(d) <= 1 ? 0 : 32 - __builtin_clz((uint32_t)(d) - 1))
+
+// 32 bit magic: 2^32 * (2^l - d) / d + 1, with l = ceil(log2(d)).
+#define DIVIDER_MULTIPLIER(d)                                                                      \
+    ((uint32_t)(((((uint64_t)1 << DIVIDER_LOG2(d)) - (d)) << 32) / (d) + 1))
+// 16 bit magic: ceil(2^(16 + l) / d), which is 17 bits. The top bit is implicit. Divisors above
+// 16 bits always give 0 for 16 bit numerators, so they get a multiplier of 0 and a shift of 17.
+#define DIVIDER_MULTIPLIER16(d)                                                                    \
+    ((uint32_t)(d) > 0xFFFFu ? 0 :                                                                 \
+     (uint16_t)(((((uint64_t)1 << (16 + DIVIDER_LOG2(d))) + (d) - 1) / (d)) - 0x10000))
+#define DIVIDER_SHIFT16(d) ((uint32_t)(d) > 0xFFFFu ? 17 : DIVIDER_LOG2(d))
+
+typedef struct {
+    uint32_t divisor;
+    uint32_t multiplier;
+    uint16_t multiplier16;
+    uint8_t shift1;
+    uint8_t shift2;
+    uint8_t shift16;
+} Divider;
+
+// Constant divider, e.g.
+//
+//     static const Divider kMillisecond = DIVIDER(16000);
+//     uint32_t ms = Divide(ticks, &kMillisecond);
+//
+// `d` must be 1 or more. With runtime divisors, use InitDivider() instead.
+#define DIVIDER(d)                                                                                 \
+    ((Divider){.divisor = (d), .multiplier = DIVIDER_MULTIPLIER(d),                                \
+               .multiplier16 = DIVIDER_MULTIPLIER16(d),                                            \
+               .shift1 = DIVIDER_LOG2(d) > 0 ? 1 : 0,                                              \
+               .shift2 = DIVIDER_LOG2(d) > 0 ? DIVIDER_LOG2(d) - 1 : 0,                            \
+               .shift16 = DIVIDER_SHIFT16(d)})
+
+// Precompute the reciprocal of a runtime divisor (1 or more). This does one 64 bit division
+// itself, so do it once up front, not per use.
+void InitDivider(Divider *divider, uint32_t divisor);
+
+// High 32 bits of a 32x32 bit product, from four 16x16 MULS.
+static inline uint32_t MulHigh32(uint32_t a, uint32_t b) {
+    uint32_t a_low = a & 0xFFFF, a_high = a >> 16;
+    uint32_t b_low = b & 0xFFFF, b_high = b >> 16;
+    uint32_t cross1 = a_high * b_low;
+    uint32_t cross2 = a_low * b_high;
+    uint32_t middle = ((a_low * b_low) >> 16) + (cross1 & 0xFFFF) + (cross2 & 0xFFFF);
+    return a_high * b_high + (cross1 >> 16) + (cross2 >> 16) + (middle >> 16);
+}
+
+// n / divisor for numerators up to 0xFFFF: a single MULS and two shifts.
+static inline uint32_t Divide16(uint32_t n, const Divider *divider) {
+    return (((n * divider->multiplier16) >> 16) + n) >> divider->shift16;
+}
+
+// n / divisor for any numerator. Takes the 16 bit path when it can.
+static inline uint32_t Divide(uint32_t n, const Divider *divider) {
+    if (n <= 0xFFFF) {
+        return Divide16(n, divider);
+    }
+    uint32_t t = MulHigh32(n, divider->multiplier);
+    return (t + ((n - t) >> divider->shift1)) >> divider->shift2;
+}
+
+// n % divisor.
+static inline uint32_t Modulo(uint32_t n, const Divider *divider) {
+    return n - Divide(n, divider) * divider->divisor;
+}
+
+// floor(sqrt(x)), bit by bit. 16 iterations of adds and shifts, no multiplies.
+uint32_t SqrtU32(uint32_t x);
+
+// floor(log2(x)), i.e. the index of the highest set bit, by binary search since there's no CLZ.
+// Returns 0 for x = 0.
+uint32_t Log2U32(uint32_t x);
+
+// Angles are a full turn in 16 bits, so 0x4000 is 90 degrees and angle arithmetic wraps for free.
+// Results come from a 257 entry quarter wave table with linear interpolation, within 1 LSB of
+// the exact value.
+q15_t SinQ15(uint16_t angle);
+
+static inline q15_t CosQ15(uint16_t angle) {
+    return SinQ15(angle + 0x4000);
+}
+
+#endif  // LIB_FAST_MATH_H_
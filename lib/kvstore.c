@@ -0,0 +1,271 @@
+#include "lib/kvstore.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lib/crc.h"
+
+// "KVS1". Bumped whenever the layout changes, so an old store reads as blank pages.
+#define PAGE_MAGIC 0x3153564B
+
+// Both headers are one double word, the flash's programming unit.
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;  // Starts at 1 and goes up by one for every page the log moves onto.
+} PageHeader;
+
+// Followed by the value, padded to a double word. The CRC covers the key, length and value. An
+// empty value marks the key deleted.
+typedef struct {
+    uint16_t key;
+    uint16_t length;
+    uint32_t crc;
+} RecordHeader;
+
+static uint32_t RecordSize(uint16_t length) {
+    return sizeof(RecordHeader) + ((length + 7u) & ~7u);
+}
+
+static uintptr_t PageAddress(const KvStore *store, uint32_t page) {
+    return store->config.start + page * store->config.page_size;
+}
+
+static bool IsErased(uintptr_t address, uint32_t count) {
+    const uint32_t *words = (const uint32_t *)address;
+    for (uint32_t i = 0; i < count / 4; i++) {
+        if (words[i] != 0xFFFFFFFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The page's sequence number, or 0 if the page is free (erased, or not a valid store page).
+static uint32_t PageSequence(const KvStore *store, uint32_t page) {
+    const PageHeader *header = (const PageHeader *)PageAddress(store, page);
+    if (header->magic != PAGE_MAGIC || header->sequence == 0xFFFFFFFF) {
+        return 0;
+    }
+    return header->sequence;
+}
+
+static uint32_t RecordCrc(const RecordHeader *header, const void *value) {
+    uint32_t crc = StartTableCrc(&kCrc32Table);
+    crc = UpdateTableCrc(&kCrc32Table, crc, header, 2 * sizeof(uint16_t));
+    crc = UpdateTableCrc(&kCrc32Table, crc, value, header->length);
+    return FinishTableCrc(&kCrc32Table, crc);
+}
+
+// Walk the records of `page`, indexing the intact ones if `apply`, or calling `live` on those the
+// index still points at. Returns the offset past the last record, or the page size if the page
+// ends in something that isn't a record header, so nothing gets appended after it.
+static uint32_t ScanPage(KvStore *store, uint32_t page, bool apply,
+                         bool (*live)(KvStore *store, const RecordHeader *record)) {
+    uint32_t page_size = store->config.page_size;
+    uintptr_t base = PageAddress(store, page);
+    uint32_t offset = sizeof(PageHeader);
+    while (offset + sizeof(RecordHeader) <= page_size) {
+        const RecordHeader *record = (const RecordHeader *)(base + offset);
+        if (IsErased((uintptr_t)record, sizeof(RecordHeader))) {
+            return offset;
+        }
+        if (record->key >= KVSTORE_MAX_KEYS || offset + RecordSize(record->length) > page_size) {
+            return page_size;
+        }
+        if (apply) {
+            if (record->crc == RecordCrc(record, record + 1)) {
+                store->index[record->key] = record->length ? (const uint8_t *)record : 0;
+            }
+        } else if (store->index[record->key] == (const uint8_t *)record) {
+            if (!live(store, record)) {
+                return 0;
+            }
+        }
+        offset += RecordSize(record->length);
+    }
+    return page_size;
+}
+
+// Append a record to the head page, if it fits there. Header first, so a reset anywhere after it
+// leaves a record whose length is known and whose CRC doesn't match.
+static bool WriteRecord(KvStore *store, uint16_t key, const void *value, uint16_t length) {
+    uint32_t size = RecordSize(length);
+    uintptr_t address = PageAddress(store, store->head) + store->write_offset;
+    if (store->write_offset + size > store->config.page_size || !IsErased(address, size)) {
+        return false;
+    }
+    RecordHeader header = {.key = key, .length = length};
+    header.crc = RecordCrc(&header, value);
+    uint32_t whole = length & ~7u;
+    uint8_t tail[8];
+    for (uint32_t i = 0; i < sizeof(tail); i++) {
+        tail[i] = (whole + i < length) ? ((const uint8_t *)value)[whole + i] : 0xFF;
+    }
+    bool ok = store->config.program(address, &header, sizeof(header));
+    if (ok && whole) {
+        ok = store->config.program(address + sizeof(header), value, whole);
+    }
+    if (ok && whole < length) {
+        ok = store->config.program(address + sizeof(header) + whole, tail, sizeof(tail));
+    }
+    if (!ok) {
+        // Whatever is there now, don't append after it.
+        store->write_offset = store->config.page_size;
+        return false;
+    }
+    store->index[key] = length ? (const uint8_t *)address : 0;
+    store->write_offset += size;
+    return true;
+}
+
+static bool CopyRecord(KvStore *store, const RecordHeader *record) {
+    return WriteRecord(store, record->key, record + 1, record->length);
+}
+
+// Rebuild the index by replaying the pages in sequence order, so later records override earlier
+// ones, and make the last page the head. Returns the head's sequence number, or 0 if there are no
+// pages in use.
+static uint32_t IndexPages(KvStore *store) {
+    for (uint32_t key = 0; key < KVSTORE_MAX_KEYS; key++) {
+        store->index[key] = 0;
+    }
+    uint32_t last = 0;
+    while (1) {
+        uint32_t page = 0, sequence = 0xFFFFFFFF;
+        for (uint32_t i = 0; i < store->config.num_pages; i++) {
+            uint32_t s = PageSequence(store, i);
+            if (s > last && s < sequence) {
+                page = i;
+                sequence = s;
+            }
+        }
+        if (sequence == 0xFFFFFFFF) {
+            return last;
+        }
+        store->head = page;
+        store->sequence = sequence;
+        store->write_offset = ScanPage(store, page, true, 0);
+        last = sequence;
+    }
+}
+
+// Erase the head page and write its header again.
+static bool RestartHeadPage(KvStore *store) {
+    uintptr_t address = PageAddress(store, store->head);
+    PageHeader header = {.magic = PAGE_MAGIC, .sequence = store->sequence};
+    if (!store->config.erase_page(address) ||
+        !store->config.program(address, &header, sizeof(header))) {
+        return false;
+    }
+    IndexPages(store);
+    return true;
+}
+
+// Make sure the page after the head, the next one the log moves onto, is free: if it's in use it's
+// the oldest page, so copy its current records to the head and erase it.
+//
+// Nothing but those copies goes into the head page until then, and they always fit in an empty
+// page, so running out of room means earlier copies were torn by a reset (a torn record header
+// ends the page early). Then the head page starts over, the oldest page still has everything.
+static bool FreeNextPage(KvStore *store) {
+    uint32_t oldest = (store->head + 1) % store->config.num_pages;
+    if (!PageSequence(store, oldest)) {
+        return true;
+    }
+    if (!ScanPage(store, oldest, false, CopyRecord) &&
+        (!RestartHeadPage(store) || !ScanPage(store, oldest, false, CopyRecord))) {
+        return false;
+    }
+    return store->config.erase_page(PageAddress(store, oldest));
+}
+
+// Move the log onto the next page, which FreeNextPage() kept free, then free the one after that.
+static bool AdvancePage(KvStore *store) {
+    uint32_t next = (store->head + 1) % store->config.num_pages;
+    uintptr_t address = PageAddress(store, next);
+    if (PageSequence(store, next)) {
+        return false;
+    }
+    if (!IsErased(address, store->config.page_size) && !store->config.erase_page(address)) {
+        return false;
+    }
+    PageHeader header = {.magic = PAGE_MAGIC, .sequence = store->sequence + 1};
+    if (!store->config.program(address, &header, sizeof(header))) {
+        return false;
+    }
+    store->head = next;
+    store->sequence = header.sequence;
+    store->write_offset = sizeof(header);
+    return FreeNextPage(store);
+}
+
+// Append to the head page, moving on to new pages as they fill up. Gives up after a lap, which
+// only happens when the current values don't fit in num_pages - 2 pages. The next page has to be
+// free first (it isn't after a failed move), see FreeNextPage().
+static bool AppendRecord(KvStore *store, uint16_t key, const void *value, uint16_t length) {
+    for (uint32_t i = 0; i < store->config.num_pages; i++) {
+        if (!FreeNextPage(store)) {
+            return false;
+        }
+        if (WriteRecord(store, key, value, length)) {
+            return true;
+        }
+        if (!AdvancePage(store)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+bool MountKvStore(KvStore *store, KvStoreConfig config) {
+    store->config = config;
+    if (!IndexPages(store)) {
+        // A blank store. Start the log on the first page.
+        store->head = config.num_pages - 1;
+        store->sequence = 0;
+        return AdvancePage(store);
+    }
+    // A reset between moving onto a page and freeing the next one leaves none free.
+    return FreeNextPage(store);
+}
+
+const void *GetKvValue(const KvStore *store, uint16_t key, uint16_t *length) {
+    if (key >= KVSTORE_MAX_KEYS || !store->index[key]) {
+        return 0;
+    }
+    const RecordHeader *record = (const RecordHeader *)store->index[key];
+    if (length) {
+        *length = record->length;
+    }
+    return record + 1;
+}
+
+bool SetKvValue(KvStore *store, uint16_t key, const void *value, uint16_t length) {
+    if (key >= KVSTORE_MAX_KEYS || length == 0 ||
+        length > KVSTORE_MAX_VALUE(store->config.page_size)) {
+        return false;
+    }
+    uint16_t current_length;
+    const uint8_t *current = GetKvValue(store, key, &current_length);
+    if (current && current_length == length) {
+        uint16_t i = 0;
+        while (i < length && current[i] == ((const uint8_t *)value)[i]) {
+            i++;
+        }
+        if (i == length) {
+            return true;
+        }
+    }
+    return AppendRecord(store, key, value, length);
+}
+
+bool DeleteKvValue(KvStore *store, uint16_t key) {
+    if (key >= KVSTORE_MAX_KEYS) {
+        return false;
+    }
+    if (!store->index[key]) {
+        return true;
+    }
+    return AppendRecord(store, key, 0, 0);
+}
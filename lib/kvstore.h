@@ -0,0 +1,79 @@
+#ifndef LIB_KVSTORE_H_
+#define LIB_KVSTORE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Key-value store in flash for settings, calibration and counters that have to survive resets.
+// Keys are small integers (an enum), values are up to a page's worth of bytes.
+//
+// The store is a log: every write appends a record (key, length, CRC-32, value) to the current
+// page and deleting appends an empty one, so nothing is ever overwritten in place. The pages are
+// used round robin, so they all see the same number of erases: when the log moves onto a new page,
+// the oldest page's records that are still current are copied to the head and the oldest page is
+// erased, which keeps one page free. A RAM index holds the latest record of each key, so reads
+// are a table lookup that returns a pointer into flash, with no scanning.
+//
+// Nothing is lost to a reset at any point: records are only valid once their CRC matches, copies
+// are made before the original page is erased, and pages are ordered by a sequence number in their
+// header, so mounting replays the pages oldest first and the latest copy of each key wins. Torn
+// records are skipped, and a torn double word (which reads as garbage, see hal/flash.h) at worst
+// ends its page early.
+//
+// The flash is reached through two functions, so the store runs just as well against a RAM
+// simulation on the host. lib/kvstore_test.c does that, with a reset at every program and erase
+// step. On the target, with the linker script's storage region:
+//
+//     static KvStore settings;
+//     MountKvStore(&settings, (KvStoreConfig){
+//         .start = (uintptr_t)storage_start, .page_size = FLASH_PAGE_SIZE,
+//         .num_pages = (storage_end - storage_start) / FLASH_PAGE_SIZE,
+//         .erase_page = EraseFlashPage, .program = ProgramFlash,
+//     });
+//     uint16_t length;
+//     const Calibration *calibration = GetKvValue(&settings, kCalibrationKey, &length);
+
+#ifndef KVSTORE_MAX_KEYS
+#define KVSTORE_MAX_KEYS 32
+#endif
+
+typedef struct {
+    uintptr_t start;     // Page aligned.
+    uint32_t page_size;
+    // At least 3. The values current at any time, 8 bytes of overhead each, must fit in
+    // num_pages - 2 pages.
+    uint32_t num_pages;
+    bool (*erase_page)(uintptr_t address);
+    // `count` is a multiple of 8, and the flash there is erased.
+    bool (*program)(uintptr_t address, const void *data, size_t count);
+} KvStoreConfig;
+
+typedef struct {
+    KvStoreConfig config;
+    const uint8_t *index[KVSTORE_MAX_KEYS];  // Latest record of each key, 0 if none.
+    uint32_t head;          // Page the log appends to.
+    uint32_t sequence;      // The head page's sequence number.
+    uint32_t write_offset;  // Within the head page.
+} KvStore;
+
+// Largest value for `page_size`.
+#define KVSTORE_MAX_VALUE(page_size) ((page_size) - 16)
+
+// Rebuild the index from flash, finish whatever a reset interrupted, and format the pages if they
+// hold no store yet. Returns false if the flash couldn't be written.
+bool MountKvStore(KvStore *store, KvStoreConfig config);
+
+// The value of `key` in flash, and its `length` if that isn't 0. Returns 0 if the key isn't set.
+// The value is 8 byte aligned, and stays valid until the next SetKvValue() or DeleteKvValue().
+const void *GetKvValue(const KvStore *store, uint16_t key, uint16_t *length);
+
+// Set `key` to `length` (1 to KVSTORE_MAX_VALUE) bytes of `value`. Writing the value a key already
+// has is free. Returns false if the key or length is out of range, the store is full, or the flash
+// failed.
+bool SetKvValue(KvStore *store, uint16_t key, const void *value, uint16_t length);
+
+// Returns false if the key is out of range, the store is full, or the flash failed.
+bool DeleteKvValue(KvStore *store, uint16_t key);
+
+#endif  // LIB_KVSTORE_H_
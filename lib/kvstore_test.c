@@ -0,0 +1,302 @@
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/kvstore.h"
+
+// Host test of lib/kvstore against a RAM flash that follows the STM32G0's rules, with the power
+// cut at every program and erase step of a workload that sets, deletes and moves the log round the
+// pages a few times over:
+//
+//     gcc -O2 -I. lib/kvstore_test.c lib/kvstore.c lib/crc.c -o kvstore_test && ./kvstore_test
+//
+// Every cut is tried three ways: before the step, halfway through it (a torn double word reads as
+// garbage, a torn erase leaves bits anywhere between the old value and 1) and right after it. Then
+// the store is mounted again, which may be cut as well, and has to hold every value it held before
+// the interrupted call, except for that call's key, which may hold its old or its new value. The
+// rest of the workload has to run on from there.
+
+// Small pages, so the workload moves the log on often.
+#define PAGE_SIZE 256
+#define NUM_PAGES 4
+#define NUM_KEYS 6
+#define MAX_LENGTH 40
+#define NUM_OPS 128
+
+typedef enum {
+    kCutBefore,
+    kCutTorn,
+    kCutAfter,
+    kNumCutModes,
+} CutMode;
+
+static const char *const kCutModeNames[] = {"before", "torn", "after"};
+
+static uint8_t flash[NUM_PAGES * PAGE_SIZE] __attribute__((aligned(8)));
+
+// Program and erase steps so far, and the step to cut the power at (0 for none).
+static uint32_t steps;
+static uint32_t cut_at;
+static CutMode cut_mode;
+static jmp_buf power_cut;
+static uint32_t garbage = 1;
+
+// Calls the flash would have rejected. The store should never make any.
+static uint32_t violations;
+
+static uint32_t failures;
+
+static uint8_t Garbage() {
+    garbage = garbage * 1664525 + 1013904223;
+    return (uint8_t)(garbage >> 24);
+}
+
+static bool InFlash(uintptr_t address, size_t count) {
+    return address >= (uintptr_t)flash && address + count <= (uintptr_t)flash + sizeof(flash);
+}
+
+// Counts the step, and cuts the power if it's the one. Returns false if the step shouldn't be
+// carried out, after doing whatever the cut mode leaves of it.
+static bool Step(uint8_t *bytes, size_t count, bool erase) {
+    if (++steps != cut_at) {
+        return true;
+    }
+    if (cut_mode == kCutTorn) {
+        if (erase) {
+            for (size_t i = 0; i < count; i++) {
+                bytes[i] |= Garbage();
+            }
+        } else {
+            // Anything but erased, or the next program would go through.
+            for (size_t i = 0; i < count; i++) {
+                bytes[i] = Garbage();
+            }
+            bytes[0] &= 0x7F;
+        }
+    }
+    if (cut_mode != kCutAfter) {
+        longjmp(power_cut, 1);
+    }
+    return false;
+}
+
+static bool EraseSimulatedPage(uintptr_t address) {
+    if (!InFlash(address, PAGE_SIZE) || (address - (uintptr_t)flash) % PAGE_SIZE) {
+        violations++;
+        return false;
+    }
+    uint8_t *page = (uint8_t *)address;
+    bool cut_after = !Step(page, PAGE_SIZE, true);
+    memset(page, 0xFF, PAGE_SIZE);
+    if (cut_after) {
+        longjmp(power_cut, 1);
+    }
+    return true;
+}
+
+// Only whole, aligned double words, and only erased ones (anything else is PROGERR on the target).
+// Bits only ever go from 1 to 0.
+static bool ProgramSimulatedFlash(uintptr_t address, const void *data, size_t count) {
+    if (!InFlash(address, count) || address % 8 || count % 8) {
+        violations++;
+        return false;
+    }
+    const uint8_t *bytes = data;
+    for (size_t offset = 0; offset < count; offset += 8) {
+        uint8_t *double_word = (uint8_t *)address + offset;
+        for (uint32_t i = 0; i < 8; i++) {
+            if (double_word[i] != 0xFF) {
+                violations++;
+                return false;
+            }
+        }
+        bool cut_after = !Step(double_word, 8, false);
+        for (uint32_t i = 0; i < 8; i++) {
+            double_word[i] &= bytes[offset + i];
+        }
+        if (cut_after) {
+            longjmp(power_cut, 1);
+        }
+    }
+    return true;
+}
+
+static const KvStoreConfig kConfig = {
+    .start = (uintptr_t)flash, .page_size = PAGE_SIZE, .num_pages = NUM_PAGES,
+    .erase_page = EraseSimulatedPage, .program = ProgramSimulatedFlash,
+};
+
+// What the store should hold. A length of 0 is unset.
+typedef struct {
+    uint16_t length;
+    uint8_t value[MAX_LENGTH];
+} Value;
+
+static Value model[NUM_KEYS];
+
+// Operation `op` of the workload: mostly sets of assorted lengths, every 8th a delete, and every
+// 5th a set of the value the key already has. Keys 0 to 3 change all the time, 4 every 16th call
+// and 5 only once, so moving the log on has to copy those.
+static uint16_t OpKey(uint32_t op) {
+    if (op == 1) {
+        return 5;
+    }
+    if (op % 16 == 0) {
+        return 4;
+    }
+    return (uint16_t)((op * 3) % 4);
+}
+
+static Value OpValue(uint32_t op) {
+    Value value = {0};
+    if (op % 8 == 7) {
+        return value;
+    }
+    if (op % 5 == 4) {
+        return model[OpKey(op)];
+    }
+    value.length = (uint16_t)(1 + (op * 13) % MAX_LENGTH);
+    for (uint32_t i = 0; i < value.length; i++) {
+        value.value[i] = (uint8_t)(op + i * 31);
+    }
+    return value;
+}
+
+static bool Matches(const KvStore *store, uint16_t key, const Value *value) {
+    uint16_t length;
+    const uint8_t *stored = GetKvValue(store, key, &length);
+    if (!value->length) {
+        return stored == 0;
+    }
+    return stored && length == value->length && memcmp(stored, value->value, length) == 0;
+}
+
+static bool Apply(KvStore *store, uint16_t key, const Value *value) {
+    return value->length ? SetKvValue(store, key, value->value, value->length)
+                         : DeleteKvValue(store, key);
+}
+
+// Returns false if the power was cut, and sets `ok` to the call's result otherwise.
+static bool Mount(KvStore *store, bool *ok) {
+    if (setjmp(power_cut)) {
+        return false;
+    }
+    *ok = MountKvStore(store, kConfig);
+    return true;
+}
+
+static bool Run(KvStore *store, uint16_t key, const Value *value, bool *ok) {
+    if (setjmp(power_cut)) {
+        return false;
+    }
+    *ok = Apply(store, key, value);
+    return true;
+}
+
+static void Fail(const char *what, uint32_t cut, CutMode mode, uint32_t recovery_cut) {
+    if (failures++ < 10) {
+        printf("FAIL %s, cut at step %u (%s)", what, cut, kCutModeNames[mode]);
+        if (recovery_cut) {
+            printf(" and at step %u of the remount", recovery_cut);
+        }
+        printf("\n");
+    }
+}
+
+// Run the workload from blank flash, cutting the power at step `cut`, and then at step
+// `recovery_cut` of the remount after it (0 for none). Returns the number of steps the remount
+// after the first cut took.
+static uint32_t RunWorkload(uint32_t cut, CutMode mode, uint32_t recovery_cut) {
+    memset(flash, 0xFF, sizeof(flash));
+    memset(model, 0, sizeof(model));
+    steps = 0;
+    cut_at = cut;
+    cut_mode = mode;
+    uint32_t cuts = 0;
+    uint32_t recovery_steps = 0;
+
+    KvStore store;
+    bool ok;
+    // The last call's key and value. After a cut, the key may hold either this or the model's.
+    uint16_t pending_key = 0;
+    Value pending = model[0];
+    uint32_t op = 0;
+    while (1) {
+        uint32_t mount_start = steps;
+        if (!Mount(&store, &ok)) {
+            cut_at = (++cuts == 1 && recovery_cut) ? steps + recovery_cut : 0;
+            continue;
+        }
+        if (!ok) {
+            Fail("mount", cut, mode, recovery_cut);
+            return recovery_steps;
+        }
+        if (cuts == 1 && !recovery_steps) {
+            recovery_steps = steps - mount_start;
+        }
+        for (uint16_t key = 0; key < NUM_KEYS; key++) {
+            if (key == pending_key && Matches(&store, key, &pending)) {
+                model[key] = pending;
+            } else if (!Matches(&store, key, &model[key])) {
+                Fail("value after mounting", cut, mode, recovery_cut);
+                return recovery_steps;
+            }
+        }
+
+        for (; op < NUM_OPS; op++) {
+            pending_key = OpKey(op);
+            pending = OpValue(op);
+            if (!Run(&store, pending_key, &pending, &ok)) {
+                cut_at = (++cuts == 1 && recovery_cut) ? steps + recovery_cut : 0;
+                break;
+            }
+            if (!ok) {
+                Fail("set", cut, mode, recovery_cut);
+                return recovery_steps;
+            }
+            model[pending_key] = pending;
+        }
+        if (op == NUM_OPS) {
+            break;
+        }
+        // Cut off. Mount again, and carry on with the next call.
+        op++;
+    }
+
+    // All there, and still all there after a clean remount.
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint16_t key = 0; key < NUM_KEYS; key++) {
+            if (!Matches(&store, key, &model[key])) {
+                Fail(pass ? "value after the last remount" : "value at the end", cut, mode,
+                     recovery_cut);
+                return recovery_steps;
+            }
+        }
+        if (pass == 0 && !MountKvStore(&store, kConfig)) {
+            Fail("last remount", cut, mode, recovery_cut);
+            return recovery_steps;
+        }
+    }
+    return recovery_steps;
+}
+
+int main() {
+    RunWorkload(0, kCutBefore, 0);
+    uint32_t total_steps = steps;
+    uint32_t runs = 1;
+    for (uint32_t cut = 1; cut <= total_steps; cut++) {
+        for (uint32_t mode = 0; mode < kNumCutModes; mode++) {
+            uint32_t recovery_steps = RunWorkload(cut, (CutMode)mode, 0);
+            runs++;
+            for (uint32_t recovery_cut = 1; recovery_cut <= recovery_steps; recovery_cut++) {
+                RunWorkload(cut, (CutMode)mode, recovery_cut);
+                runs++;
+            }
+        }
+    }
+    printf("steps: %u, runs: %u, violations: %u, failures: %u\n", total_steps, runs, violations,
+           failures);
+    return violations || failures;
+}
@@ -0,0 +1,113 @@
+#include "lib/log.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/usart.h"
+
+#define LOG_SYNC 0xA5
+#define LOG_DROPPED_ID 0xFFFF
+#define LOG_HEADER(id, num_args) (LOG_SYNC | ((num_args) << 8) | ((id) << 16))
+#define LOG_MASK (LOG_BUFFER_WORDS - 1)
+
+_Static_assert((LOG_BUFFER_WORDS & LOG_MASK) == 0, "LOG_BUFFER_WORDS must be a power of two");
+
+// Producers (LOG() from any context) append at `head` inside a critical section, which is only a
+// handful of word stores long. The DMA drains from `tail`, and `sending` words from there are in
+// flight. Both indices run freely and wrap through the mask.
+static struct {
+    uint32_t buffer[LOG_BUFFER_WORDS];
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint32_t sending;
+    volatile uint32_t dropped;
+    uint32_t dropped_pending;  // Dropped since the last dropped record went out.
+    Usart usart;
+    DmaChannel channel;
+    volatile bool started;
+} log_state;
+
+static void HandleLogSent(void *context, bool ok) {
+    (void)context;
+    if (!ok) {
+        // A bad channel or buffer address, which sending again won't fix. Stop draining.
+        log_state.started = false;
+        log_state.sending = 0;
+        return;
+    }
+    log_state.tail += log_state.sending;
+    log_state.sending = 0;
+    ServiceLog();
+}
+
+void StartLog(Usart usart, DmaChannel channel) {
+    log_state.usart = usart;
+    log_state.channel = channel;
+    log_state.started = true;
+    ServiceLog();
+}
+
+void ServiceLog() {
+    uint32_t primask = EnterCritical();
+    uint32_t tail = log_state.tail;
+    uint32_t used = log_state.head - tail;
+    if (!log_state.started || log_state.sending || used == 0) {
+        ExitCritical(primask);
+        return;
+    }
+    // Send up to the end of the buffer, the rest goes in the next transfer.
+    uint32_t start = tail & LOG_MASK;
+    uint32_t count = LOG_BUFFER_WORDS - start;
+    if (count > used) {
+        count = used;
+    }
+    log_state.sending = count;
+    ExitCritical(primask);
+    StartUsartDma(log_state.usart, log_state.channel, &log_state.buffer[start], 4 * count,
+                  HandleLogSent, 0);
+}
+
+void FlushLog() {
+    while (log_state.started && log_state.head != log_state.tail) {
+        ServiceLog();
+    }
+}
+
+uint32_t GetLogDropped() {
+    return log_state.dropped;
+}
+
+// Called from ISRs.
+HOT_FUNCTION
+void WriteLog(uint32_t id, const uint32_t *args, uint32_t num_args) {
+    uint32_t primask = EnterCritical();
+    uint32_t head = log_state.head;
+    uint32_t free = LOG_BUFFER_WORDS - (head - log_state.tail);
+    uint32_t *buffer = log_state.buffer;
+    if (log_state.dropped_pending) {
+        // Report the gap first, so the decoder shows it in the right place.
+        if (free < 2 + 1 + num_args) {
+            log_state.dropped++;
+            log_state.dropped_pending++;
+            ExitCritical(primask);
+            return;
+        }
+        buffer[head++ & LOG_MASK] = LOG_HEADER(LOG_DROPPED_ID, 1);
+        buffer[head++ & LOG_MASK] = log_state.dropped_pending;
+        log_state.dropped_pending = 0;
+    } else if (free < 1 + num_args) {
+        log_state.dropped++;
+        log_state.dropped_pending++;
+        ExitCritical(primask);
+        return;
+    }
+    buffer[head++ & LOG_MASK] = LOG_HEADER(id, num_args);
+    while (num_args--) {
+        buffer[head++ & LOG_MASK] = *args++;
+    }
+    log_state.head = head;
+    ExitCritical(primask);
+}
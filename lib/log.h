@@ -0,0 +1,74 @@
+#ifndef LIB_LOG_H_
+#define LIB_LOG_H_
+
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/usart.h"
+
+// Deferred binary logging. Format strings never reach the target's flash. LOG() puts them in the
+// .logstr section, which the linker script marks INFO (not loaded), and the firmware only sends
+// the string's address there as a 16 bit ID, followed by the raw 32 bit arguments. The host
+// decoder (tools/log_decode.py) looks the IDs up in the ELF and does the formatting, so there's
+// no printf on the target, and a record is a few bytes instead of a line of text.
+//
+//     LOG("adc overrun, %u blocks behind", GetAdcOverruns());
+//
+// LOG() only copies a record into a RAM ring buffer, which makes it cheap enough for ISRs. The
+// buffer drains to the USART by DMA in the background: call ServiceLog() now and then (from the
+// main loop, say), and each finished transfer chains the next one from its interrupt. Records
+// that don't fit are dropped and counted, and the decoder reports how many went missing.
+//
+// Arguments are integers, chars or pointers, up to LOG_MAX_ARGS of them, and each is sent as 32
+// bits. %s works for pointers to constant strings (in flash), which the decoder reads from the ELF.
+// Strings in RAM can't be logged.
+//
+// Wire format, little endian words: a header word, 0xA5 | (number of args << 8) | (ID << 16),
+// then the arguments. ID 0xFFFF means records were dropped, with the count as its argument.
+
+#define LOG_MAX_ARGS 4
+
+// Ring buffer size in 32 bit words. Must be a power of two.
+#ifndef LOG_BUFFER_WORDS
+#define LOG_BUFFER_WORDS 128
+#endif
+
+#define LOG(format, ...)                                                                           \
+    do {                                                                                           \
+        static const char log_format[] __attribute__((section(".logstr"), used)) = format;         \
+        _Static_assert(LOG_NUM_ARGS(__VA_ARGS__) <= LOG_MAX_ARGS, "Too many LOG arguments");       \
+        const uint32_t log_args[] = {0, LOG_CAST_ARGS(LOG_NUM_ARGS(__VA_ARGS__), __VA_ARGS__)};    \
+        WriteLog((uint32_t)(uintptr_t)log_format, log_args + 1, LOG_NUM_ARGS(__VA_ARGS__));        \
+    } while (0)
+
+// Start draining to `usart` (already configured) with DMA `channel`. A DMA transfer error stops the
+// draining until the next StartLog(), and records are dropped once the buffer fills.
+void StartLog(Usart usart, DmaChannel channel);
+
+// Start a transfer if there's anything to send and the DMA is idle. Safe to call from anywhere.
+void ServiceLog();
+
+// Block until everything logged so far has been handed to the USART, e.g. before a reset. Returns
+// early if the draining has stopped.
+void FlushLog();
+
+// Number of records dropped because the buffer was full.
+uint32_t GetLogDropped();
+
+// Used by LOG().
+void WriteLog(uint32_t id, const uint32_t *args, uint32_t num_args);
+
+// Argument counting and casting for LOG(). Everything goes out as 32 bits.
+#define LOG_NUM_ARGS(...) LOG_NUM_ARGS_(0, ##__VA_ARGS__, 5, 4, 3, 2, 1, 0)
+#define LOG_NUM_ARGS_(_0, _1, _2, _3, _4, _5, n, ...) n
+#define LOG_CAST(x) (uint32_t)(uintptr_t)(x)
+#define LOG_CAST_0(...)
+#define LOG_CAST_1(a) LOG_CAST(a)
+#define LOG_CAST_2(a, b) LOG_CAST(a), LOG_CAST(b)
+#define LOG_CAST_3(a, b, c) LOG_CAST(a), LOG_CAST(b), LOG_CAST(c)
+#define LOG_CAST_4(a, b, c, d) LOG_CAST(a), LOG_CAST(b), LOG_CAST(c), LOG_CAST(d)
+#define LOG_CAST_5(...) 0
+#define LOG_CAST_ARGS(n, ...) LOG_CAST_ARGS_(n, ##__VA_ARGS__)
+#define LOG_CAST_ARGS_(n, ...) LOG_CAST_##n(__VA_ARGS__)
+
+#endif  // LIB_LOG_H_
@@ -0,0 +1,208 @@
+#include "lib/logic_analyzer.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+
+#define LOGIC_MAGIC 0x43474F4C  // "LOGC"
+#define NO_TRIGGER 0xFFFFFFFF
+#define MAX_RUN 0xFFFF
+// Runs gathered per WriteUsart() in DumpLogicCapture().
+#define RUNS_PER_WRITE 16
+
+// DMAMUX update requests, kDmaRequestMemory marks timers without one.
+static DmaRequest UpdateRequest(Timer timer) {
+    switch (timer) {
+        case kTimer1:
+            return kDmaRequestTim1Up;
+        case kTimer2:
+            return kDmaRequestTim2Up;
+        case kTimer3:
+            return kDmaRequestTim3Up;
+        case kTimer16:
+            return kDmaRequestTim16Up;
+        case kTimer17:
+            return kDmaRequestTim17Up;
+        default:
+            return kDmaRequestMemory;
+    }
+}
+
+// Index of the first of `count` samples that enters the trigger pattern, or `count` if none does.
+// This runs for every sample while armed.
+HOT_FUNCTION
+static uint32_t FindTrigger(LogicAnalyzer *analyzer, const uint16_t *samples, uint32_t count) {
+    uint32_t mask = analyzer->settings.trigger_mask;
+    uint32_t value = analyzer->settings.trigger_value;
+    bool matched = analyzer->matched;
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        bool match = (samples[i] & mask) == value;
+        if (match && !matched) {
+            break;
+        }
+        matched = match;
+    }
+    analyzer->matched = matched;
+    return i;
+}
+
+// Stop sampling and work out how many samples there are in total: everything up to the last
+// finished half, plus however far the DMA got into the next one before the timer stopped.
+static void FinishCapture(LogicAnalyzer *analyzer) {
+    const LogicAnalyzerSettings *settings = &analyzer->settings;
+    StopTimer(settings->timer);
+    EnableTimerDmaRequests(settings->timer, 0);
+    uint32_t position = (settings->length - GetDmaRemaining(settings->dma)) % settings->length;
+    StopDma(settings->dma);
+    uint32_t boundary = analyzer->written % settings->length;
+    analyzer->end = analyzer->written + (position + settings->length - boundary) % settings->length;
+    analyzer->state = kLogicDone;
+}
+
+static void FinishHalf(LogicAnalyzer *analyzer, uint32_t half) {
+    const LogicAnalyzerSettings *settings = &analyzer->settings;
+    uint32_t half_length = settings->length / 2;
+    if (analyzer->state == kLogicArmed) {
+        uint32_t i = FindTrigger(analyzer, settings->buffer + half * half_length, half_length);
+        if (i < half_length) {
+            analyzer->trigger = analyzer->written + i;
+            analyzer->stop = analyzer->trigger + settings->post_trigger;
+            analyzer->state = kLogicTriggered;
+        }
+    }
+    analyzer->written += half_length;
+    if (analyzer->state == kLogicTriggered && analyzer->written >= analyzer->stop) {
+        FinishCapture(analyzer);
+    }
+}
+
+static void HandleLogicDma(void *context, uint32_t events) {
+    LogicAnalyzer *analyzer = context;
+    if (events & kDmaTransferError) {
+        FinishCapture(analyzer);
+        return;
+    }
+    if ((events & kDmaHalfTransfer) && analyzer->state != kLogicDone) {
+        FinishHalf(analyzer, 0);
+    }
+    if ((events & kDmaTransferComplete) && analyzer->state != kLogicDone) {
+        FinishHalf(analyzer, 1);
+    }
+}
+
+bool StartLogicCapture(LogicAnalyzer *analyzer, LogicAnalyzerSettings settings) {
+    DmaRequest request = UpdateRequest(settings.timer);
+    if (request == kDmaRequestMemory || settings.length < 4 || settings.length % 2 != 0 ||
+        settings.post_trigger >= settings.length / 2 || settings.sample_hz == 0) {
+        return false;
+    }
+    settings.trigger_value &= settings.trigger_mask;
+    analyzer->settings = settings;
+    analyzer->written = 0;
+    analyzer->end = 0;
+    analyzer->trigger = NO_TRIGGER;
+    // A pattern that's already there when sampling starts has to go away and come back first.
+    analyzer->matched = (settings.trigger_mask != 0);
+    analyzer->state = kLogicArmed;
+
+    // Sampling a port without its clock reads zeros.
+    SET_BIT(RCC_REGS->iopenr, (1 << settings.port));
+    uint32_t clock_hz = GetTimerClockHz();
+    TimerTiming timing = SolveTimerTiming(settings.timer, clock_hz, settings.sample_hz);
+    analyzer->sample_hz = clock_hz / ((timing.prescaler + 1) * (timing.reload + 1));
+    ConfigureTimer(settings.timer, timing);
+
+    DmaSettings dma_settings = {
+        .request = request,
+        .direction = kDmaPeripheralToMemory,
+        .peripheral_width = kDma16Bit,
+        .memory_width = kDma16Bit,
+        .peripheral_increment = false,
+        .memory_increment = true,
+        .circular = true,
+        .priority = kDmaPriorityVeryHigh,
+    };
+    ConfigureDma(settings.dma, dma_settings, HandleLogicDma, analyzer);
+    StartDma(settings.dma, &GPIO_REGS(settings.port)->idr, settings.buffer, settings.length,
+             (kDmaHalfTransfer | kDmaTransferComplete | kDmaTransferError));
+    EnableTimerDmaRequests(settings.timer, kTimerUpdateDma);
+    StartTimer(settings.timer);
+    return true;
+}
+
+void StopLogicCapture(LogicAnalyzer *analyzer) {
+    // The DMA interrupt may be about to finish the capture too.
+    uint32_t primask = EnterCritical();
+    if (analyzer->state == kLogicArmed || analyzer->state == kLogicTriggered) {
+        FinishCapture(analyzer);
+    }
+    ExitCritical(primask);
+}
+
+bool IsLogicCaptureDone(const LogicAnalyzer *analyzer) {
+    return analyzer->state == kLogicDone;
+}
+
+uint32_t GetLogicSampleHz(const LogicAnalyzer *analyzer) {
+    return analyzer->sample_hz;
+}
+
+typedef struct {
+    Usart usart;
+    uint16_t pairs[2 * RUNS_PER_WRITE];
+    uint32_t count;
+} RunWriter;
+
+static void PutRun(RunWriter *writer, uint16_t value, uint16_t count) {
+    writer->pairs[writer->count++] = value;
+    writer->pairs[writer->count++] = count;
+    if (writer->count == 2 * RUNS_PER_WRITE) {
+        WriteUsart(writer->usart, writer->pairs, sizeof(writer->pairs));
+        writer->count = 0;
+    }
+}
+
+void DumpLogicCapture(const LogicAnalyzer *analyzer, Usart usart) {
+    const LogicAnalyzerSettings *settings = &analyzer->settings;
+    uint32_t end = analyzer->end;
+    uint32_t count = end < settings->length ? end : settings->length;
+    uint32_t first = end - count;
+    // The trigger is only lost if the interrupt was held off long enough for the samples after it
+    // to wrap around.
+    uint32_t trigger = NO_TRIGGER;
+    if (analyzer->trigger != NO_TRIGGER && analyzer->trigger >= first) {
+        trigger = analyzer->trigger - first;
+    }
+    const uint32_t header[] = {LOGIC_MAGIC, analyzer->sample_hz, count, trigger, settings->port};
+    WriteUsart(usart, header, sizeof(header));
+
+    RunWriter writer = {.usart = usart, .count = 0};
+    uint32_t index = first % settings->length;
+    uint16_t value = settings->buffer[index];
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t sample = settings->buffer[index];
+        if (++index == settings->length) {
+            index = 0;
+        }
+        if (sample != value || run == MAX_RUN) {
+            PutRun(&writer, value, run);
+            value = sample;
+            run = 0;
+        }
+        run++;
+    }
+    if (run) {
+        PutRun(&writer, value, run);
+    }
+    PutRun(&writer, 0, 0);
+    WriteUsart(usart, writer.pairs, writer.count * sizeof(uint16_t));
+}
@@ -0,0 +1,86 @@
+#ifndef LIB_LOGIC_ANALYZER_H_
+#define LIB_LOGIC_ANALYZER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+
+// A built-in logic analyzer: all 16 pins of a GPIO port, sampled at a fixed rate into a RAM ring.
+// A timer's update event requests a DMA transfer from the port's IDR for every sample, so sampling
+// takes no CPU time at all, and runs up to a few MHz at 64 MHz HCLK (each sample is a handful of
+// bus cycles, so less if other DMA channels are busy). DumpLogicCapture() sends the capture out run
+// length encoded, and tools/la_to_vcd.py turns the dump into a VCD file for GTKWave or PulseView.
+//
+// The ring keeps overwriting its oldest samples until the trigger: the first sample where the pins
+// in `trigger_mask` read `trigger_value` after one where they didn't. An edge on one pin is a mask
+// of just that pin, a pattern on a bus is a mask of all of its pins. The DMA interrupt looks for it
+// one half of the buffer at a time, a few cycles per sample, and once it's found sampling goes on
+// for `post_trigger` samples and then stops. So the capture ends with those and holds at least
+// length / 2 - post_trigger samples from before the trigger, usually more (minus however many
+// arrive while the DMA interrupt is held off). A zero mask triggers on the first sample.
+//
+//     static uint16_t samples[4096];
+//     static LogicAnalyzer analyzer;
+//     LogicAnalyzerSettings settings = {
+//         .port = kGpioA, .timer = kTimer16, .sample_hz = 1000000, .dma = kDmaChannel2,
+//         .buffer = samples, .length = 4096,
+//         .trigger_mask = GPIO_PIN(0), .trigger_value = GPIO_PIN(0), .post_trigger = 1024,
+//     };
+//     StartLogicCapture(&analyzer, settings);
+//     while (!IsLogicCaptureDone(&analyzer));
+//     DumpLogicCapture(&analyzer, kUsart2);
+
+typedef struct {
+    GpioPort port;
+    Timer timer;                 // Paces the samples. Any but TIM14, which has no DMA request.
+    uint32_t sample_hz;          // Rounded to what the timer can do, see GetLogicSampleHz().
+    DmaChannel dma;
+    uint16_t *buffer;            // Ring of `length` samples.
+    uint16_t length;             // Even, at least 4.
+    uint16_t trigger_mask;       // GPIO_PIN()s, 0 to trigger right away.
+    uint16_t trigger_value;
+    uint16_t post_trigger;       // Samples after the trigger, below length / 2.
+} LogicAnalyzerSettings;
+
+typedef enum {
+    kLogicIdle,
+    kLogicArmed,       // Sampling and looking for the trigger.
+    kLogicTriggered,   // Sampling until `post_trigger` samples after the trigger.
+    kLogicDone,
+} LogicState;
+
+typedef struct {
+    LogicAnalyzerSettings settings;
+    uint32_t sample_hz;
+    uint32_t written;            // Samples up to the last finished half of the buffer.
+    uint32_t end;                // Samples in total, once done.
+    uint32_t trigger;            // Index of the trigger sample, once triggered.
+    uint32_t stop;               // Index to stop sampling at.
+    bool matched;                // The last sample searched matched the trigger pattern.
+    volatile LogicState state;
+} LogicAnalyzer;
+
+// Configure the timer and DMA channel and start sampling. Returns false if the timer has no DMA
+// request or the settings don't fit the buffer.
+bool StartLogicCapture(LogicAnalyzer *analyzer, LogicAnalyzerSettings settings);
+
+// Stop sampling, e.g. when the trigger never came. The capture so far can still be dumped.
+void StopLogicCapture(LogicAnalyzer *analyzer);
+
+bool IsLogicCaptureDone(const LogicAnalyzer *analyzer);
+
+// The actual sample rate.
+uint32_t GetLogicSampleHz(const LogicAnalyzer *analyzer);
+
+// Send a finished or stopped capture, oldest sample first, to `usart` (already configured) with
+// blocking writes. Wire format, little endian: the words 0x43474F4C ("LOGC"), sample rate in Hz,
+// number of samples, index of the trigger sample (0xFFFFFFFF if there was none) and GPIO port (0
+// for A), then runs of equal samples as 16 bit value and 16 bit count pairs, ending with a pair
+// with a count of 0.
+void DumpLogicCapture(const LogicAnalyzer *analyzer, Usart usart);
+
+#endif  // LIB_LOGIC_ANALYZER_H_
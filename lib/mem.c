@@ -0,0 +1,255 @@
+#include "lib/mem.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/macros.h"
+
+// Pin the optimization level regardless of the build's. Also stop GCC from recognizing the byte
+// loops as memcpy/memset and calling those instead, which would recurse once these replace libc's,
+// and from assuming the word accesses can't alias the caller's data.
+#ifdef MEM_OPTIMIZE_SIZE
+#define MEM_FUNCTION                                                                               \
+    __attribute__((optimize("Os", "no-tree-loop-distribute-patterns", "no-strict-aliasing")))
+#else
+#define MEM_FUNCTION                                                                               \
+    __attribute__((optimize("O2", "no-tree-loop-distribute-patterns", "no-strict-aliasing")))
+#endif
+
+#define IS_WORD_ALIGNED(p) (((uintptr_t)(p) & 3) == 0)
+
+#ifndef MEM_OPTIMIZE_SIZE
+
+// Below this many bytes, aligning isn't worth it.
+#define SMALL_COUNT 8
+
+// Copy `blocks` 16 byte blocks, 4 words per LDM/STM. Both pointers must be word aligned. The
+// operands are pinned to low registers since that's all the Thumb-1 LDM/STM can address, which
+// leaves r3-r6 for data (r7 may be the frame pointer). GCC treats Thumb-1 inline assembly as
+// divided syntax by default, hence the .syntax directive.
+HOT_INLINE void CopyBlocks(uint32_t **dest, const uint32_t **src, size_t blocks) {
+#if defined(__ARM_ARCH_6M__)
+    uint32_t *d = *dest;
+    const uint32_t *s = *src;
+    __asm__ volatile(
+        "    .syntax unified\n"
+        "1:\n"
+        "    ldmia %[s]!, {r3, r4, r5, r6}\n"
+        "    stmia %[d]!, {r3, r4, r5, r6}\n"
+        "    subs %[blocks], %[blocks], #1\n"
+        "    bne 1b\n"
+        : [d] "+l" (d), [s] "+l" (s), [blocks] "+l" (blocks)
+        :
+        : "r3", "r4", "r5", "r6", "cc", "memory");
+    *dest = d;
+    *src = s;
+#else
+    uint32_t *d = *dest;
+    const uint32_t *s = *src;
+    while (blocks--) {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = s[3];
+        d += 4;
+        s += 4;
+    }
+    *dest = d;
+    *src = s;
+#endif
+}
+
+// Fill `blocks` 16 byte blocks with `pattern`, 4 words per STM. `dest` must be word aligned.
+HOT_INLINE void SetBlocks(uint32_t **dest, uint32_t pattern, size_t blocks) {
+#if defined(__ARM_ARCH_6M__)
+    uint32_t *d = *dest;
+    __asm__ volatile(
+        "    .syntax unified\n"
+        "    movs r3, %[pattern]\n"
+        "    movs r4, %[pattern]\n"
+        "    movs r5, %[pattern]\n"
+        "    movs r6, %[pattern]\n"
+        "1:\n"
+        "    stmia %[d]!, {r3, r4, r5, r6}\n"
+        "    subs %[blocks], %[blocks], #1\n"
+        "    bne 1b\n"
+        : [d] "+l" (d), [blocks] "+l" (blocks)
+        : [pattern] "l" (pattern)
+        : "r3", "r4", "r5", "r6", "cc", "memory");
+    *dest = d;
+#else
+    uint32_t *d = *dest;
+    while (blocks--) {
+        d[0] = pattern;
+        d[1] = pattern;
+        d[2] = pattern;
+        d[3] = pattern;
+        d += 4;
+    }
+    *dest = d;
+#endif
+}
+
+// Copy `words` words to an aligned `dest` from a source that is `shift` bytes (1 to 3) past the
+// aligned `src`. Every source word is loaded once and merged with its neighbour (little endian).
+// The first and last source words are only partly used, but an aligned word never crosses into
+// another memory region, so reading all of it is safe.
+HOT_INLINE void CopyShiftedWords(uint32_t *dest, const uint32_t *src, size_t words,
+                                 uint32_t shift) {
+    uint32_t right = 8 * shift;
+    uint32_t left = 32 - right;
+    uint32_t carry = *src++;
+    while (words--) {
+        uint32_t next = *src++;
+        *dest++ = (carry >> right) | (next << left);
+        carry = next;
+    }
+}
+
+MEM_FUNCTION void *CopyMemory(void *dest, const void *src, size_t count) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (count >= SMALL_COUNT) {
+        // Byte copy the head until the destination is aligned.
+        while (!IS_WORD_ALIGNED(d)) {
+            *d++ = *s++;
+            count--;
+        }
+        uint32_t shift = (uintptr_t)s & 3;
+        if (shift == 0) {
+            uint32_t *dw = (uint32_t *)d;
+            const uint32_t *sw = (const uint32_t *)s;
+            if (count >= 16) {
+                CopyBlocks(&dw, &sw, count / 16);
+                count &= 15;
+            }
+            while (count >= 4) {
+                *dw++ = *sw++;
+                count -= 4;
+            }
+            d = (uint8_t *)dw;
+            s = (const uint8_t *)sw;
+        } else {
+            // Stop one word early, the merge reads a word past the last one it writes.
+            size_t words = (count / 4) - 1;
+            CopyShiftedWords((uint32_t *)d, (const uint32_t *)(s - shift), words, shift);
+            d += 4 * words;
+            s += 4 * words;
+            count -= 4 * words;
+        }
+    }
+    while (count--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+MEM_FUNCTION void *SetMemory(void *dest, int value, size_t count) {
+    uint8_t *d = dest;
+    uint8_t byte = (uint8_t)value;
+    if (count >= SMALL_COUNT) {
+        while (!IS_WORD_ALIGNED(d)) {
+            *d++ = byte;
+            count--;
+        }
+        uint32_t pattern = byte * 0x01010101u;
+        uint32_t *dw = (uint32_t *)d;
+        if (count >= 16) {
+            SetBlocks(&dw, pattern, count / 16);
+            count &= 15;
+        }
+        while (count >= 4) {
+            *dw++ = pattern;
+            count -= 4;
+        }
+        d = (uint8_t *)dw;
+    }
+    while (count--) {
+        *d++ = byte;
+    }
+    return dest;
+}
+
+#else  // MEM_OPTIMIZE_SIZE
+
+MEM_FUNCTION void *CopyMemory(void *dest, const void *src, size_t count) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (IS_WORD_ALIGNED((uintptr_t)d | (uintptr_t)s)) {
+        for (; count >= 4; count -= 4, d += 4, s += 4) {
+            *(uint32_t *)d = *(const uint32_t *)s;
+        }
+    }
+    while (count--) {
+        *d++ = *s++;
+    }
+    return dest;
+}
+
+MEM_FUNCTION void *SetMemory(void *dest, int value, size_t count) {
+    uint8_t *d = dest;
+    uint8_t byte = (uint8_t)value;
+    if (IS_WORD_ALIGNED(d)) {
+        uint32_t pattern = byte * 0x01010101u;
+        for (; count >= 4; count -= 4, d += 4) {
+            *(uint32_t *)d = pattern;
+        }
+    }
+    while (count--) {
+        *d++ = byte;
+    }
+    return dest;
+}
+
+#endif  // MEM_OPTIMIZE_SIZE
+
+// Overlapping moves (compacting a buffer in place, say) are rare enough that they only get the
+// word loop, and only when both sides share their alignment. Moving down copies forwards and
+// moving up copies backwards, so every word is read before it's overwritten.
+MEM_FUNCTION void *MoveMemory(void *dest, const void *src, size_t count) {
+    uint8_t *d = dest;
+    const uint8_t *s = src;
+    if (d == s || d + count <= s || s + count <= d) {
+        return CopyMemory(dest, src, count);
+    }
+    bool words = IS_WORD_ALIGNED((uintptr_t)d ^ (uintptr_t)s);
+    if (d < s) {
+        if (words) {
+            while (count && !IS_WORD_ALIGNED(d)) {
+                *d++ = *s++;
+                count--;
+            }
+            for (; count >= 4; count -= 4, d += 4, s += 4) {
+                *(uint32_t *)d = *(const uint32_t *)s;
+            }
+        }
+        while (count--) {
+            *d++ = *s++;
+        }
+    } else {
+        d += count;
+        s += count;
+        if (words) {
+            while (count && !IS_WORD_ALIGNED(d)) {
+                *--d = *--s;
+                count--;
+            }
+            for (; count >= 4; count -= 4) {
+                d -= 4;
+                s -= 4;
+                *(uint32_t *)d = *(const uint32_t *)s;
+            }
+        }
+        while (count--) {
+            *--d = *--s;
+        }
+    }
+    return dest;
+}
+
+#ifdef MEM_REPLACE_LIBC
+void *memcpy(void *dest, const void *src, size_t count) __attribute__((alias("CopyMemory")));
+void *memset(void *dest, int value, size_t count) __attribute__((alias("SetMemory")));
+void *memmove(void *dest, const void *src, size_t count) __attribute__((alias("MoveMemory")));
+#endif
@@ -0,0 +1,30 @@
+#ifndef LIB_MEM_H_
+#define LIB_MEM_H_
+
+#include <stddef.h>
+
+// memcpy/memset/memmove for the Cortex-M0+. newlib-nano's versions go a byte at a time. These
+// move whole words, 16 bytes per LDM/STM burst, once the destination is word aligned. Any
+// unaligned head and tail is done in bytes. When the source and destination alignments don't
+// match, aligned source words are shifted and merged, because the M0+ faults on unaligned word
+// accesses.
+//
+// The build picks one of two variants:
+//
+//   (default)           Speed. LDM/STM bursts plus the shift and merge path.
+//   MEM_OPTIMIZE_SIZE   Size. A plain word loop when the source and destination are both word
+//                       aligned, bytes otherwise.
+//
+// With MEM_REPLACE_LIBC defined, memcpy, memset and memmove are aliases of these functions, so
+// linking the library replaces newlib's for all code, compiler generated struct copies included.
+// In Bazel, that's depending on //lib:mem (speed) or //lib:mem_small (size). In Make, set MEM to
+// `speed` or `size` in the project's Makefile.
+
+void *CopyMemory(void *dest, const void *src, size_t count);
+
+void *SetMemory(void *dest, int value, size_t count);
+
+// Like CopyMemory, but the buffers may overlap.
+void *MoveMemory(void *dest, const void *src, size_t count);
+
+#endif  // LIB_MEM_H_
@@ -0,0 +1,87 @@
+#include "lib/trace.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/cycle_counter.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+#include "hal/usart.h"
+
+#define TRACE_MAGIC 0x45435254  // "TRCE"
+#define TRACE_MASK (TRACE_BUFFER_EVENTS - 1)
+
+_Static_assert((TRACE_BUFFER_EVENTS & TRACE_MASK) == 0,
+               "TRACE_BUFFER_EVENTS must be a power of two");
+_Static_assert(sizeof(TraceEvent) == 8, "TraceEvent must pack into two words");
+
+// `head` runs freely, so it also counts every event ever recorded, and the buffer holds the last
+// TRACE_BUFFER_EVENTS of them.
+static struct {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    uint32_t head;
+    volatile bool running;
+} trace;
+
+void StartTrace() {
+    if (!trace.running) {
+        StartCycleCounter();
+        trace.running = true;
+    }
+}
+
+void StopTrace() {
+    trace.running = false;
+}
+
+void ClearTrace() {
+    uint32_t primask = EnterCritical();
+    trace.head = 0;
+    ExitCritical(primask);
+}
+
+void DumpTrace(Usart usart) {
+    bool running = trace.running;
+    trace.running = false;
+    uint32_t head = trace.head;
+    uint32_t count = head < TRACE_BUFFER_EVENTS ? head : TRACE_BUFFER_EVENTS;
+    const uint32_t header[] = {TRACE_MAGIC, GetTimerClockHz(), count, head - count};
+    WriteUsart(usart, header, sizeof(header));
+    // Oldest first, in up to two pieces around the end of the buffer.
+    uint32_t start = (head - count) & TRACE_MASK;
+    uint32_t first = TRACE_BUFFER_EVENTS - start;
+    if (first > count) {
+        first = count;
+    }
+    WriteUsart(usart, &trace.events[start], first * sizeof(TraceEvent));
+    WriteUsart(usart, &trace.events[0], (count - first) * sizeof(TraceEvent));
+    trace.running = running;
+}
+
+// Called from every ISR. The timestamp is taken inside the critical section, so events land in
+// the buffer in time order.
+HOT_FUNCTION
+void RecordTrace(TraceKind kind, uint16_t id, uint8_t value) {
+    if (!trace.running) {
+        return;
+    }
+    uint32_t primask = EnterCritical();
+    TraceEvent *event = &trace.events[trace.head++ & TRACE_MASK];
+    event->cycles = GetCycles();
+    event->id = id;
+    event->kind = kind;
+    event->value = value;
+    ExitCritical(primask);
+}
+
+// Strong versions of system.c's weak no-op hooks.
+HOT_FUNCTION
+void EnterIsrHook() {
+    RecordTrace(kTraceIsrEnter, GetActiveException(), 0);
+}
+
+HOT_FUNCTION
+void ExitIsrHook() {
+    RecordTrace(kTraceIsrExit, GetActiveException(), 0);
+}
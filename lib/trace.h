@@ -0,0 +1,92 @@
+#ifndef LIB_TRACE_H_
+#define LIB_TRACE_H_
+
+#include <stdint.h>
+
+#include "hal/nvic.h"
+#include "hal/usart.h"
+
+// Timeline tracing of interrupts, user spans and task switches, for seeing how long handlers run,
+// what preempts what, and how much their timing jitters. Every event is a timestamp from the cycle
+// counter (hal/cycle_counter.h) plus an ID, 8 bytes in a RAM ring that overwrites its oldest
+// events, so the buffer always holds the most recent history. DumpTrace() sends it out on demand,
+// and tools/trace_to_chrome.py turns the dump into a Chrome trace (chrome://tracing or
+// ui.perfetto.dev), one track per interrupt plus main.
+//
+// Linking this library is enough to trace the HAL's own interrupt handlers (timers and DMA), see
+// EnterIsrHook(). Handlers written elsewhere, SysTickHandler say, add the two macros themselves:
+//
+//     void SysTickHandler() {
+//         TRACE_ISR_ENTER();
+//         ...
+//         TRACE_ISR_EXIT();
+//     }
+//
+// User spans and markers are named with string literals, which like LOG()'s format strings go to
+// the unloaded .logstr section, so only a 16 bit ID is recorded and the converter finds the name in
+// the ELF:
+//
+//     TRACE_BEGIN("filter");
+//     ProcessBlock();
+//     TRACE_END("filter");
+//     TRACE_INSTANT("overrun", missed);
+//
+// There's no scheduler, so "tasks" are whatever the super loop runs: call TRACE_TASK("blink")
+// before resuming each coroutine, and the converter draws one slice per task on its own track.
+//
+// Recording an event takes a short critical section, a few dozen cycles, and next to nothing while
+// tracing is stopped.
+
+// Events in the ring buffer, 8 bytes each. Must be a power of two.
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 128
+#endif
+
+typedef enum {
+    kTraceIsrEnter,  // id is the exception number, see GetActiveException().
+    kTraceIsrExit,
+    kTraceBegin,     // id is a name.
+    kTraceEnd,
+    kTraceInstant,   // id is a name, with an 8 bit value.
+    kTraceTask,      // id is the name of the task that runs from now on.
+} TraceKind;
+
+typedef struct {
+    uint32_t cycles;
+    uint16_t id;
+    uint8_t kind;
+    uint8_t value;
+} TraceEvent;
+
+#define TRACE_ISR_ENTER() EnterIsrHook()
+#define TRACE_ISR_EXIT() ExitIsrHook()
+#define TRACE_BEGIN(name) RecordTrace(kTraceBegin, TRACE_ID(name), 0)
+#define TRACE_END(name) RecordTrace(kTraceEnd, TRACE_ID(name), 0)
+#define TRACE_INSTANT(name, value) RecordTrace(kTraceInstant, TRACE_ID(name), (value))
+#define TRACE_TASK(name) RecordTrace(kTraceTask, TRACE_ID(name), 0)
+
+// Start (or resume) recording. Also starts the cycle counter, which takes over TIM2.
+void StartTrace();
+
+// Stop recording, keeping the buffer. E.g. right after spotting an overrun, so the lead up to it
+// isn't overwritten.
+void StopTrace();
+
+// Forget everything recorded so far.
+void ClearTrace();
+
+// Send the buffer, oldest event first, to `usart` (already configured) with blocking writes.
+// Recording pauses meanwhile. Wire format, little endian: the words 0x45435254 ("TRCE"), cycle
+// counter Hz, number of events, and number of older events lost to overwriting, then the events.
+void DumpTrace(Usart usart);
+
+// Used by the macros above.
+void RecordTrace(TraceKind kind, uint16_t id, uint8_t value);
+
+#define TRACE_ID(name)                                                                             \
+    __extension__({                                                                                \
+        static const char trace_name[] __attribute__((section(".logstr"), used)) = name;           \
+        (uint16_t)(uintptr_t)trace_name;                                                           \
+    })
+
+#endif  // LIB_TRACE_H_
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/flash.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+#include "hal/usart.h"
+#include "lib/boot.h"
+
+// Not part of the HAL. Only used to time out of update mode.
+typedef struct {
+    volatile uint32_t csr, rvr, cvr, calib;
+} SysTickRegisters;
+#define SYSTICK_REGS ((SysTickRegisters *)0xE000E010)
+#define SYSTICK_CSR_ENABLE (1 << 0)
+#define SYSTICK_CSR_CLKSOURCE (1 << 2)
+#define SYSTICK_CSR_COUNTFLAG (1 << 16)
+
+// ST-Link virtual COM port, USART2 TX and RX on PA2 and PA3.
+static const uint16_t kUsartPins = GPIO_PIN(2) | GPIO_PIN(3);
+
+static const BootFlash kFlash = {
+    .slots = {BOOT_SLOT_A, BOOT_SLOT_B},
+    .slot_size = BOOT_SLOT_SIZE,
+    .page_size = FLASH_PAGE_SIZE,
+    .erase_page = EraseFlashPage,
+    .program = ProgramFlash,
+};
+
+// The receive DMA keeps filling this while the CPU is stalled on flash erases and writes. The host
+// never has more than a window unacknowledged, plus another one after going back on a NAK while
+// the stale frames are still here, so the DMA never laps the reader.
+#define RX_BUFFER_SIZE (2 * UPDATE_WINDOW * UPDATE_FRAME_SIZE)
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+
+static UpdateReceiver receiver;
+
+// Give up on an update that was requested but never came, and boot the application again.
+#define UPDATE_TIMEOUT_S 30
+
+static void SendResponse(void *context, const void *data, size_t count) {
+    (void)context;
+    WriteUsart(kUsart2, data, count);
+}
+
+// Start the image like a reset would: its vector table, its initial stack pointer, its reset
+// handler. Nothing has been touched yet at this point, so the application finds the MCU in its
+// reset state.
+__attribute__((noreturn)) static void StartImage(uintptr_t vector_table) {
+    const uint32_t *vectors = (const uint32_t *)vector_table;
+    WRITE_REG(SCB_REGS->vtor, vector_table);
+    __asm__ volatile("msr msp, %0\n"
+                     "bx %1" : : "r" (vectors[0]), "r" (vectors[1]) : "memory");
+    while(1);
+}
+
+int main() {
+    bool requested = TakeUpdateRequest();
+    BootSlot slot = FindBootSlot(&kFlash);
+    if (slot != kNumBootSlots && !requested) {
+        StartImage(GetImageStart(&kFlash, slot));
+    }
+
+    // Update mode. Runs at the reset clock (HSI16), which divides evenly into UPDATE_BAUD.
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpioPins(kGpioA, kUsartPins, usart_pin);
+    ConfigureUsart(kUsart2, UPDATE_BAUD);
+    StartUsartReceiveDma(kUsart2, kDmaChannel1, rx_buffer, RX_BUFFER_SIZE);
+    StartUpdateReceiver(&receiver, &kFlash, SendResponse, 0);
+
+    // SysTick wraps once a second.
+    WRITE_REG(SYSTICK_REGS->rvr, HSI16_FREQ_HZ - 1);
+    WRITE_REG(SYSTICK_REGS->cvr, 0);
+    WRITE_REG(SYSTICK_REGS->csr, (SYSTICK_CSR_CLKSOURCE | SYSTICK_CSR_ENABLE));
+
+    uint32_t read = 0;
+    uint32_t idle_seconds = 0;
+    while(1) {
+        uint32_t written = (RX_BUFFER_SIZE - GetDmaRemaining(kDmaChannel1)) % RX_BUFFER_SIZE;
+        if (written != read) {
+            // Up to the write position, or the end of the buffer if it has wrapped.
+            uint32_t end = (written > read) ? written : RX_BUFFER_SIZE;
+            if (ReceiveUpdate(&receiver, &rx_buffer[read], end - read)) {
+                // The response has gone out (WriteUsart() waits for it), so boot the new image.
+                ResetSystem();
+            }
+            read = end % RX_BUFFER_SIZE;
+            idle_seconds = 0;
+        }
+        if (READ_BIT(SYSTICK_REGS->csr, SYSTICK_CSR_COUNTFLAG) &&
+            ++idle_seconds >= UPDATE_TIMEOUT_S && slot != kNumBootSlots) {
+            ResetSystem();
+        }
+    }
+
+    return 0;
+}
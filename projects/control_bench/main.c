@@ -0,0 +1,243 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal/adc.h"
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/rcc.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+#include "lib/bench.h"
+#include "lib/control_loop.h"
+
+// A PI controller on a simulated plant, run by lib/control_loop at 10, 20 and 50 kHz, timer driven
+// and ADC synchronized, for a second each. The latency and execution times are reported as JSON
+// lines over the ST-Link virtual COM port (USART2, 115200 baud), see lib/bench.h, along with each
+// run's overruns and histograms.
+
+// ST-Link virtual COM port, USART2 TX and RX on PA2 and PA3.
+static const uint16_t kUsartPins = GPIO_PIN(2) | GPIO_PIN(3);
+
+// ADC_IN0, sampled once per period when ADC synchronized. Nothing needs to be connected.
+static const uint16_t kAdcPin = GPIO_PIN(0);
+
+// Each run's name, for its {"loop": ...} line and a failed check, and its benchmarks' names.
+typedef struct {
+    uint32_t rate_hz;
+    bool adc_sync;
+    const char *name;
+    const char *latency;
+    const char *execution;
+} Run;
+#define RUN(rate_hz, adc_sync, name) {rate_hz, adc_sync, name, name ".latency", name ".execution"}
+
+static const Run kRuns[] = {
+    RUN(10000, false, "control.timer_10khz"),
+    RUN(20000, false, "control.timer_20khz"),
+    RUN(50000, false, "control.timer_50khz"),
+    RUN(10000, true, "control.adc_10khz"),
+    RUN(20000, true, "control.adc_20khz"),
+    RUN(50000, true, "control.adc_50khz"),
+};
+#define NUM_RUNS (sizeof(kRuns) / sizeof(kRuns[0]))
+
+// The setpoint flips between these every quarter of a run, in plant units.
+#define TARGET 8000
+// How close the plant has to be to the setpoint at the end of a run.
+#define TOLERANCE 32
+// Half the period is the budget, the rest is for the interrupt entry and everything else.
+#define BUDGET_DIVIDER 2
+
+typedef struct {
+    int32_t target;
+} Setpoint;
+
+typedef struct {
+    int32_t target;
+    int32_t output;
+    int32_t drive;
+    uint16_t sample;
+    uint32_t iteration;
+} Telemetry;
+
+typedef struct {
+    int32_t integral;
+    int32_t plant;
+    uint32_t iteration;
+} Controller;
+
+static Setpoint setpoints[2];
+static ControlBuffer setpoint_buffer = CONTROL_BUFFER(setpoints);
+static Telemetry telemetry[2];
+static ControlBuffer telemetry_buffer = CONTROL_BUFFER(telemetry);
+
+static Controller controller;
+static ControlLoop loop;
+static uint16_t adc_samples[2];
+
+static int32_t Clamp(int32_t value, int32_t limit) {
+    return value > limit ? limit : value < -limit ? -limit : value;
+}
+
+HOT_FUNCTION
+static void Step(void *context, const uint16_t *samples, uint32_t count) {
+    Controller *c = context;
+    const Setpoint *setpoint = GetControlBufferToRead(&setpoint_buffer);
+    int32_t error = setpoint->target - c->plant;
+    // The integral keeps 6 more bits than the drive, so small errors still add up.
+    c->integral = Clamp(c->integral + error, INT16_MAX << 6);
+    int32_t drive = Clamp((error >> 1) + (c->integral >> 6), INT16_MAX);
+    // The plant: a first order lag.
+    c->plant += (drive - c->plant) >> 4;
+
+    Telemetry *next = GetControlBufferToWrite(&telemetry_buffer);
+    next->target = setpoint->target;
+    next->output = c->plant;
+    next->drive = drive;
+    next->sample = count ? samples[0] : 0;
+    next->iteration = ++c->iteration;
+    PublishControlBuffer(&telemetry_buffer);
+}
+
+static void WriteBench(const char *text, size_t length) {
+    WriteUsart(kUsart2, text, length);
+}
+
+static void WriteText(const char *text) {
+    size_t length = 0;
+    while (text[length]) {
+        length++;
+    }
+    WriteBench(text, length);
+}
+
+static void WriteNumber(uint32_t value) {
+    char digits[10];
+    size_t i = sizeof(digits);
+    do {
+        digits[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+    WriteBench(&digits[i], sizeof(digits) - i);
+}
+
+static void WriteHistogram(const char *key, const uint32_t *histogram) {
+    WriteText(", \"");
+    WriteText(key);
+    WriteText("\": [");
+    for (uint32_t i = 0; i < CONTROL_HISTOGRAM_BINS; i++) {
+        WriteNumber(histogram[i]);
+        WriteText(i + 1 < CONTROL_HISTOGRAM_BINS ? ", " : "]");
+    }
+}
+
+static void WriteFailedCheck(const Run *run) {
+    WriteText("{\"check\": \"");
+    WriteText(run->name);
+    WriteText("\", \"passed\": false}\n");
+}
+
+static void SetTarget(int32_t target) {
+    Setpoint *next = GetControlBufferToWrite(&setpoint_buffer);
+    next->target = target;
+    PublishControlBuffer(&setpoint_buffer);
+}
+
+// One second at the run's rate, with the setpoint stepping every quarter. Reports the latency and
+// execution time as benchmarks (in cycles), and the rest as a {"loop": ...} line.
+static void RunLoop(const Run *run) {
+    controller = (Controller){0};
+    SetTarget(TARGET);
+    ControlLoopSettings settings = {
+        .timer = kTimer3, .rate_hz = run->rate_hz, .step = Step, .context = &controller,
+        .budget_ticks = GetTimerClockHz() / run->rate_hz / BUDGET_DIVIDER,
+        .latency_shift = 3, .execution_shift = 4,
+        .adc_sync = run->adc_sync,
+        .adc = {
+            .channels = (1 << 0), .resolution = kAdc12Bit, .sample_time = kAdcSample3Cycles5,
+            .clock = kAdcClockPclkDiv2, .dma_channel = kDmaChannel1, .buffer = adc_samples,
+        },
+    };
+    if (!StartControlLoop(&loop, settings)) {
+        WriteFailedCheck(run);
+        return;
+    }
+
+    // The main loop's side: step the setpoint and watch the telemetry.
+    uint32_t iterations = GetControlRateHz(&loop);
+    uint32_t next_step = iterations / 4;
+    // The last step is a quarter before the end, not another one just as the run ends (when the
+    // iterations aren't a multiple of 4, the fourth quarter still comes before them).
+    uint32_t last_step = 3 * (iterations / 4);
+    int32_t target = TARGET;
+    Telemetry latest;
+    do {
+        ReadControlBuffer(&telemetry_buffer, &latest);
+        if (next_step <= last_step && latest.iteration >= next_step) {
+            target = -target;
+            SetTarget(target);
+            next_step += iterations / 4;
+        }
+    } while (latest.iteration < iterations && IsControlLoopRunning(&loop));
+    StopControlLoop(&loop);
+
+    ControlStats stats;
+    GetControlStats(&loop, &stats);
+    uint32_t count = stats.iterations ? stats.iterations : 1;
+    BenchResult latency = {
+        .min = stats.min_latency, .max = stats.max_latency,
+        .mean = (uint32_t)(stats.total_latency / count),
+        .iterations = stats.iterations,
+    };
+    BenchResult execution = {
+        .min = stats.min_execution, .max = stats.max_execution,
+        .mean = (uint32_t)(stats.total_execution / count),
+        .iterations = stats.iterations,
+    };
+    ReportBench(run->latency, latency);
+    ReportBench(run->execution, execution);
+
+    WriteText("{\"loop\": \"");
+    WriteText(run->name);
+    WriteText("\", \"rate_hz\": ");
+    WriteNumber(GetControlRateHz(&loop));
+    WriteText(", \"tick_hz\": ");
+    WriteNumber(GetControlTickHz(&loop));
+    WriteText(", \"overruns\": ");
+    WriteNumber(stats.overruns);
+    WriteText(", \"over_budget\": ");
+    WriteNumber(stats.over_budget);
+    WriteText(", \"jitter\": ");
+    WriteNumber(stats.max_latency - stats.min_latency);
+    WriteHistogram("latency", stats.latency);
+    WriteHistogram("execution", stats.execution);
+    WriteText("}\n");
+
+    // A loop that overran, or didn't get the plant to the setpoint, fails.
+    int32_t error = latest.target - latest.output;
+    if (stats.overruns || error > TOLERANCE || error < -TOLERANCE) {
+        WriteFailedCheck(run);
+    }
+}
+
+int main() {
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpioPins(kGpioA, kUsartPins, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    GpioSettings analog = {.mode = kAnalog, .pupd = kNone};
+    ConfigureGpioPins(kGpioA, kAdcPin, analog);
+
+    StartBench("control_bench", WriteBench);
+    for (uint32_t i = 0; i < NUM_RUNS; i++) {
+        RunLoop(&kRuns[i]);
+    }
+    FinishBench();
+
+    while(1);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/crc.h"
+#include "hal/cycle_counter.h"
+#include "hal/dma.h"
+#include "lib/crc.h"
+
+#define BUFFER_LENGTH 1024
+
+typedef struct {
+    const char *name;
+    uint32_t crc;
+    uint32_t cycles;
+    uint32_t milli_bytes_per_cycle;  // Bytes per 1000 cycles.
+} CrcBenchResult;
+
+enum {
+    kBitwise, kTable, kHardware, kHardwareDma, kNumBenchmarks
+};
+
+// Inspect with a debugger (e.g. `print results` in gdb) once `done` is set. All the CRCs should
+// match, and `mismatches` should be 0.
+volatile CrcBenchResult results[kNumBenchmarks];
+volatile uint32_t mismatches;
+volatile uint32_t done;
+
+static uint8_t buffer[BUFFER_LENGTH] __attribute__((aligned(4)));
+static volatile bool dma_done;
+static volatile uint32_t dma_crc;
+
+// The classic one bit at a time CRC-32, for comparison.
+static uint32_t ComputeBitwiseCrc32(const uint8_t *data, uint32_t count) {
+    uint32_t crc = 0xFFFFFFFF;
+    while (count--) {
+        crc ^= *data++;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+    return ~crc;
+}
+
+static void HandleCrcDone(void *context, uint32_t crc) {
+    (void)context;
+    dma_crc = crc;
+    dma_done = true;
+}
+
+static void Record(uint32_t index, const char *name, uint32_t crc, uint32_t start) {
+    uint32_t cycles = GetCycles() - start;
+    results[index].name = name;
+    results[index].crc = crc;
+    results[index].cycles = cycles;
+    results[index].milli_bytes_per_cycle = (BUFFER_LENGTH * 1000) / cycles;
+    if (crc != results[kBitwise].crc) {
+        mismatches++;
+    }
+}
+
+int main() {
+    StartCycleCounter();
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < BUFFER_LENGTH; i++) {
+        seed = seed * 1664525 + 1013904223;
+        buffer[i] = (uint8_t)(seed >> 24);
+    }
+
+    uint32_t start = GetCycles();
+    uint32_t crc = ComputeBitwiseCrc32(buffer, BUFFER_LENGTH);
+    // Recorded first, every other result is checked against it.
+    results[kBitwise].crc = crc;
+    Record(kBitwise, "bitwise", crc, start);
+
+    start = GetCycles();
+    crc = ComputeTableCrc(&kCrc32Table, buffer, BUFFER_LENGTH);
+    Record(kTable, "table", crc, start);
+
+    ConfigureCrc(CRC32_PARAMETERS);
+    start = GetCycles();
+    crc = ComputeCrc(buffer, BUFFER_LENGTH);
+    Record(kHardware, "hardware", crc, start);
+
+    start = GetCycles();
+    ResetCrc();
+    StartCrcDma(kDmaChannel1, buffer, BUFFER_LENGTH, HandleCrcDone, 0);
+    while (!dma_done);
+    Record(kHardwareDma, "hardware_dma", dma_crc, start);
+
+    done = 1;
+    while(1);
+
+    return 0;
+}
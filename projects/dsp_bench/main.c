@@ -0,0 +1,248 @@
+#include <stdint.h>
+
+#include "lib/dsp.h"
+
+// Builds for the target, or for the host with e.g.
+//
+//     gcc -O2 -I. projects/dsp_bench/main.c lib/dsp.c -o dsp_bench && ./dsp_bench
+//
+// which checks every kernel's output against the reference below and times in nanoseconds instead
+// of cycles.
+#if defined(__arm__)
+#include "hal/cycle_counter.h"
+#else
+#include <stdio.h>
+#include <time.h>
+
+static void StartCycleCounter() {}
+
+static uint32_t GetCycles() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+#endif
+
+// Samples per benchmark run. A power of two, so cycles per sample is just a shift.
+#define BLOCK_LENGTH 256
+#define LOG2_BLOCK_LENGTH 8
+
+typedef struct {
+    const char *name;
+    uint32_t cycles;             // Whole block.
+    uint32_t cycles_per_sample;
+} DspBenchResult;
+
+enum {
+    kFir16, kFir32, kDecimate4, kBiquadQ15, kBiquadQ31, kMovingAverage, kNumBenchmarks
+};
+
+// Inspect with a debugger (e.g. `print results` in gdb) once `done` is set. `mismatches` counts
+// kernels whose output differs from the reference's, and should be 0.
+volatile DspBenchResult results[kNumBenchmarks];
+volatile uint32_t mismatches;
+volatile uint32_t done;
+
+// 32 tap Hamming windowed sinc low pass, cutoff at 1/8 of the sample rate. The 16 tap run uses the
+// first half, which is fine for timing.
+static const q15_t kFirCoeffs[32] = {
+    -21, -60, -84, -52, 78, 273, 387, 221, -301, -974, -1305, -731, 1017, 3642, 6306, 7987,
+    7987, 6306, 3642, 1017, -731, -1305, -974, -301, 221, 387, 273, 78, -52, -84, -60, -21,
+};
+
+// 4th order Butterworth low pass at 1/20 of the sample rate as two biquads, {b0, b1, b2, a1, a2} in
+// Q14 (and Q30 for the Q31 version).
+static const q15_t kBiquadCoeffs[10] = {
+    312, 624, 312, -24243, 9107,
+    359, 717, 359, -27869, 12919,
+};
+static const q31_t kBiquadQ31Coeffs[10] = {
+    20440642, 40881285, 20440642, -1588788093, 596808838,
+    23497607, 46995214, 23497607, -1826396550, 846645154,
+};
+
+static q15_t input[BLOCK_LENGTH];
+static q15_t output[BLOCK_LENGTH];
+static q31_t input_q31[BLOCK_LENGTH];
+static q31_t output_q31[BLOCK_LENGTH];
+static q15_t fir_state[2 * 32];
+static q15_t biquad_state[4 * 2];
+static q31_t biquad_q31_state[4 * 2];
+static q15_t average_history[16];
+static q15_t expected[BLOCK_LENGTH];
+static q31_t expected_q31[BLOCK_LENGTH];
+
+static void Record(uint32_t index, const char *name, uint32_t start) {
+    uint32_t cycles = GetCycles() - start;
+    results[index].name = name;
+    results[index].cycles = cycles;
+    results[index].cycles_per_sample = cycles >> LOG2_BLOCK_LENGTH;
+}
+
+// Straightforward versions of the kernels, for checking: every output from the whole input history
+// with plain 64 bit arithmetic, and none of lib/dsp's delay lines, unrolling or partial products.
+static q15_t ReferenceFir(const q15_t *coeffs, uint32_t num_taps, uint32_t n) {
+    int64_t acc = 0;
+    for (uint32_t k = 0; k < num_taps && k <= n; k++) {
+        acc += (int32_t)coeffs[k] * input[n - k];
+    }
+    return SaturateQ15((int32_t)((acc + (1 << 14)) >> 15));
+}
+
+static void ReferenceBiquadQ15(const q15_t *coeffs, uint32_t num_stages) {
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i++) {
+        expected[i] = input[i];
+    }
+    for (uint32_t stage = 0; stage < num_stages; stage++) {
+        const q15_t *c = coeffs + 5 * stage;
+        int64_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        for (uint32_t i = 0; i < BLOCK_LENGTH; i++) {
+            int64_t x0 = expected[i];
+            int64_t acc = c[0] * x0 + c[1] * x1 + c[2] * x2 - c[3] * y1 - c[4] * y2;
+            int64_t y0 = SaturateQ15((int32_t)((acc + (1 << 13)) >> 14));
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            expected[i] = (q15_t)y0;
+        }
+    }
+}
+
+static q31_t ReferenceMulQ31(q31_t a, q31_t b) {
+    return SaturateQ31(((int64_t)a * b) >> 31);
+}
+
+static void ReferenceBiquadQ31(const q31_t *coeffs, uint32_t num_stages) {
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i++) {
+        expected_q31[i] = input_q31[i];
+    }
+    for (uint32_t stage = 0; stage < num_stages; stage++) {
+        const q31_t *c = coeffs + 5 * stage;
+        q31_t x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        for (uint32_t i = 0; i < BLOCK_LENGTH; i++) {
+            q31_t x0 = expected_q31[i];
+            int64_t acc = (int64_t)ReferenceMulQ31(c[0], x0) + ReferenceMulQ31(c[1], x1) +
+                          ReferenceMulQ31(c[2], x2) - ReferenceMulQ31(c[3], y1) -
+                          ReferenceMulQ31(c[4], y2);
+            q31_t y0 = SaturateQ31(acc * 2);
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = y0;
+            expected_q31[i] = y0;
+        }
+    }
+}
+
+static q15_t ReferenceMovingAverage(uint32_t log2_length, uint32_t n) {
+    int32_t sum = 0;
+    for (uint32_t k = 0; k < (1u << log2_length) && k <= n; k++) {
+        sum += input[n - k];
+    }
+    return (q15_t)(sum >> log2_length);
+}
+
+static void CheckFir(uint32_t num_taps) {
+    for (uint32_t n = 0; n < BLOCK_LENGTH; n++) {
+        if (output[n] != ReferenceFir(kFirCoeffs, num_taps, n)) {
+            mismatches++;
+            return;
+        }
+    }
+}
+
+static void CheckQ15(const q15_t *reference) {
+    for (uint32_t n = 0; n < BLOCK_LENGTH; n++) {
+        if (output[n] != reference[n]) {
+            mismatches++;
+            return;
+        }
+    }
+}
+
+int main() {
+    StartCycleCounter();
+
+    // Deterministic pseudo random input, identical on the host and the target.
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < BLOCK_LENGTH; i++) {
+        seed = seed * 1664525 + 1013904223;
+        input[i] = (q15_t)(seed >> 16);
+        input_q31[i] = (q31_t)seed;
+    }
+
+    FirQ15 fir;
+    InitFirQ15(&fir, kFirCoeffs, fir_state, 16);
+    uint32_t start = GetCycles();
+    RunFirQ15(&fir, input, output, BLOCK_LENGTH);
+    Record(kFir16, "fir_q15_16_taps", start);
+    CheckFir(16);
+
+    InitFirQ15(&fir, kFirCoeffs, fir_state, 32);
+    start = GetCycles();
+    RunFirQ15(&fir, input, output, BLOCK_LENGTH);
+    Record(kFir32, "fir_q15_32_taps", start);
+    CheckFir(32);
+
+    DecimatorQ15 decimator;
+    InitDecimatorQ15(&decimator, kFirCoeffs, fir_state, 32, 4);
+    start = GetCycles();
+    uint32_t decimated = RunDecimatorQ15(&decimator, input, output, BLOCK_LENGTH);
+    Record(kDecimate4, "decimate_q15_32_taps_by_4", start);
+    // Every 4th FIR output, starting from the 4th input.
+    if (decimated != BLOCK_LENGTH / 4) {
+        mismatches++;
+    }
+    for (uint32_t n = 0; n < decimated; n++) {
+        if (output[n] != ReferenceFir(kFirCoeffs, 32, 4 * n + 3)) {
+            mismatches++;
+            break;
+        }
+    }
+
+    BiquadQ15 biquad;
+    InitBiquadQ15(&biquad, kBiquadCoeffs, biquad_state, 2);
+    start = GetCycles();
+    RunBiquadQ15(&biquad, input, output, BLOCK_LENGTH);
+    Record(kBiquadQ15, "biquad_q15_2_stages", start);
+    ReferenceBiquadQ15(kBiquadCoeffs, 2);
+    CheckQ15(expected);
+
+    BiquadQ31 biquad_q31;
+    InitBiquadQ31(&biquad_q31, kBiquadQ31Coeffs, biquad_q31_state, 2);
+    start = GetCycles();
+    RunBiquadQ31(&biquad_q31, input_q31, output_q31, BLOCK_LENGTH);
+    Record(kBiquadQ31, "biquad_q31_2_stages", start);
+    ReferenceBiquadQ31(kBiquadQ31Coeffs, 2);
+    for (uint32_t n = 0; n < BLOCK_LENGTH; n++) {
+        if (output_q31[n] != expected_q31[n]) {
+            mismatches++;
+            break;
+        }
+    }
+
+    MovingAverageQ15 average;
+    InitMovingAverageQ15(&average, average_history, 4);
+    start = GetCycles();
+    RunMovingAverageQ15(&average, input, output, BLOCK_LENGTH);
+    Record(kMovingAverage, "moving_average_q15_16", start);
+    for (uint32_t n = 0; n < BLOCK_LENGTH; n++) {
+        expected[n] = ReferenceMovingAverage(4, n);
+    }
+    CheckQ15(expected);
+
+#if !defined(__arm__)
+    for (uint32_t i = 0; i < kNumBenchmarks; i++) {
+        volatile DspBenchResult *r = &results[i];
+        printf("%-28s %6u ns  %4u ns/sample\n", r->name, r->cycles, r->cycles_per_sample);
+    }
+    printf("mismatches: %u\n", mismatches);
+    return mismatches != 0;
+#else
+    done = 1;
+    while(1);
+
+    return 0;
+#endif
+}
@@ -0,0 +1,320 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/bench.h"
+#include "lib/cobs.h"
+#include "lib/cobs_vectors.h"
+
+// Hot paths of the HAL and libraries, reported as JSON lines over the ST-Link virtual COM port
+// (USART2, 115200 baud), see lib/bench.h. Builds for the host as well, e.g.
+//
+//     gcc -O0 -I. projects/hal_bench/main.c lib/bench.c lib/cobs.c -o hal_bench && ./hal_bench
+//
+// which runs only the portable benchmarks, timed in nanoseconds.
+#if defined(__arm__)
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/macros.h"
+#include "hal/nvic.h"
+#include "hal/spi.h"
+#include "hal/usart.h"
+#include "lib/trace.h"
+#else
+#include <stdio.h>
+#endif
+
+#define COPY_SIZE 256
+
+static uint8_t source[COPY_SIZE] __attribute__((aligned(4)));
+static uint8_t dest[COPY_SIZE] __attribute__((aligned(4)));
+
+static void Copy(void *context) {
+    (void)context;
+    memcpy(dest, source, COPY_SIZE);
+}
+
+static void Set(void *context) {
+    (void)context;
+    memset(dest, 0x5A, COPY_SIZE);
+}
+
+// Not a power of two, and small enough that the long vectors wrap around its end.
+#define COBS_RING_SIZE 600
+
+// Known answers that came out wrong, which makes the COBS timings meaningless. Should be 0.
+volatile uint32_t cobs_mismatches;
+
+static uint8_t cobs_ring[COBS_RING_SIZE];
+static uint8_t cobs_payload[COPY_SIZE];
+static uint8_t cobs_encoded[COBS_MAX_ENCODED_SIZE(COPY_SIZE)];
+static uint32_t cobs_encoded_length;
+
+// Every vector, encoded and decoded across the end of the ring.
+static void CheckCobs() {
+    for (uint32_t v = 0; v < COBS_NUM_VECTORS; v++) {
+        const CobsVector *vector = &kCobsVectors[v];
+        uint32_t start = COBS_RING_SIZE - 8;
+        CobsEncoder encoder;
+        StartCobsEncoder(&encoder, cobs_ring, COBS_RING_SIZE, start);
+        BeginCobsFrame(&encoder);
+        EncodeCobs(&encoder, vector->payload, vector->payload_length);
+        uint32_t end = EndCobsFrame(&encoder);
+        for (uint32_t i = 0; i < vector->encoded_length; i++) {
+            if (cobs_ring[(start + i) % COBS_RING_SIZE] != vector->encoded[i]) {
+                cobs_mismatches++;
+                break;
+            }
+        }
+
+        CobsDecoder decoder;
+        CobsFrame frame;
+        StartCobsDecoder(&decoder, cobs_ring, COBS_RING_SIZE, start, COPY_SIZE);
+        if (!DecodeCobs(&decoder, end, &frame) ||
+            frame.length[0] + frame.length[1] != vector->payload_length ||
+            memcmp(frame.data[0], vector->payload, frame.length[0]) ||
+            memcmp(frame.data[1], vector->payload + frame.length[0], frame.length[1])) {
+            cobs_mismatches++;
+        }
+    }
+}
+
+// A 256 byte message with a zero every 8 bytes, like a telemetry record full of small numbers.
+static void EncodeCobsMessage(void *context) {
+    (void)context;
+    CobsEncoder encoder;
+    StartCobsEncoder(&encoder, cobs_ring, COBS_RING_SIZE, 0);
+    BeginCobsFrame(&encoder);
+    EncodeCobs(&encoder, cobs_payload, COPY_SIZE);
+    cobs_encoded_length = EndCobsFrame(&encoder);
+}
+
+// A time measured with GetBenchTime(), less the overhead RunBench() takes off its own.
+static void AddTimedSample(BenchResult *result, uint32_t time) {
+    uint32_t overhead = GetBenchOverhead();
+    AddBenchSample(result, time > overhead ? time - overhead : 0);
+}
+
+// Decoding works in place, so every call gets a fresh copy of the message, which isn't timed.
+static void BenchCobs(BenchWriter writer) {
+    CheckCobs();
+    if (cobs_mismatches) {
+        static const char kFailed[] = "{\"check\": \"cobs.vectors\", \"passed\": false}\n";
+        writer(kFailed, sizeof(kFailed) - 1);
+    }
+
+    for (uint32_t i = 0; i < COPY_SIZE; i++) {
+        cobs_payload[i] = (i % 8) ? (uint8_t)i : 0;
+    }
+    RunBench("cobs.encode_256", EncodeCobsMessage, 0);
+    memcpy(cobs_encoded, cobs_ring, cobs_encoded_length);
+
+    BenchResult result = {0};
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        memcpy(cobs_ring, cobs_encoded, cobs_encoded_length);
+        CobsDecoder decoder;
+        CobsFrame frame;
+        StartCobsDecoder(&decoder, cobs_ring, COBS_RING_SIZE, 0, COPY_SIZE);
+        uint32_t start = GetBenchTime();
+        DecodeCobs(&decoder, cobs_encoded_length, &frame);
+        AddTimedSample(&result, GetBenchTime() - start);
+    }
+    ReportBench("cobs.decode_256", result);
+}
+
+#if defined(__arm__)
+
+// ST-Link virtual COM port, USART2 TX and RX on PA2 and PA3. SPI1 SCK, MISO and MOSI on PA5 to PA7.
+static const uint16_t kUsartPins = GPIO_PIN(2) | GPIO_PIN(3);
+static const uint16_t kSpiPins = GPIO_PIN(5) | GPIO_PIN(6) | GPIO_PIN(7);
+static const Gpio kLed = {.port = kGpioC, .pin = 6};
+static const Gpio kSpiChipSelect = {.port = kGpioA, .pin = 4};
+
+// Nothing else uses EXTI0/1, so it's free to be pended from software for the latency tests.
+static const Irq kBenchIrq = kIrqExti0To1;
+
+static volatile uint32_t irq_cycles;
+static volatile bool irq_done;
+static volatile bool dma_done;
+static volatile bool spi_done;
+// DMA transfers that ended in an error, which makes their timings meaningless. Should be 0.
+static volatile uint32_t dma_errors;
+
+static void WriteBench(const char *text, size_t length) {
+    WriteUsart(kUsart2, text, length);
+}
+
+void Exti0To1Handler() {
+    irq_cycles = GetBenchTime();
+    irq_done = true;
+}
+
+static void ToggleWithSetGpio(void *context) {
+    (void)context;
+    static bool state;
+    state = !state;
+    SetGpio(kLed, state);
+}
+
+// What SetGpio() boils down to, without the call and the branch.
+static void ToggleWithBsrr(void *context) {
+    (void)context;
+    static uint32_t mask = 1 << 6;
+    mask ^= (1 << 6) | (1 << 22);
+    WRITE_REG(GPIO_REGS(kGpioC)->bsrr, mask);
+}
+
+// From pending the interrupt to it returning to thread mode.
+static void PendAndWait(void *context) {
+    (void)context;
+    irq_done = false;
+    SetIrqPending(kBenchIrq);
+    while (!irq_done);
+}
+
+static void Critical(void *context) {
+    (void)context;
+    uint32_t primask = EnterCritical();
+    ExitCritical(primask);
+}
+
+static void MaskPriority(void *context) {
+    (void)context;
+    uint32_t masked = MaskIrqPriority(kIrqPriorityLow);
+    UnmaskIrqPriority(masked);
+}
+
+static void Trace(void *context) {
+    (void)context;
+    RecordTrace(kTraceInstant, 0, 0);
+}
+
+// Blocking, so mostly the time the byte takes on the wire. Spaces keep the JSON output valid.
+static void WriteByte(void *context) {
+    (void)context;
+    WriteUsart(kUsart2, " ", 1);
+}
+
+static void HandleDmaDone(void *context, bool ok) {
+    (void)context;
+    dma_errors += !ok;
+    dma_done = true;
+}
+
+// From pending the interrupt to the first instruction of the handler.
+static void BenchIrqEntry() {
+    BenchResult result = {0};
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        irq_done = false;
+        uint32_t start = GetBenchTime();
+        SetIrqPending(kBenchIrq);
+        while (!irq_done);
+        AddTimedSample(&result, irq_cycles - start);
+    }
+    ReportBench("irq.entry", result);
+}
+
+// The CPU's share of a DMA transmission, i.e. the cost of starting it.
+static void BenchUsartDma() {
+    static const char kSpaces[16] = "                ";
+    BenchResult result = {0};
+    for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+        dma_done = false;
+        uint32_t start = GetBenchTime();
+        StartUsartDma(kUsart2, kDmaChannel1, kSpaces, sizeof(kSpaces), HandleDmaDone, 0);
+        AddTimedSample(&result, GetBenchTime() - start);
+        while (!dma_done);
+    }
+    ReportBench("usart.start_dma_16", result);
+    if (dma_errors) {
+        static const char kFailed[] = "{\"check\": \"usart.dma\", \"passed\": false}\n";
+        WriteBench(kFailed, sizeof(kFailed) - 1);
+    }
+}
+
+static void HandleSpiDone(void *context, bool ok) {
+    (void)context;
+    dma_errors += !ok;
+    spi_done = true;
+}
+
+// A whole DMA transaction, chip select to chip select, at the fastest SCK PCLK allows. Nothing
+// needs to be connected.
+static void SpiDma(void *context) {
+    (void)context;
+    static const SpiTransaction kTransaction = {
+        .chip_select = kSpiChipSelect, .tx = source, .rx = dest, .count = COPY_SIZE,
+        .callback = HandleSpiDone,
+    };
+    spi_done = false;
+    QueueSpiTransaction(kSpi1, &kTransaction);
+    while (!spi_done);
+}
+
+static void BenchSpiDma() {
+    dma_errors = 0;
+    BenchSpiDma();
+    if (dma_errors) {
+        static const char kFailed[] = "{\"check\": \"spi.dma\", \"passed\": false}\n";
+        WriteBench(kFailed, sizeof(kFailed) - 1);
+    }
+}
+
+int main() {
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpioPins(kGpioA, kUsartPins, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    GpioSettings led_settings = {.mode = kOutput, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 0};
+    ConfigureGpio(kLed, led_settings);
+    SetGpio(kSpiChipSelect, true);
+    ConfigureGpio(kSpiChipSelect, led_settings);
+    GpioSettings spi_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kVeryHigh, .pupd = kNone, .afsel = 0,
+    };
+    ConfigureGpioPins(kGpioA, kSpiPins, spi_pin);
+    SpiSettings spi_settings = {
+        .max_hz = 32000000, .mode = kSpiMode0, .rx_channel = kDmaChannel2, .tx_channel = kDmaChannel3,
+    };
+    ConfigureSpi(kSpi1, spi_settings);
+    EnableIrq(kBenchIrq);
+
+    StartBench("hal_bench", WriteBench);
+    StartTrace();
+    RunBench("gpio.set_gpio", ToggleWithSetGpio, 0);
+    RunBench("gpio.bsrr", ToggleWithBsrr, 0);
+    BenchIrqEntry();
+    RunBench("irq.round_trip", PendAndWait, 0);
+    RunBench("nvic.critical", Critical, 0);
+    RunBench("nvic.mask_priority", MaskPriority, 0);
+    RunBench("mem.memcpy_256", Copy, 0);
+    RunBench("mem.memset_256", Set, 0);
+    RunBench("trace.record", Trace, 0);
+    RunBench("usart.write_byte", WriteByte, 0);
+    BenchUsartDma();
+    BenchSpiDma();
+    BenchCobs(WriteBench);
+    FinishBench();
+
+    while(1);
+
+    return 0;
+}
+
+#else
+
+static void WriteBench(const char *text, size_t length) {
+    fwrite(text, 1, length, stdout);
+}
+
+int main() {
+    StartBench("hal_bench", WriteBench);
+    RunBench("mem.memcpy_256", Copy, 0);
+    RunBench("mem.memset_256", Set, 0);
+    BenchCobs(WriteBench);
+    FinishBench();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdint.h>
+
+#include "hal/cycle_counter.h"
+#include "hal/dma.h"
+#include "hal/flash.h"
+#include "hal/gpio.h"
+#include "hal/rcc.h"
+#include "hal/usart.h"
+#include "lib/kvstore.h"
+#include "lib/log.h"
+
+// ST-Link virtual COM port.
+static const Gpio kUsartTx = {.port = kGpioA, .pin = 2};
+static const Gpio kUsartRx = {.port = kGpioA, .pin = 3};
+
+typedef enum {
+    kBootCountKey,
+    kLastUptimeKey,
+} SettingKey;
+
+static KvStore settings;
+
+int main() {
+    StartCycleCounter();
+
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpio(kUsartTx, usart_pin);
+    ConfigureGpio(kUsartRx, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    StartLog(kUsart2, kDmaChannel1);
+
+    uint32_t start = GetCycles();
+    bool mounted = MountKvStore(&settings, (KvStoreConfig){
+        .start = (uintptr_t)storage_start, .page_size = FLASH_PAGE_SIZE,
+        .num_pages = (storage_end - storage_start) / FLASH_PAGE_SIZE,
+        .erase_page = EraseFlashPage, .program = ProgramFlash,
+    });
+    LOG("mounted %u in %u cycles", mounted, GetCycles() - start);
+
+    const uint32_t *stored = GetKvValue(&settings, kBootCountKey, 0);
+    uint32_t boots = (stored ? *stored : 0) + 1;
+    const uint32_t *uptime = GetKvValue(&settings, kLastUptimeKey, 0);
+    LOG("boot %u, up for %u s last time", boots, uptime ? *uptime : 0);
+    start = GetCycles();
+    bool written = SetKvValue(&settings, kBootCountKey, &boots, sizeof(boots));
+    LOG("boot count written %u in %u cycles", written, GetCycles() - start);
+
+    // Record the uptime every 10 s, so reset the board at any point and see it carry over. At 16
+    // bytes a record, that's a page erase every ~21 minutes, taking turns over the region's 4 pages.
+    uint32_t seconds = 0;
+    uint32_t last_second = GetCycles();
+    while(1) {
+        ServiceLog();
+        if (GetCycles() - last_second >= GetTimerClockHz()) {
+            last_second += GetTimerClockHz();
+            if (++seconds % 10 == 0) {
+                SetKvValue(&settings, kLastUptimeKey, &seconds, sizeof(seconds));
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "hal/cycle_counter.h"
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/rcc.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+#include "lib/log.h"
+
+// ST-Link virtual COM port.
+static const Gpio kUsartTx = {.port = kGpioA, .pin = 2};
+static const Gpio kUsartRx = {.port = kGpioA, .pin = 3};
+
+static const TimerTiming kTickTiming = TIMER_TIMING(kTimer3, HSI16_FREQ_HZ, 10);
+_Static_assert(TIMER_TIMING_VALID(kTimer3, HSI16_FREQ_HZ, 10), "10 Hz is out of TIM3's range");
+
+static const char kName[] = "log_demo";
+
+static volatile uint32_t ticks;
+
+// Logs from the timer interrupt, and reports what the previous LOG() cost.
+static void HandleTick(void *context, uint32_t events) {
+    (void)context;
+    (void)events;
+    static uint32_t last_cycles;
+    uint32_t start = GetCycles();
+    LOG("tick %u, last LOG() took %u cycles", ticks++, last_cycles);
+    last_cycles = GetCycles() - start;
+}
+
+int main() {
+    StartCycleCounter();
+
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpio(kUsartTx, usart_pin);
+    ConfigureGpio(kUsartRx, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    StartLog(kUsart2, kDmaChannel1);
+    LOG("%s started, sysclk %u Hz", kName, GetSysclkHz());
+
+    ConfigureTimer(kTimer3, kTickTiming);
+    EnableTimerInterrupts(kTimer3, kTimerUpdateEvent, HandleTick, 0);
+    StartTimer(kTimer3);
+
+    while(1) {
+        ServiceLog();
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal/dma.h"
+#include "hal/gpio.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+#include "lib/logic_analyzer.h"
+
+// ST-Link virtual COM port, USART2 TX and RX on PA2 and PA3.
+static const uint16_t kUsartPins = GPIO_PIN(2) | GPIO_PIN(3);
+
+// A bit-banged SPI-ish transfer to look at: chip select, clock and data.
+static const Gpio kChipSelect = {.port = kGpioA, .pin = 0};
+static const Gpio kClock = {.port = kGpioA, .pin = 1};
+static const Gpio kData = {.port = kGpioA, .pin = 4};
+static const uint16_t kBusPins = GPIO_PIN(0) | GPIO_PIN(1) | GPIO_PIN(4);
+
+#define SAMPLES 2048
+
+static uint16_t samples[SAMPLES];
+static LogicAnalyzer analyzer;
+
+static void SendByte(uint8_t byte) {
+    SetGpio(kChipSelect, false);
+    for (int bit = 7; bit >= 0; bit--) {
+        SetGpio(kData, (byte >> bit) & 1);
+        SetGpio(kClock, true);
+        SetGpio(kClock, false);
+    }
+    SetGpio(kChipSelect, true);
+}
+
+int main() {
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpioPins(kGpioA, kUsartPins, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    GpioSettings output = {.mode = kOutput, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone};
+    SetGpio(kChipSelect, true);
+    ConfigureGpioPins(kGpioA, kBusPins, output);
+
+    // Port A at 1 MHz. Sampling stops a little under half the buffer after chip select first goes
+    // low, so the capture starts with what came before.
+    LogicAnalyzerSettings settings = {
+        .port = kGpioA, .timer = kTimer16, .sample_hz = 1000000, .dma = kDmaChannel1,
+        .buffer = samples, .length = SAMPLES,
+        .trigger_mask = GPIO_PIN(kChipSelect.pin), .trigger_value = 0,
+        .post_trigger = SAMPLES / 2 - 64,
+    };
+
+    uint8_t count = 0;
+    while (1) {
+        // Any byte from the host asks for a capture.
+        uint8_t byte;
+        if (!ReadUsart(kUsart2, &byte)) {
+            continue;
+        }
+        StartLogicCapture(&analyzer, settings);
+        while (!IsLogicCaptureDone(&analyzer)) {
+            SendByte(count++);
+        }
+        DumpLogicCapture(&analyzer, kUsart2);
+    }
+
+    return 0;
+}
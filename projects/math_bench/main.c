@@ -0,0 +1,133 @@
+#include <stdint.h>
+
+#include "hal/cycle_counter.h"
+#include "lib/fast_math.h"
+
+// Operations per benchmark run. A power of two, so cycles per operation is just a shift.
+#define RUN_LENGTH 256
+#define LOG2_RUN_LENGTH 8
+
+typedef struct {
+    const char *name;
+    uint32_t cycles;             // Whole run.
+    uint32_t cycles_per_op;
+} MathBenchResult;
+
+enum {
+    kLibgccDivide, kLibgccDivide16, kLibgccModulo, kDivide, kDivide16, kModulo, kSqrt, kLog2, kSin,
+    kNumBenchmarks
+};
+
+// Inspect with a debugger (e.g. `print results` in gdb) once `done` is set. `mismatches` counts
+// Divide()/Modulo() results that differ from libgcc's, and should be 0.
+volatile MathBenchResult results[kNumBenchmarks];
+volatile uint32_t mismatches;
+volatile uint32_t done;
+
+// Volatile so the compiler can't see the divisor and has to call __aeabi_uidiv like it would for
+// any runtime value (and, on the M0+, for constants too).
+static volatile uint32_t divisor = 115200;
+
+static uint32_t numerators[RUN_LENGTH];
+static uint32_t expected[RUN_LENGTH];
+static uint32_t quotients[RUN_LENGTH];
+// Sink for results that aren't checked, so the loops aren't optimized away.
+static volatile uint32_t sink;
+
+static void Record(uint32_t index, const char *name, uint32_t start) {
+    uint32_t cycles = GetCycles() - start;
+    results[index].name = name;
+    results[index].cycles = cycles;
+    results[index].cycles_per_op = cycles >> LOG2_RUN_LENGTH;
+}
+
+static void Check() {
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        if (quotients[i] != expected[i]) {
+            mismatches++;
+        }
+    }
+}
+
+int main() {
+    StartCycleCounter();
+
+    // Deterministic pseudo random numerators over the full 32 bit range.
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        seed = seed * 1664525 + 1013904223;
+        numerators[i] = seed;
+    }
+    uint32_t d = divisor;
+    Divider divider;
+    InitDivider(&divider, d);
+
+    uint32_t start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        expected[i] = numerators[i] / d;
+    }
+    Record(kLibgccDivide, "libgcc_divide", start);
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        quotients[i] = Divide(numerators[i], &divider);
+    }
+    Record(kDivide, "divide", start);
+    Check();
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        expected[i] = numerators[i] % d;
+    }
+    Record(kLibgccModulo, "libgcc_modulo", start);
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        quotients[i] = Modulo(numerators[i], &divider);
+    }
+    Record(kModulo, "modulo", start);
+    Check();
+
+    // 16 bit numerators and a small divisor, e.g. ring buffer indices.
+    d = divisor / 1000;
+    InitDivider(&divider, d);
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        numerators[i] &= 0xFFFF;
+    }
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        expected[i] = numerators[i] / d;
+    }
+    Record(kLibgccDivide16, "libgcc_divide_16_bit", start);
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        quotients[i] = Divide16(numerators[i], &divider);
+    }
+    Record(kDivide16, "divide_16_bit", start);
+    Check();
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        sink = SqrtU32(numerators[i] * numerators[i]);
+    }
+    Record(kSqrt, "sqrt", start);
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        sink = Log2U32(numerators[i] << (i & 15));
+    }
+    Record(kLog2, "log2", start);
+
+    start = GetCycles();
+    for (uint32_t i = 0; i < RUN_LENGTH; i++) {
+        sink = SinQ15(numerators[i]);
+    }
+    Record(kSin, "sin", start);
+
+    done = 1;
+    while(1);
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/mem.h"
+
+// Builds for the target, or for the host with e.g.
+//
+//     gcc -O2 -I. projects/mem_bench/main.c lib/mem.c -o mem_bench && ./mem_bench
+//
+// which checks the results against the host's libc and times in nanoseconds instead of cycles.
+#if defined(__arm__)
+#include "hal/cycle_counter.h"
+#else
+#include <stdio.h>
+#include <time.h>
+
+static void StartCycleCounter() {}
+
+static uint32_t GetCycles() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000000000ull + now.tv_nsec);
+}
+#endif
+
+// Calls per measurement, averaged. A power of two, so the average is just a shift.
+#define REPEAT 16
+#define LOG2_REPEAT 4
+#define MAX_SIZE 1024
+
+// Average cycles per call for each buffer size. "unaligned" copies from a source one byte past
+// word alignment into an aligned destination. "move" shifts a buffer up by 4 bytes in place.
+typedef struct {
+    uint32_t size;
+    uint32_t libc_copy, copy;
+    uint32_t libc_copy_unaligned, copy_unaligned;
+    uint32_t libc_set, set;
+    uint32_t libc_move, move;
+} MemBenchResult;
+
+static const uint32_t kSizes[] = {4, 16, 64, 256, MAX_SIZE};
+#define NUM_SIZES (sizeof(kSizes) / sizeof(kSizes[0]))
+
+// Inspect with a debugger (e.g. `print results` in gdb) once `done` is set. `mismatches` counts
+// results that differ from libc's, and should be 0.
+volatile MemBenchResult results[NUM_SIZES];
+volatile uint32_t mismatches;
+volatile uint32_t done;
+
+static uint8_t source[MAX_SIZE + 8] __attribute__((aligned(4)));
+static uint8_t expected[MAX_SIZE + 8] __attribute__((aligned(4)));
+static uint8_t dest[MAX_SIZE + 8] __attribute__((aligned(4)));
+
+typedef void *(*CopyFunction)(void *dest, const void *src, size_t count);
+typedef void *(*SetFunction)(void *dest, int value, size_t count);
+
+static uint32_t TimeCopy(CopyFunction copy, uint8_t *to, const uint8_t *from, uint32_t size) {
+    uint32_t start = GetCycles();
+    for (uint32_t i = 0; i < REPEAT; i++) {
+        copy(to, from, size);
+    }
+    return (GetCycles() - start) >> LOG2_REPEAT;
+}
+
+static uint32_t TimeSet(SetFunction set, uint8_t *to, uint32_t size) {
+    uint32_t start = GetCycles();
+    for (uint32_t i = 0; i < REPEAT; i++) {
+        set(to, 0x5A, size);
+    }
+    return (GetCycles() - start) >> LOG2_REPEAT;
+}
+
+static void Check(uint32_t size) {
+    if (memcmp(dest, expected, size + 8) != 0) {
+        mismatches++;
+    }
+}
+
+int main() {
+    StartCycleCounter();
+    for (uint32_t i = 0; i < sizeof(source); i++) {
+        source[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    for (uint32_t n = 0; n < NUM_SIZES; n++) {
+        uint32_t size = kSizes[n];
+        volatile MemBenchResult *result = &results[n];
+        result->size = size;
+
+        memset(expected, 0, sizeof(expected));
+        memset(dest, 0, sizeof(dest));
+        result->libc_copy = TimeCopy(memcpy, expected, source, size);
+        result->copy = TimeCopy(CopyMemory, dest, source, size);
+        Check(size);
+
+        result->libc_copy_unaligned = TimeCopy(memcpy, expected, source + 1, size);
+        result->copy_unaligned = TimeCopy(CopyMemory, dest, source + 1, size);
+        Check(size);
+
+        memset(expected, 0, sizeof(expected));
+        memset(dest, 0, sizeof(dest));
+        result->libc_set = TimeSet(memset, expected, size);
+        result->set = TimeSet(SetMemory, dest, size);
+        Check(size);
+
+        // Each call moves the same bytes up again, so both end up with identical contents.
+        memcpy(expected, source, sizeof(source));
+        memcpy(dest, source, sizeof(source));
+        result->libc_move = TimeCopy(memmove, expected + 4, expected, size);
+        result->move = TimeCopy(MoveMemory, dest + 4, dest, size);
+        Check(size);
+    }
+
+#if !defined(__arm__)
+    printf("size  libc_copy  copy  libc_unaligned  unaligned  libc_set  set  libc_move  move (ns)\n");
+    for (uint32_t n = 0; n < NUM_SIZES; n++) {
+        volatile MemBenchResult *r = &results[n];
+        printf("%4u  %9u  %4u  %14u  %9u  %8u  %3u  %9u  %4u\n", r->size, r->libc_copy, r->copy,
+               r->libc_copy_unaligned, r->copy_unaligned, r->libc_set, r->set, r->libc_move,
+               r->move);
+    }
+    printf("mismatches: %u\n", mismatches);
+    return mismatches != 0;
+#else
+    done = 1;
+    while(1);
+
+    return 0;
+#endif
+}
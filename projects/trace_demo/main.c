@@ -0,0 +1,114 @@
+#include <stdint.h>
+
+#include "hal/gpio.h"
+#include "hal/nvic.h"
+#include "hal/rcc.h"
+#include "hal/timer.h"
+#include "hal/usart.h"
+#include "lib/coroutine.h"
+#include "lib/trace.h"
+
+// SysTick isn't part of the HAL, so its handler below traces itself.
+typedef struct {
+    volatile uint32_t csr, rvr, cvr, calib;
+} SysTickRegisters;
+#define SYSTICK_REGS ((SysTickRegisters *)0xE000E010)
+
+// ST-Link virtual COM port.
+static const Gpio kUsartTx = {.port = kGpioA, .pin = 2};
+static const Gpio kUsartRx = {.port = kGpioA, .pin = 3};
+static const Gpio kLed = {.port = kGpioC, .pin = 6};
+
+// A 1 kHz "control loop" whose run time varies, to have some jitter to look at.
+static const TimerTiming kControlTiming = TIMER_TIMING(kTimer3, HSI16_FREQ_HZ, 1000);
+_Static_assert(TIMER_TIMING_VALID(kTimer3, HSI16_FREQ_HZ, 1000), "1 kHz is out of TIM3's range");
+
+static volatile uint32_t systick;
+
+void SysTickHandler() {
+    TRACE_ISR_ENTER();
+    systick++;
+    TRACE_ISR_EXIT();
+}
+
+static void Spin(uint32_t iterations) {
+    for (volatile uint32_t i = 0; i < iterations; i++);
+}
+
+static void HandleControl(void *context, uint32_t events) {
+    (void)context;
+    (void)events;
+    static uint32_t count;
+    count++;
+    Spin(20 + (count % 8) * 10);
+    if (count % 100 == 0) {
+        TRACE_INSTANT("control", count / 100);
+    }
+}
+
+static Coroutine blink_co;
+static uint32_t blink_deadline;
+
+static CoStatus Blink(Coroutine *co) {
+    CO_BEGIN(co);
+    while (1) {
+        SetGpio(kLed, !GetGpio(kLed));
+        blink_deadline = systick + 250;
+        CO_WAIT_UNTIL(co, CO_DEADLINE_REACHED(systick, blink_deadline));
+    }
+    CO_END(co);
+}
+
+static Coroutine filter_co;
+
+static CoStatus Filter(Coroutine *co) {
+    CO_BEGIN(co);
+    while (1) {
+        TRACE_BEGIN("filter block");
+        Spin(500);
+        TRACE_END("filter block");
+        CO_YIELD(co);
+    }
+    CO_END(co);
+}
+
+int main() {
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpio(kUsartTx, usart_pin);
+    ConfigureGpio(kUsartRx, usart_pin);
+    ConfigureUsart(kUsart2, 115200);
+    GpioSettings led_settings = {.mode = kOutput, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 0};
+    ConfigureGpio(kLed, led_settings);
+
+    StartTrace();
+
+    // The control loop preempts everything else, SysTick can wait a few microseconds.
+    SetIrqPriority(kIrqTim3, kIrqPriorityHighest);
+    SetSystemPriority(kSysTick, kIrqPriorityLow);
+
+    // 1 ms ticks, clocked by HCLK.
+    SYSTICK_REGS->rvr = GetHclkHz() / 1000 - 1;
+    SYSTICK_REGS->cvr = 0;
+    SYSTICK_REGS->csr = 0b111;
+
+    ConfigureTimer(kTimer3, kControlTiming);
+    EnableTimerInterrupts(kTimer3, kTimerUpdateEvent, HandleControl, 0);
+    StartTimer(kTimer3);
+
+    while(1) {
+        TRACE_TASK("blink");
+        Blink(&blink_co);
+        TRACE_TASK("filter");
+        Filter(&filter_co);
+        // Any byte from the host asks for a dump.
+        uint8_t byte;
+        if (ReadUsart(kUsart2, &byte)) {
+            TRACE_TASK("dump");
+            DumpTrace(kUsart2);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#include "hal/gpio.h"
+#include "hal/usart.h"
+#include "lib/boot.h"
+
+// An application for the bootloader's slots. It blinks, and hands over to the bootloader as soon as
+// tools/uploader.py starts talking. Change BLINK_DELAY_ITERATIONS (or anything else) and upload
+// again to see the update land.
+#ifndef BLINK_DELAY_ITERATIONS
+#define BLINK_DELAY_ITERATIONS 500000
+#endif
+
+// ST-Link virtual COM port.
+static const Gpio kUsartTx = {.port = kGpioA, .pin = 2};
+static const Gpio kUsartRx = {.port = kGpioA, .pin = 3};
+static const Gpio kLed = {.port = kGpioC, .pin = 6};
+
+int main() {
+    GpioSettings led_settings = {
+        .mode = kOutput, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 0,
+    };
+    ConfigureGpio(kLed, led_settings);
+    GpioSettings usart_pin = {
+        .mode = kAlternateFunction, .otype = kPushPull, .ospeed = kHigh, .pupd = kNone, .afsel = 1,
+    };
+    ConfigureGpio(kUsartTx, usart_pin);
+    ConfigureGpio(kUsartRx, usart_pin);
+    ConfigureUsart(kUsart2, UPDATE_BAUD);
+
+    uint32_t iterations = 0;
+    while(1) {
+        uint8_t byte;
+        if (ReadUsart(kUsart2, &byte) && byte == UPDATE_SYNC) {
+            RequestUpdate();
+        }
+        if (++iterations == BLINK_DELAY_ITERATIONS) {
+            iterations = 0;
+            SetGpio(kLed, !GetGpio(kLed));
+        }
+    }
+
+    return 0;
+}
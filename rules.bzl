@@ -1,19 +1,44 @@
 _ARCH_FLAGS = ["-mcpu=cortex-m0plus", "-mthumb"]
 
-_C_FLAGS = ["-Wall", "-Wextra", "-g", "-O0", "-I."]
+_C_FLAGS = ["-Wall", "-Wextra", "-g", "-I."]
+
+# Optimization per compilation mode (bazel build -c opt). The default, fastbuild, and dbg build
+# without optimizations, which keeps the code easy to follow in a debugger. tutorials/rules.mk has
+# the same profiles.
+_MODE_FLAGS = {
+    "fastbuild": ["-O0"],
+    "dbg": ["-O0"],
+    "opt": ["-Os"],
+}
+
+# Debug info and __FILE__ otherwise hold the absolute path of the execroot or sandbox the action
+# ran in, which differs from machine to machine and build to build, so identical sources would
+# make different objects and nothing downstream would hit the cache.
+_REPRODUCIBLE_FLAGS = ['-ffile-prefix-map="$PWD"=.']
+
+# Every header a target could include is an input of its compile actions, but the .d file gcc
+# writes (-MMD) says which ones the source actually included. This turns it into the list of the
+# others, for the action's unused_inputs_list: Bazel doesn't count them when it checks whether the
+# action is up to date, so editing one of them doesn't recompile the source. {hdrs} lists all of
+# the candidates, one per line.
+_UNUSED_HDRS_CMD = r"""sed -e 's/\\$//' -e 's/^[^:]*://' {dep} | tr ' ' '\n' | \
+    sed -e 's|^\./||' -e '/^$/d' | LC_ALL=C sort -u | \
+    LC_ALL=C comm -23 <(LC_ALL=C sort -u {hdrs}) - > {unused}"""
 
 _LD_FLAGS = [
     "-nostartfiles",
     "-nostdlib",
     "--specs=nano.specs",
     "--specs=nosys.specs",
-    "-lc",
-    "-lgcc",
     "-Wl,--gc-sections",
     "-Wl,--print-memory-usage",
     "-L.",
 ]
 
+# Libraries go after all of the archives, so they only provide what the archives still need. That
+# also lets an archive replace a libc function (see //lib:mem).
+_LD_LIBS = ["-lc", "-lgcc"]
+
 Stm32g0xxLibraryInfo = provider(
     fields=[
         "hdrs",
@@ -21,6 +46,13 @@ Stm32g0xxLibraryInfo = provider(
     ]
 )
 
+Stm32g0xxBinaryInfo = provider(
+    fields=[
+        "elf",
+        "bin",
+    ]
+)
+
 
 def _stm32g0xx_impl(ctx):
     # Gather transitive files from dependencies.
@@ -38,38 +70,60 @@ def _stm32g0xx_impl(ctx):
     objs = []
     archives = []
 
-    # Now compile the srcs to objs.
+    # All of the headers this target's sources could include, one path per line, for
+    # _UNUSED_HDRS_CMD.
+    hdrs_list = ctx.actions.declare_file("_objs/{}/hdrs.txt".format(ctx.label.name))
+    hdrs_args = ctx.actions.args()
+    hdrs_args.add_all(hdrs_depset)
+    ctx.actions.write(output=hdrs_list, content=hdrs_args)
+
+    # Now compile the srcs to objs. Objects go in a directory per target, so several targets in one
+    # package can build the same source (with different defines, say).
+    defines = ["-D{}".format(define) for define in ctx.attr.defines]
+    mode_flags = _MODE_FLAGS[ctx.var["COMPILATION_MODE"]]
     for src in ctx.files.srcs:
-        obj = ctx.actions.declare_file("{}.o".format(src.basename))
+        obj = ctx.actions.declare_file("_objs/{}/{}.o".format(ctx.label.name, src.basename))
         objs.append(obj)
         if src.extension == "s":
+            # Assembled without the preprocessor, so no headers.
             cmd = "arm-none-eabi-gcc {flags} -c {src} -o {obj}".format(
-                flags=" ".join(_ARCH_FLAGS),
+                flags=" ".join(_ARCH_FLAGS + _REPRODUCIBLE_FLAGS),
                 src=src.path,
                 obj=obj.path,
             )
             ctx.actions.run_shell(
                 command=cmd,
-                inputs=depset(direct=[src], transitive=[hdrs_depset]),
+                inputs=[src],
                 outputs=[obj],
                 use_default_shell_env=True,
             )
         elif src.extension == "c":
-            cmd = "arm-none-eabi-gcc {flags} -c {src} -o {obj}".format(
-                flags=" ".join(_ARCH_FLAGS + _C_FLAGS),
+            dep = ctx.actions.declare_file("_objs/{}/{}.d".format(ctx.label.name, src.basename))
+            unused = ctx.actions.declare_file(
+                "_objs/{}/{}.unused".format(ctx.label.name, src.basename)
+            )
+            cmd = "arm-none-eabi-gcc {flags} -MMD -MF {dep} -c {src} -o {obj} && {unused}".format(
+                flags=" ".join(_ARCH_FLAGS + _C_FLAGS + mode_flags + _REPRODUCIBLE_FLAGS + defines),
+                dep=dep.path,
                 src=src.path,
                 obj=obj.path,
+                unused=_UNUSED_HDRS_CMD.format(
+                    dep=dep.path, hdrs=hdrs_list.path, unused=unused.path
+                ),
             )
             ctx.actions.run_shell(
                 command=cmd,
-                inputs=depset(direct=[src], transitive=[hdrs_depset]),
-                outputs=[obj],
+                inputs=depset(direct=[src, hdrs_list], transitive=[hdrs_depset]),
+                outputs=[obj, dep, unused],
+                unused_inputs_list=unused,
                 use_default_shell_env=True,
             )
 
     # Combine objs into an archive.
     archive = ctx.actions.declare_file("{}.a".format(ctx.label.name))
-    cmd = "arm-none-eabi-ar -rc {archive} {objs}".format(
+    # D: deterministic, with zeroed timestamps, owners and modes, so the same objects always make
+    # the same archive.
+    cmd = "arm-none-eabi-ar -rcD {archive} {objs}".format(
         archive=archive.path, objs=" ".join([obj.path for obj in objs])
     )
     ctx.actions.run_shell(
@@ -97,31 +151,64 @@ def _stm32g0xx_impl(ctx):
 
     # Assuming a ldscript is provided at this point. Link archives together.
     elf = ctx.actions.declare_file("{}.elf".format(ctx.label.name))
-    cmd = "arm-none-eabi-gcc -T {ldscript} {flags} {archives} -o {elf}".format(
+    cmd = "arm-none-eabi-gcc -T {ldscript} {flags} {archives} {libs} -o {elf}".format(
         flags=" ".join(_LD_FLAGS),
         ldscript=ctx.file.ldscript.path,
         archives=" ".join([archive.path for archive in archives_depset.to_list()]),
+        libs=" ".join(_LD_LIBS),
         elf=elf.path,
     )
     ctx.actions.run_shell(
         command=cmd,
-        inputs=depset(direct=[ctx.file.ldscript], transitive=[archives_depset]),
+        inputs=depset(
+            direct=[ctx.file.ldscript] + ctx.files.ldscript_includes,
+            transitive=[archives_depset],
+        ),
         outputs=[elf],
         use_default_shell_env=True,
     )
 
     # Finally, objcopy the elf to a bin and return it.
     bin = ctx.actions.declare_file("{}.bin".format(ctx.label.name))
+    objcopy_bin = bin
+    if ctx.attr.pack_data:
+        objcopy_bin = ctx.actions.declare_file("{}.unpacked.bin".format(ctx.label.name))
     cmd = "arm-none-eabi-objcopy -O binary {elf} {bin}".format(
-        elf=elf.path, bin=bin.path
+        elf=elf.path, bin=objcopy_bin.path
     )
     ctx.actions.run_shell(
         command=cmd,
         inputs=[elf],
-        outputs=[bin],
+        outputs=[objcopy_bin],
+        use_default_shell_env=True,
+    )
+    if not ctx.attr.pack_data:
+        return [
+            DefaultInfo(files=depset(direct=[bin])),
+            Stm32g0xxBinaryInfo(elf=elf, bin=bin),
+        ]
+
+    # Compress .data's initializers in the bin (tools/pack_data.py), and report the flash saved and
+    # the reset time it costs in <name>.pack_data.txt.
+    report = ctx.actions.declare_file("{}.pack_data.txt".format(ctx.label.name))
+    cmd = "python3 {tool} {elf} {unpacked} -o {bin} --report {report}".format(
+        tool=ctx.file._pack_tool.path,
+        elf=elf.path,
+        unpacked=objcopy_bin.path,
+        bin=bin.path,
+        report=report.path,
+    )
+    ctx.actions.run_shell(
+        command=cmd,
+        inputs=[elf, objcopy_bin] + ctx.files._pack_tool + ctx.files._tool_deps,
+        outputs=[bin, report],
+        mnemonic="PackData",
         use_default_shell_env=True,
     )
-    return [DefaultInfo(files=depset(direct=[bin]))]
+    return [
+        DefaultInfo(files=depset(direct=[bin, report])),
+        Stm32g0xxBinaryInfo(elf=elf, bin=bin),
+    ]
 
 
 _stm32g0xx_rule = rule(
@@ -129,8 +216,60 @@ _stm32g0xx_rule = rule(
     attrs={
         "srcs": attr.label_list(allow_files=[".c", ".s"]),
         "hdrs": attr.label_list(allow_files=[".h"]),
+        "defines": attr.string_list(),
         "deps": attr.label_list(providers=[Stm32g0xxLibraryInfo]),
         "ldscript": attr.label(allow_single_file=[".ld"]),
+        # Scripts the ldscript INCLUDEs, by path from the workspace root (the link runs with -L.).
+        "ldscript_includes": attr.label_list(allow_files=[".ld"]),
+        "pack_data": attr.bool(),
+        "_pack_tool": attr.label(default="//tools:pack_data.py", allow_single_file=True),
+        "_tool_deps": attr.label_list(default=["//tools:log_decode.py"], allow_files=True),
+    },
+)
+
+
+def _stm32g0xx_cycle_estimate_impl(ctx):
+    elf = ctx.attr.binary[Stm32g0xxBinaryInfo].elf
+    report = ctx.actions.declare_file("{}.txt".format(ctx.label.name))
+    args = ["--hclk-hz", str(ctx.attr.hclk_hz), "-o", report.path]
+    if ctx.attr.isr_budget:
+        args += ["--isr-budget", str(ctx.attr.isr_budget)]
+    for function, cycles in ctx.attr.budgets.items():
+        args += ["--budget", "{}={}".format(function, cycles)]
+    for function in ctx.attr.functions:
+        args += ["--function", function]
+    if ctx.attr.blocks:
+        args.append("--blocks")
+
+    # Show the whole report when something is over budget, since the failed action's output is gone.
+    cmd = "python3 {tool} {elf} {args} || (cat {report} >&2; exit 1)".format(
+        tool=ctx.file._tool.path,
+        elf=elf.path,
+        args=" ".join(args),
+        report=report.path,
+    )
+    ctx.actions.run_shell(
+        command=cmd,
+        inputs=[elf] + ctx.files._tool + ctx.files._tool_deps,
+        outputs=[report],
+        mnemonic="CycleEstimate",
+        use_default_shell_env=True,
+    )
+    return [DefaultInfo(files=depset(direct=[report]))]
+
+
+_stm32g0xx_cycle_estimate_rule = rule(
+    implementation=_stm32g0xx_cycle_estimate_impl,
+    attrs={
+        "binary": attr.label(providers=[Stm32g0xxBinaryInfo]),
+        "hclk_hz": attr.int(default=16000000),
+        "isr_budget": attr.int(),
+        # Function name to cycles, as a string (Bazel has no string to int dict attribute).
+        "budgets": attr.string_dict(),
+        "functions": attr.string_list(),
+        "blocks": attr.bool(),
+        "_tool": attr.label(default="//tools:cycle_estimate.py", allow_single_file=True),
+        "_tool_deps": attr.label_list(default=["//tools:log_decode.py"], allow_files=True),
     },
 )
 
@@ -139,27 +278,62 @@ def stm32g0xx_library(
     name,
     srcs=[],
     hdrs=[],
+    defines=[],
     deps=[],
 ):
     _stm32g0xx_rule(
         name=name,
         srcs=srcs,
         hdrs=hdrs,
+        defines=defines,
         deps=deps,
     )
 
 
+# The hal linker scripts all INCLUDE the shared sections, so that's the default include.
+# `pack_data` compresses the .data initializers in the bin, for ResetHandler() to decompress (see
+# tools/pack_data.py). That saves flash when .data holds big tables, for a slower reset.
 def stm32g0xx_binary(
     name,
     ldscript,
     srcs=[],
     hdrs=[],
+    defines=[],
     deps=[],
+    ldscript_includes=["//hal:stm32g031x8xx_sections.ld"],
+    pack_data=False,
 ):
     _stm32g0xx_rule(
         name=name,
         srcs=srcs,
         hdrs=hdrs,
+        defines=defines,
         deps=deps,
         ldscript=ldscript,
+        ldscript_includes=ldscript_includes,
+        pack_data=pack_data,
+    )
+
+
+# Static worst and best case cycle counts of a binary's functions (tools/cycle_estimate.py), written
+# to <name>.txt. The build fails if an interrupt handler's worst case is over `isr_budget` (0 for no
+# limit), or a function in `budgets` (name to cycles) is over its own. `hclk_hz` sets the flash wait
+# states. The report covers every function, or just `functions` and the budgeted ones if given.
+def stm32g0xx_cycle_estimate(
+    name,
+    binary,
+    hclk_hz=16000000,
+    isr_budget=0,
+    budgets={},
+    functions=[],
+    blocks=False,
+):
+    _stm32g0xx_cycle_estimate_rule(
+        name=name,
+        binary=binary,
+        hclk_hz=hclk_hz,
+        isr_budget=isr_budget,
+        budgets={function: str(cycles) for function, cycles in budgets.items()},
+        functions=functions,
+        blocks=blocks,
     )
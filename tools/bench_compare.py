@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Collect lib/bench.h results and compare them against a baseline.
+
+Reads the JSON lines a benchmark writes (from a serial port, a capture file, or a host build's
+stdout) up to its closing line, prints them as a table, and optionally saves them or checks them
+against a saved baseline. The exit status is 1 if any benchmark's minimum got slower than the
+baseline by more than the tolerance, so CI can fail on regressions. Standard library only.
+
+    tools/bench_compare.py /dev/ttyACM0 --save baseline.json
+    tools/bench_compare.py /dev/ttyACM0 --baseline baseline.json
+    ./hal_bench | tools/bench_compare.py --baseline host_baseline.json
+"""
+
+import argparse
+import io
+import json
+import sys
+
+from log_decode import open_input
+
+
+def read_results(stream):
+    """Returns the suite's header and its results, by name."""
+    header = None
+    results = {}
+    for line in io.TextIOWrapper(io.BufferedReader(stream), errors="replace"):
+        try:
+            record = json.loads(line)
+        except ValueError:
+            continue  # Noise before the suite starts, or a mangled line.
+        if not isinstance(record, dict):
+            continue
+        if "suite" in record:
+            header = record
+            results = {}
+        elif "bench" in record and header:
+            results[record["bench"]] = record
+        elif "done" in record and header:
+            break
+    if header is None:
+        raise EOFError("No benchmark output found")
+    return header, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-",
+                        help="serial port or capture file (default: stdin)")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    parser.add_argument("--save", help="write the results to this file, as a new baseline")
+    parser.add_argument("--baseline", help="compare against results saved with --save")
+    parser.add_argument("--tolerance", type=float, default=5,
+                        help="allowed slowdown of the minimum, in percent (default: 5)")
+    parser.add_argument("--slack", type=int, default=2,
+                        help="allowed slowdown in absolute units, for very short benchmarks")
+    args = parser.parse_args()
+
+    header, results = read_results(open_input(args.input, args.baud))
+    unit = header.get("unit", "")
+
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            saved = json.load(f)
+        if saved["header"].get("unit") != unit:
+            sys.exit("The baseline is in {}, these results are in {}".format(
+                saved["header"].get("unit"), unit))
+        baseline = saved["results"]
+
+    regressions = 0
+    print("{:<24} {:>8} {:>8} {:>8} {:>10} {:>8}".format(
+        header["suite"] + " (" + unit + ")", "min", "mean", "max", "baseline", "change"))
+    for name, result in results.items():
+        line = "{:<24} {:>8} {:>8} {:>8}".format(
+            name, result["min"], result["mean"], result["max"])
+        if name in baseline:
+            before = baseline[name]["min"]
+            change = result["min"] - before
+            percent = 100.0 * change / before if before else 0.0
+            line += " {:>10} {:>+7.1f}%".format(before, percent)
+            if change > args.slack and percent > args.tolerance:
+                line += "  REGRESSION"
+                regressions += 1
+        print(line)
+    for name in baseline:
+        if name not in results:
+            print("{:<24} missing".format(name))
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump({"header": header, "results": results}, f, indent=2)
+            f.write("\n")
+    if regressions:
+        print("{} regression(s)".format(regressions))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
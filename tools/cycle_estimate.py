@@ -0,0 +1,399 @@
+#!/usr/bin/env python3
+"""Estimate Cortex-M0+ cycle counts of the functions in a linked ELF.
+
+Disassembles the ELF (with arm-none-eabi-objdump), splits every function into basic blocks and
+adds up the cycles of each block's instructions from the Cortex-M0+ timings (Technical Reference
+Manual, section 3.3). A function's best case is its cheapest path from entry to exit and its worst
+case is its most expensive one, with each loop body counted once (loops are marked, multiply their
+blocks by the iteration count yourself). Calls count the callee's cycles too. Flash wait states
+come on top in the worst case, for every instruction fetch and literal load that misses the
+prefetch buffer and cache; the best case assumes they all hit. Standard library only.
+
+    tools/cycle_estimate.py bazel-bin/projects/hal_bench/hal_bench.elf
+    tools/cycle_estimate.py firmware.elf --hclk-hz 64000000 --blocks --function DecodeCobs
+    tools/cycle_estimate.py firmware.elf --isr-budget 200 --budget DecodeCobs=3000
+
+Interrupt handlers are the functions in the vector table. With --isr-budget, every handler's
+worst case is checked against it, and --budget checks any function, e.g. the hot ones. The exit
+status is 1 if anything is over its budget. Handlers also take 15 cycles to enter, which isn't
+included.
+
+The estimate can't see what a function pointer call or a computed jump goes to, or how long a
+peripheral stalls the bus, so those functions are marked and their numbers are a lower bound.
+"""
+
+import argparse
+import collections
+import math
+import re
+import shlex
+import subprocess
+import sys
+
+from log_decode import Elf
+
+VECTOR_TABLE = ".vector_table"
+RAM_START = 0x20000000
+
+# Flash wait states for HCLK up to each frequency, with the regulator in range 1 (RM0444 3.3.4).
+WAIT_STATES = [(24000000, 0), (48000000, 1), (64000000, 2)]
+
+# Instruction timings that aren't 1 cycle. Loads and stores take 2, except on the single cycle I/O
+# port (the STM32G0's GPIOs), which the addresses in the code don't tell apart, so those count 1
+# too many. Multiple loads and stores cost 1 + the number of registers, see instruction_cycles().
+CYCLES = {
+    "ldr": 2, "ldrb": 2, "ldrh": 2, "ldrsb": 2, "ldrsh": 2,
+    "str": 2, "strb": 2, "strh": 2,
+    "b": 2, "bx": 2, "blx": 2, "bl": 3,
+    "mrs": 3, "msr": 3, "isb": 3, "dsb": 3, "dmb": 3,
+}
+CONDITIONS = {"eq", "ne", "cs", "hs", "cc", "lo", "mi", "pl", "vs", "vc", "hi", "ls", "ge", "lt",
+              "gt", "le"}
+
+Instruction = collections.namedtuple("Instruction", "address size mnemonic operands")
+
+
+def parse_disassembly(text):
+    """Functions (name -> list of Instructions) from objdump -d output, GNU or LLVM flavored."""
+    functions = collections.OrderedDict()
+    current = None
+    for line in text.splitlines():
+        label = re.match(r"^([0-9a-f]+) <(.+)>:$", line)
+        if label:
+            name = label.group(2)
+            # LLVM prints the mapping symbols ($t, $d) as labels too. They aren't functions.
+            current = None if name.startswith("$") else functions.setdefault(name, [])
+            continue
+        match = re.match(r"^\s*([0-9a-f]+):\s*(.*)$", line)
+        if current is None or not match:
+            continue
+        fields = [field.strip() for field in match.group(2).split("\t")]
+        fields = [field for field in fields if field]
+        if len(fields) < 2 or not re.match(r"^[0-9a-f ]+$", fields[0]):
+            continue
+        size = len(fields[0].replace(" ", "")) // 2
+        mnemonic = fields[1].split()[0].lower()
+        if mnemonic.startswith("."):
+            continue  # A literal pool entry.
+        operands = " ".join(fields[2:]).split(";")[0].split("@ imm")[0].strip()
+        # Plain GNU syntax writes the width suffix (b.n, bl, ldr.w). It doesn't change the cycles.
+        mnemonic = re.sub(r"\.[nw]$", "", mnemonic)
+        current.append(Instruction(int(match.group(1), 16), size, mnemonic, operands))
+    return functions
+
+
+def branch_condition(mnemonic):
+    """(is a branch, is conditional) for a mnemonic like bne."""
+    if mnemonic == "b":
+        return True, False
+    return (mnemonic.startswith("b") and mnemonic[1:] in CONDITIONS), True
+
+
+def branch_target(instruction):
+    match = re.match(r"^(?:0x)?([0-9a-f]+)\b", instruction.operands)
+    return int(match.group(1), 16) if match else None
+
+
+def leaves_function(instruction):
+    """True for bx, pop {..., pc} and writes to pc, which nothing after them falls through from."""
+    mnemonic, operands = instruction.mnemonic, instruction.operands
+    return (mnemonic == "bx" or (mnemonic == "pop" and "pc" in operands) or
+            (mnemonic in ("mov", "add") and operands.startswith("pc")))
+
+
+def register_count(operands):
+    registers = 0
+    for item in re.search(r"\{(.*)\}", operands).group(1).split(","):
+        bounds = re.findall(r"\d+", item)
+        registers += int(bounds[1]) - int(bounds[0]) + 1 if "-" in item and len(bounds) == 2 else 1
+    return registers
+
+
+def instruction_cycles(instruction):
+    """Cycles of an instruction, not counting a taken branch's extra cycle."""
+    mnemonic, operands = instruction.mnemonic, instruction.operands
+    if mnemonic in ("push", "pop", "ldm", "ldmia", "stm", "stmia"):
+        cycles = 1 + register_count(operands)
+        return cycles + 2 if mnemonic == "pop" and "pc" in operands else cycles
+    if mnemonic in ("mov", "add") and operands.startswith("pc"):
+        return 2
+    is_branch, conditional = branch_condition(mnemonic)
+    if is_branch and conditional:
+        return 1
+    return CYCLES.get(mnemonic, 1)
+
+
+def is_literal_load(instruction):
+    return instruction.mnemonic.startswith("ldr") and "[pc" in instruction.operands
+
+
+class Block:
+    def __init__(self, start):
+        self.start = start
+        self.instructions = []
+        self.successors = []  # (block start, extra cycles on that edge)
+        self.calls = []       # Function names.
+        self.exit = False
+        self.unknown = False  # An indirect call or jump.
+
+    def cycles(self, wait_states):
+        """(best, worst) of the block's own instructions, before the edge it leaves by."""
+        best = sum(instruction_cycles(instruction) for instruction in self.instructions)
+        worst = best
+        for instruction in self.instructions:
+            if instruction.address < RAM_START:
+                # One fetch per 32 bits of code, and a literal is one more flash read.
+                worst += wait_states * instruction.size / 4.0
+                if is_literal_load(instruction):
+                    worst += wait_states
+        return best, worst
+
+
+def split_blocks(instructions, addresses):
+    """The function's basic blocks, by start address."""
+    start, end = instructions[0].address, instructions[-1].address + instructions[-1].size
+    leaders = {start}
+    for i, instruction in enumerate(instructions):
+        is_branch, _ = branch_condition(instruction.mnemonic)
+        target = branch_target(instruction) if is_branch else None
+        if target is not None and start <= target < end:
+            leaders.add(target)
+        # Whatever follows a branch or a return starts a block, so alignment padding and literals
+        # that objdump decodes as code after a return aren't charged to the block before them.
+        if (is_branch or leaves_function(instruction)) and i + 1 < len(instructions):
+            leaders.add(instructions[i + 1].address)
+
+    blocks = collections.OrderedDict()
+    block = None
+    for i, instruction in enumerate(instructions):
+        if instruction.address in leaders:
+            if block and not block.exit and not block.successors and not block.unknown:
+                block.successors.append((instruction.address, 0))  # Falls through.
+            block = blocks[instruction.address] = Block(instruction.address)
+        block.instructions.append(instruction)
+        mnemonic, operands = instruction.mnemonic, instruction.operands
+        is_branch, conditional = branch_condition(mnemonic)
+        following = instructions[i + 1].address if i + 1 < len(instructions) else None
+        if is_branch:
+            target = branch_target(instruction)
+            if target is not None and start <= target < end:
+                block.successors.append((target, 1 if conditional else 0))
+            elif target in addresses:
+                # A tail call.
+                block.calls.append(addresses[target])
+                block.exit = not conditional
+            else:
+                block.unknown = True
+            if conditional and following is not None:
+                block.successors.append((following, 0))
+            elif conditional:
+                block.exit = True
+        elif mnemonic == "bl":
+            target = branch_target(instruction)
+            if target in addresses:
+                block.calls.append(addresses[target])
+            else:
+                block.unknown = True
+        elif mnemonic == "blx":
+            block.unknown = True
+        elif mnemonic == "bx":
+            block.exit = True
+            block.unknown = operands != "lr"
+        elif (mnemonic == "pop" and "pc" in operands) or (
+                mnemonic in ("mov", "add") and operands.startswith("pc")):
+            block.exit = True
+            block.unknown = mnemonic != "pop"
+    if block and not block.exit and not block.successors:
+        block.exit = True  # Runs off the end, e.g. into a noreturn call's padding.
+    return blocks
+
+
+class Estimator:
+    def __init__(self, functions, wait_states):
+        self.functions = functions
+        self.wait_states = wait_states
+        self.addresses = {instructions[0].address: name
+                          for name, instructions in functions.items() if instructions}
+        self.blocks = {}
+        self.results = {}
+
+    def function_blocks(self, name):
+        if name not in self.blocks:
+            self.blocks[name] = split_blocks(self.functions[name], self.addresses)
+        return self.blocks[name]
+
+    def block_cycles(self, name, block, notes):
+        """(best, worst) of a block, with its calls."""
+        best, worst = block.cycles(self.wait_states)
+        for callee in block.calls:
+            callee_best, callee_worst, callee_notes = self.estimate(callee)
+            best += callee_best
+            worst += callee_worst
+            notes.update(callee_notes)
+        if block.unknown:
+            notes.add("indirect")
+        return best, worst
+
+    def estimate(self, name):
+        """(best, worst, notes) of a function, with its callees."""
+        if name in self.results:
+            return self.results[name]
+        if name not in self.functions or not self.functions[name]:
+            return 0, 0, {"unknown"}
+        self.results[name] = (0, 0, {"recursive"})  # Until the real numbers are in.
+        blocks = self.function_blocks(name)
+        notes = set()
+        cycles = {start: self.block_cycles(name, block, notes) for start, block in blocks.items()}
+
+        # Depth first from the entry. Edges back to a block on the stack close a loop, and are left
+        # out, which leaves a DAG whose paths visit every loop body once.
+        entry = next(iter(blocks))
+        order, back_edges, state = [], set(), {}
+        stack = [(entry, iter(blocks[entry].successors))]
+        state[entry] = "open"
+        while stack:
+            start, successors = stack[-1]
+            for successor, _ in successors:
+                if successor not in blocks:
+                    continue
+                if state.get(successor) == "open":
+                    back_edges.add((start, successor))
+                elif successor not in state:
+                    state[successor] = "open"
+                    stack.append((successor, iter(blocks[successor].successors)))
+                    break
+            else:
+                state[start] = "done"
+                order.append(start)
+                stack.pop()
+        if back_edges:
+            notes.add("loops")
+
+        # Cheapest and most expensive way from each block to an exit, in reverse topological
+        # order. A taken branch costs one more cycle, and flash wait states in the worst case.
+        best, worst = {}, {}
+        for start in order:
+            block = blocks[start]
+            own_best, own_worst = cycles[start]
+            options = []
+            for successor, taken in block.successors:
+                if (start, successor) in back_edges or successor not in best:
+                    continue
+                refill = self.wait_states if taken or block.instructions[-1].mnemonic == "b" else 0
+                options.append((best[successor] + taken, worst[successor] + taken + refill))
+            if block.exit or not options:
+                # Returns, tail calls and the ends of infinite loops.
+                options.append((0, self.wait_states))
+            best[start] = own_best + min(option[0] for option in options)
+            worst[start] = own_worst + max(option[1] for option in options)
+        result = (best[entry], int(math.ceil(worst[entry])), notes)
+        self.results[name] = result
+        return result
+
+    def block_report(self, name):
+        """(start, best, worst) of each of the function's blocks, with calls, without edges."""
+        rows = []
+        for start, block in self.function_blocks(name).items():
+            best, worst = self.block_cycles(name, block, set())
+            rows.append((start, best, int(math.ceil(worst)), block.calls))
+        return rows
+
+
+def vector_table_handlers(elf, addresses):
+    """Names of the functions in the vector table, after the initial stack pointer."""
+    if VECTOR_TABLE not in elf.sections:
+        return []
+    data = elf.section_bytes(VECTOR_TABLE)
+    handlers = []
+    for offset in range(4, len(data) - 3, 4):
+        address = int.from_bytes(data[offset:offset + 4], "little") & ~1
+        name = addresses.get(address)
+        if name and name not in handlers and name != "ResetHandler":
+            handlers.append(name)
+    return handlers
+
+
+def wait_states_for(hclk_hz):
+    for limit, wait_states in WAIT_STATES:
+        if hclk_hz <= limit:
+            return wait_states
+    raise ValueError("HCLK can't be above {} Hz".format(WAIT_STATES[-1][0]))
+
+
+def parse_budget(text):
+    name, _, cycles = text.rpartition("=")
+    if not name or not cycles.isdigit():
+        raise argparse.ArgumentTypeError("expected NAME=CYCLES, got {}".format(text))
+    return name, int(cycles)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="linked firmware")
+    parser.add_argument("--objdump", default="arm-none-eabi-objdump",
+                        help="disassembler command, e.g. \"llvm-objdump --mcpu=cortex-m0plus\"")
+    parser.add_argument("--hclk-hz", type=int, default=16000000,
+                        help="CPU clock, for the flash wait states (default: 16 MHz, at reset)")
+    parser.add_argument("--wait-states", type=int,
+                        help="flash wait states, instead of working them out from --hclk-hz")
+    parser.add_argument("--isr-budget", type=int,
+                        help="worst case cycles allowed for every interrupt handler")
+    parser.add_argument("--budget", type=parse_budget, action="append", default=[],
+                        metavar="NAME=CYCLES", help="worst case cycles allowed for a function")
+    parser.add_argument("--function", action="append", default=[],
+                        help="only report these functions (and the budgeted ones)")
+    parser.add_argument("--blocks", action="store_true", help="report every basic block too")
+    parser.add_argument("-o", "--output", help="write the report here instead of stdout")
+    args = parser.parse_args()
+
+    wait_states = args.wait_states
+    if wait_states is None:
+        wait_states = wait_states_for(args.hclk_hz)
+    disassembly = subprocess.run(shlex.split(args.objdump) + ["-d", args.elf], check=True,
+                                 stdout=subprocess.PIPE, universal_newlines=True).stdout
+    estimator = Estimator(parse_disassembly(disassembly), wait_states)
+    handlers = vector_table_handlers(Elf(args.elf), estimator.addresses)
+
+    budgets = collections.OrderedDict()
+    if args.isr_budget is not None:
+        for name in handlers:
+            budgets[name] = args.isr_budget
+    budgets.update(args.budget)
+    names = args.function + [name for name in budgets if name not in args.function]
+    if not args.function:
+        names = list(estimator.functions)
+
+    output = open(args.output, "w") if args.output else sys.stdout
+    print("{} wait states; worst cases include them, best cases don't".format(wait_states),
+          file=output)
+    print("{:<32} {:>8} {:>8} {:>8}  {}".format("function", "best", "worst", "budget", "notes"),
+          file=output)
+    over = []
+    for name in names:
+        if name not in estimator.functions:
+            print("{:<32} not found".format(name), file=output)
+            if name in budgets:
+                over.append(name)
+            continue
+        best, worst, notes = estimator.estimate(name)
+        notes = sorted(notes) + (["isr"] if name in handlers else [])
+        budget = budgets.get(name)
+        if budget is not None and worst > budget:
+            notes.append("OVER BUDGET")
+            over.append(name)
+        print("{:<32} {:>8} {:>8} {:>8}  {}".format(
+            name, best, worst, "" if budget is None else budget, ", ".join(notes)), file=output)
+        if args.blocks:
+            for start, block_best, block_worst, calls in estimator.block_report(name):
+                print("  {:08x}{:<22} {:>8} {:>8}  {}".format(
+                    start, "", block_best, block_worst,
+                    "calls " + ", ".join(calls) if calls else ""), file=output)
+    if output is not sys.stdout:
+        output.close()
+    if over:
+        print("Over budget: {}".format(", ".join(over)), file=sys.stderr)
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,156 @@
+#!/usr/bin/env python3
+"""Convert a lib/logic_analyzer.h dump to a VCD file.
+
+Open the result in GTKWave or PulseView. Every pin of the sampled port gets a wire, named after
+it (PA0 and so on) unless --name says otherwise, and a `trigger` wire pulses high for the trigger
+sample. Times start at the first sample. A summary of the capture and each pin's edges goes to
+stderr. Standard library only.
+
+    tools/la_to_vcd.py /dev/ttyACM0 -o capture.vcd
+    tools/la_to_vcd.py dump.bin -o capture.vcd --pins 0-3 --name 0=SCK --name 1=MOSI
+"""
+
+import argparse
+import struct
+import sys
+
+from log_decode import open_input
+
+MAGIC = b"LOGC"
+HEADER = struct.Struct("<4sIIII")
+RUN = struct.Struct("<HH")
+NO_TRIGGER = 0xFFFFFFFF
+PINS = 16
+
+# VCD identifiers are printable characters, one per wire.
+TRIGGER_ID = "t"
+
+
+def read_dump(stream):
+    """Skip to the magic (the port may carry other output too), return (hz, trigger, port, runs)."""
+    data = bytearray()
+
+    def need(count):
+        while len(data) < count:
+            chunk = stream.read(max(4096, count - len(data)))
+            if not chunk:
+                raise EOFError("The dump ended early")
+            data.extend(chunk)
+
+    while True:
+        need(HEADER.size)
+        start = data.find(MAGIC)
+        if start >= 0:
+            del data[:start]
+            need(HEADER.size)
+            break
+        del data[:-(len(MAGIC) - 1)]
+    _, hz, count, trigger, port = HEADER.unpack_from(data)
+    runs = []
+    offset = HEADER.size
+    total = 0
+    while True:
+        need(offset + RUN.size)
+        value, length = RUN.unpack_from(data, offset)
+        offset += RUN.size
+        if not length:
+            break
+        runs.append((value, length))
+        total += length
+    if total != count:
+        raise ValueError("The dump has {} samples, its header says {}".format(total, count))
+    return hz, (None if trigger == NO_TRIGGER else trigger), port, runs
+
+
+def parse_pins(text):
+    pins = []
+    for part in text.split(","):
+        first, _, last = part.partition("-")
+        pins.extend(range(int(first), int(last or first) + 1))
+    if any(pin < 0 or pin >= PINS for pin in pins):
+        raise argparse.ArgumentTypeError("pins are 0 to {}".format(PINS - 1))
+    return sorted(set(pins))
+
+
+def parse_name(text):
+    pin, _, name = text.partition("=")
+    if not pin.isdigit() or not name:
+        raise argparse.ArgumentTypeError("expected PIN=NAME, got {}".format(text))
+    return int(pin), name
+
+
+def write_vcd(output, hz, trigger, names, runs):
+    """Write the wires in `names` (pin to name), with times in nanoseconds. Returns edge counts."""
+    ids = {pin: chr(ord("!") + i) for i, pin in enumerate(names)}
+    print("$timescale 1 ns $end", file=output)
+    print("$scope module logic $end", file=output)
+    for pin, name in names.items():
+        print("$var wire 1 {} {} $end".format(ids[pin], name), file=output)
+    print("$var wire 1 {} trigger $end".format(TRIGGER_ID), file=output)
+    print("$upscope $end", file=output)
+    print("$enddefinitions $end", file=output)
+
+    def time(sample):
+        return sample * 1000000000 // hz
+
+    # Wire changes by sample index: the runs, plus the trigger pulse.
+    changes = {}
+    edges = {pin: 0 for pin in names}
+    previous = None
+    sample = 0
+    for value, length in runs:
+        for pin in names:
+            bit = value >> pin & 1
+            if previous is None or bit != previous >> pin & 1:
+                changes.setdefault(sample, []).append("{}{}".format(bit, ids[pin]))
+                edges[pin] += previous is not None
+        previous = value
+        sample += length
+    changes.setdefault(0, []).append("0" + TRIGGER_ID)
+    if trigger is not None:
+        changes.setdefault(trigger, []).append("1" + TRIGGER_ID)
+        changes.setdefault(trigger + 1, []).append("0" + TRIGGER_ID)
+    for index in sorted(changes):
+        print("#{}".format(time(index)), file=output)
+        for change in changes[index]:
+            print(change, file=output)
+    print("#{}".format(time(sample)), file=output)
+    return edges
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-",
+                        help="serial port or dump file (default: stdin)")
+    parser.add_argument("-o", "--output", default="-", help="VCD file (default: stdout)")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    parser.add_argument("--pins", type=parse_pins, default=list(range(PINS)),
+                        help="pins to include, e.g. 0-3,7 (default: all 16)")
+    parser.add_argument("--name", type=parse_name, action="append", default=[],
+                        metavar="PIN=NAME", help="name a pin's wire")
+    args = parser.parse_args()
+
+    hz, trigger, port, runs = read_dump(open_input(args.input, args.baud))
+    custom = dict(args.name)
+    names = {pin: custom.get(pin, "P{}{}".format(chr(ord("A") + port), pin)) for pin in args.pins}
+    if args.output == "-":
+        edges = write_vcd(sys.stdout, hz, trigger, names, runs)
+    else:
+        with open(args.output, "w") as f:
+            edges = write_vcd(f, hz, trigger, names, runs)
+
+    count = sum(length for _, length in runs)
+    print("{} samples at {} Hz, {:.3f} ms, {} runs".format(
+        count, hz, count * 1000 / hz, len(runs)), file=sys.stderr)
+    if trigger is None:
+        print("No trigger", file=sys.stderr)
+    else:
+        print("Trigger at sample {} ({:.3f} ms)".format(trigger, trigger * 1000 / hz),
+              file=sys.stderr)
+    for pin, name in names.items():
+        if edges[pin]:
+            print("  {:<8} {} edges".format(name, edges[pin]), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""Decode the binary log stream from lib/log.h.
+
+The firmware sends each LOG() as a 16 bit ID (the format string's address in the ELF's .logstr
+section) plus raw 32 bit arguments. This looks the format strings up in the ELF and prints the
+formatted lines. Standard library only.
+
+    tools/log_decode.py bazel-bin/projects/log_demo/log_demo.elf /dev/ttyACM0
+    tools/log_decode.py firmware.elf capture.bin
+    cat capture.bin | tools/log_decode.py firmware.elf
+"""
+
+import argparse
+import os
+import re
+import stat
+import struct
+import sys
+
+SYNC = 0xA5
+DROPPED_ID = 0xFFFF
+MAX_ARGS = 4
+LOG_SECTION = ".logstr"
+
+# %[flags][width][.precision][length]conversion
+CONVERSION = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+class Elf:
+    """Just enough of an ELF reader to find sections and read bytes at addresses."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("{} is not an ELF file".format(path))
+        is_64 = self.data[4] == 2
+        if self.data[5] != 1:
+            raise ValueError("Only little endian ELF files are supported")
+        if is_64:
+            phoff, shoff = struct.unpack_from("<QQ", self.data, 0x20)
+            phentsize, phnum, shentsize, shnum, shstrndx = struct.unpack_from(
+                "<HHHHH", self.data, 0x36)
+            header = "<IIQQQQIIQQ"
+            program_header = "<IIQQQQQQ"
+        else:
+            phoff, shoff = struct.unpack_from("<II", self.data, 0x1C)
+            phentsize, phnum, shentsize, shnum, shstrndx = struct.unpack_from(
+                "<HHHHH", self.data, 0x2A)
+            header = "<IIIIIIIIII"
+            program_header = "<IIIIIIII"
+        # Loaded segments as (address, load address, size), to find where sections are stored.
+        self.segments = []
+        for i in range(phnum):
+            fields = struct.unpack_from(program_header, self.data, phoff + i * phentsize)
+            if is_64:
+                kind, _, _, vaddr, paddr, _, memsz, _ = fields
+            else:
+                kind, _, vaddr, paddr, _, memsz, _, _ = fields
+            if kind == 1:  # PT_LOAD
+                self.segments.append((vaddr, paddr, memsz))
+        sections = []
+        for i in range(shnum):
+            fields = struct.unpack_from(header, self.data, shoff + i * shentsize)
+            name, kind, flags, addr, offset, size = fields[:6]
+            sections.append([name, kind, flags, addr, offset, size])
+        names = sections[shstrndx]
+        self.sections = {}
+        for section in sections:
+            section[0] = self._string(names[4] + section[0])
+            self.sections[section[0]] = section
+
+    def _string(self, offset):
+        end = self.data.index(b"\0", offset)
+        return self.data[offset:end].decode("utf-8", "replace")
+
+    def section_bytes(self, name):
+        _, kind, _, _, offset, size = self.sections[name]
+        return b"" if kind == 8 else self.data[offset:offset + size]  # SHT_NOBITS
+
+    def load_address(self, name):
+        """Where a section is stored in the image, e.g. .data's initial values in flash."""
+        addr = self.sections[name][3]
+        for vaddr, paddr, size in self.segments:
+            if vaddr <= addr < vaddr + size:
+                return paddr + addr - vaddr
+        return addr
+
+    def read_string(self, address):
+        """C string at a loaded (SHF_ALLOC) address, or None."""
+        for name, (_, kind, flags, addr, offset, size) in self.sections.items():
+            if name == LOG_SECTION or not flags & 2 or kind == 8:
+                continue
+            if addr <= address < addr + size:
+                return self._string(offset + address - addr)
+        return None
+
+
+class Decoder:
+    def __init__(self, elf):
+        self.elf = elf
+        if LOG_SECTION not in elf.sections:
+            raise ValueError("The ELF has no {} section, is lib/log linked in?".format(LOG_SECTION))
+        self.strings = elf.section_bytes(LOG_SECTION)
+        # The section starts at 0 on the target, so IDs are offsets. Subtracting the address keeps
+        # this working for (non-PIE) host builds too.
+        self.base = elf.sections[LOG_SECTION][3]
+        self.pending = bytearray()
+
+    def _offset(self, log_id):
+        offset = (log_id - self.base) & 0xFFFF
+        # A valid ID points at the start of a string.
+        if offset >= len(self.strings) or (offset > 0 and self.strings[offset - 1] != 0):
+            return None
+        return offset
+
+    def _format(self, offset, args):
+        end = self.strings.index(b"\0", offset)
+        text = self.strings[offset:end].decode("utf-8", "replace")
+        remaining = list(args)
+
+        def convert(match):
+            flags, width, precision, kind = match.groups()
+            if kind == "%":
+                return "%"
+            if not remaining:
+                return "<missing>"
+            value = remaining.pop(0)
+            spec = "%" + flags + width + ("." + precision if precision else "")
+            if kind in "di":
+                return (spec + "d") % (value - (1 << 32) if value & 0x80000000 else value)
+            if kind == "u":
+                return (spec + "d") % value
+            if kind in "oxX":
+                return (spec + kind) % value
+            if kind == "c":
+                return (spec + "c") % chr(value & 0xFF)
+            if kind == "p":
+                return "0x%08x" % value
+            string = self.elf.read_string(value)
+            return (spec + "s") % (string if string is not None else "<0x%08x>" % value)
+
+        return CONVERSION.sub(convert, text)
+
+    def feed(self, data):
+        """Consume raw bytes, return the decoded lines."""
+        self.pending += data
+        lines = []
+        while len(self.pending) >= 4:
+            sync, num_args, log_id = struct.unpack_from("<BBH", self.pending)
+            if log_id == DROPPED_ID and num_args == 1:
+                offset = DROPPED_ID
+            else:
+                offset = self._offset(log_id) if sync == SYNC and num_args <= MAX_ARGS else None
+            if offset is None:
+                # Not a header, we joined mid-record or lost bytes. Resynchronize.
+                del self.pending[0]
+                continue
+            length = 4 + 4 * num_args
+            if len(self.pending) < length:
+                break
+            args = struct.unpack_from("<{}I".format(num_args), self.pending, 4)
+            del self.pending[:length]
+            if offset == DROPPED_ID:
+                lines.append("<{} records dropped>".format(args[0]))
+            else:
+                lines.append(self._format(offset, args))
+        return lines
+
+
+def open_input(path, baud):
+    if path == "-":
+        return sys.stdin.buffer.raw
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if stat.S_ISCHR(os.fstat(fd).st_mode):
+        import termios
+        import tty
+        tty.setraw(fd)
+        attributes = termios.tcgetattr(fd)
+        speed = getattr(termios, "B{}".format(baud))
+        attributes[4] = attributes[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attributes)
+    return os.fdopen(fd, "rb", buffering=0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF with the .logstr section")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="serial port or capture file (default: stdin)")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf))
+    stream = open_input(args.input, args.baud)
+    try:
+        while True:
+            data = stream.read(4096)
+            if not data:
+                break
+            for line in decoder.feed(data):
+                print(line, flush=True)
+    except (KeyboardInterrupt, BrokenPipeError):
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Compress the .data initializers in a firmware image, for ResetHandler() to decompress.
+
+ResetHandler() (hal/system.c) copies .data's initial values from flash to RAM, so every initialized
+table takes its full size in flash. This compresses that copy in the .bin with LZ4's block format
+and sets the `packed_data_size` word (the .data_pack section) so ResetHandler() decompresses it
+instead. The image gets shorter by what the compression saves. The ELF is left as it is, and still
+boots with its uncompressed copy, e.g. when a debugger loads it. Standard library only.
+
+    tools/pack_data.py firmware.elf firmware.bin -o firmware_packed.bin
+
+The report says how much flash that saves, and roughly how much longer the reset takes, from
+the copy and decompression loops' cycles per word copied and per sequence and byte decompressed
+(tools/cycle_estimate.py --function UnpackData --blocks has the details). If the compressed .data
+isn't smaller, the image is left as it is.
+"""
+
+import argparse
+import collections
+import struct
+import sys
+
+from log_decode import Elf
+
+DATA = ".data"
+DATA_PACK = ".data_pack"
+
+# LZ4 block format: a match is at least 4 bytes and at most 65535 bytes back. The last 5 bytes
+# are always literals, and the last match starts at least 12 bytes before the end.
+MIN_MATCH = 4
+MAX_OFFSET = 0xFFFF
+LAST_LITERALS = 5
+MATCH_FIND_LIMIT = 12
+# Earlier positions with the same first 4 bytes to try, most recent first.
+MAX_CANDIDATES = 64
+
+# Reset cycles at 0 wait states: copying a word (ResetHandler() is -O0), and unpacking per
+# sequence and per byte, literal or match.
+COPY_WORD_CYCLES = 24
+UNPACK_SEQUENCE_CYCLES = 30
+UNPACK_BYTE_CYCLES = 9
+
+
+def length_bytes(length):
+    """The bytes that extend a 4 bit length of 15: 255s, then the rest."""
+    out = bytearray()
+    length -= 15
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+    return out
+
+
+def compress(data):
+    """`data` in LZ4's block format, and how many sequences that takes."""
+    out = bytearray()
+    candidates = collections.defaultdict(list)
+    match_end = len(data) - LAST_LITERALS
+    literals = 0
+    sequences = 0
+    i = 0
+    while i < len(data) - MATCH_FIND_LIMIT:
+        best_length, best_offset = 0, 0
+        for position in reversed(candidates[data[i:i + MIN_MATCH]][-MAX_CANDIDATES:]):
+            if i - position > MAX_OFFSET:
+                break
+            length = MIN_MATCH
+            while i + length < match_end and data[position + length] == data[i + length]:
+                length += 1
+            if length > best_length:
+                best_length, best_offset = length, i - position
+        candidates[data[i:i + MIN_MATCH]].append(i)
+        if not best_length:
+            i += 1
+            continue
+
+        literal_count = i - literals
+        match_code = best_length - MIN_MATCH
+        out.append(min(literal_count, 15) << 4 | min(match_code, 15))
+        if literal_count >= 15:
+            out += length_bytes(literal_count)
+        out += data[literals:i]
+        out += struct.pack("<H", best_offset)
+        if match_code >= 15:
+            out += length_bytes(match_code)
+        sequences += 1
+        for j in range(i + 1, i + best_length):
+            candidates[data[j:j + MIN_MATCH]].append(j)
+        i += best_length
+        literals = i
+
+    literal_count = len(data) - literals
+    out.append(min(literal_count, 15) << 4)
+    if literal_count >= 15:
+        out += length_bytes(literal_count)
+    out += data[literals:]
+    return bytes(out), sequences + 1
+
+
+def decompress(packed, size):
+    """The inverse of compress(), written the same way as UnpackData() in hal/system.c."""
+    out = bytearray()
+    i = 0
+    while True:
+        token = packed[i]
+        i += 1
+        length = token >> 4
+        if length == 15:
+            while True:
+                length += packed[i]
+                i += 1
+                if packed[i - 1] != 255:
+                    break
+        out += packed[i:i + length]
+        i += length
+        if len(out) >= size:
+            return bytes(out)
+        offset, = struct.unpack_from("<H", packed, i)
+        i += 2
+        length = (token & 0xF) + MIN_MATCH
+        if token & 0xF == 15:
+            while True:
+                length += packed[i]
+                i += 1
+                if packed[i - 1] != 255:
+                    break
+        for _ in range(length):
+            out.append(out[-offset])
+
+
+def image_start(elf):
+    """The load address of the .bin's first byte, like objcopy -O binary picks it."""
+    return min(elf.load_address(name) for name, (_, kind, flags, _, _, size) in
+               elf.sections.items() if flags & 2 and kind != 8 and size)  # SHF_ALLOC, SHT_NOBITS
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="linked firmware")
+    parser.add_argument("bin", help="the ELF's objcopy -O binary image")
+    parser.add_argument("-o", "--output", required=True, help="where to write the packed image")
+    parser.add_argument("--report", help="write the report here instead of stdout")
+    parser.add_argument("--hclk-hz", type=int, default=16000000,
+                        help="CPU clock at reset, for the report's times (default: 16 MHz)")
+    args = parser.parse_args()
+
+    elf = Elf(args.elf)
+    with open(args.bin, "rb") as f:
+        image = bytearray(f.read())
+    if DATA_PACK not in elf.sections or elf.sections[DATA_PACK][5] != 4:
+        sys.exit("{} has no {} word, is hal/system.c linked in?".format(args.elf, DATA_PACK))
+    start = image_start(elf)
+    data = elf.section_bytes(DATA) if DATA in elf.sections else b""
+    data_offset = elf.load_address(DATA) - start if data else len(image)
+    pack_offset = elf.load_address(DATA_PACK) - start
+    if bytes(image[data_offset:data_offset + len(data)]) != data:
+        sys.exit("{} doesn't hold {}'s {} at {:#x}".format(args.bin, args.elf, DATA, data_offset))
+    if data_offset + len(data) != len(image):
+        sys.exit("{} isn't at the end of {}".format(DATA, args.bin))
+
+    packed, sequences = compress(data) if data else (b"", 0)
+    if data and decompress(packed, len(data)) != data:
+        sys.exit("{} doesn't decompress to itself".format(DATA))
+    copy_cycles = len(data) // 4 * COPY_WORD_CYCLES
+    unpack_cycles = sequences * UNPACK_SEQUENCE_CYCLES + len(data) * UNPACK_BYTE_CYCLES
+
+    lines = []
+    if data and len(packed) < len(data):
+        image[data_offset:] = packed
+        image[pack_offset:pack_offset + 4] = struct.pack("<I", len(packed))
+        saved = len(data) - len(packed)
+        extra = unpack_cycles - copy_cycles
+        lines.append("{}: {} bytes, packed to {} (LZ4, {} sequences), {} bytes of flash "
+                     "saved".format(DATA, len(data), len(packed), sequences, saved))
+        lines.append("Reset: ~{} cycles to unpack instead of ~{} to copy, {:+} ({:+.0f} us at {} "
+                     "MHz)".format(unpack_cycles, copy_cycles, extra,
+                                   extra * 1e6 / args.hclk_hz, args.hclk_hz // 1000000))
+    else:
+        lines.append("{}: {} bytes, doesn't get smaller packed ({}), left as it is".format(
+            DATA, len(data), len(packed)))
+
+    with open(args.output, "wb") as f:
+        f.write(image)
+    output = open(args.report, "w") if args.report else sys.stdout
+    for line in lines:
+        print(line, file=output)
+    if output is not sys.stdout:
+        output.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Convert a lib/trace.h dump to Chrome trace JSON.
+
+Open the result in chrome://tracing or https://ui.perfetto.dev. Each interrupt gets its own track,
+next to main and the tasks, so preemption, long handlers and jitter are easy to spot. A summary of
+every interrupt's duration and period goes to stderr. Standard library only.
+
+    tools/trace_to_chrome.py firmware.elf /dev/ttyACM0 -o trace.json
+    tools/trace_to_chrome.py firmware.elf dump.bin -o trace.json
+
+The ELF is only needed for the names of TRACE_BEGIN() and friends, which are looked up the same
+way tools/log_decode.py looks up format strings.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+from log_decode import LOG_SECTION, Elf, open_input
+
+MAGIC = b"TRCE"
+HEADER = struct.Struct("<4sIII")
+EVENT = struct.Struct("<IHBB")
+
+ISR_ENTER, ISR_EXIT, BEGIN, END, INSTANT, TASK = range(6)
+
+# Exception numbers (IPSR) to names, see hal/system.c and the Irq enum in hal/nvic.h.
+EXCEPTIONS = {
+    2: "Nmi", 3: "HardFault", 11: "Svc", 14: "PendSv", 15: "SysTick",
+    16: "Wwdg", 17: "Pvd", 18: "RtcTamp", 19: "Flash", 20: "Rcc", 21: "Exti0To1",
+    22: "Exti2To3", 23: "Exti4To15", 25: "Dma1Channel1", 26: "Dma1Channel2To3",
+    27: "Dma1Channel4To5", 28: "Adc", 29: "Tim1BrkUpTrgCom", 30: "Tim1Cc", 31: "Tim2",
+    32: "Tim3", 33: "Lptim1", 34: "Lptim2", 35: "Tim14", 37: "Tim16", 38: "Tim17", 39: "I2c1",
+    40: "I2c2", 41: "Spi1", 42: "Spi2", 43: "Usart1", 44: "Usart2", 45: "Lpuart1",
+}
+
+# Track (thread) IDs. Interrupts use their exception number, which is never below 2.
+MAIN_TID = 0
+TASKS_TID = 1
+
+
+class Names:
+    """Resolves TRACE_ID()s through the ELF's .logstr section."""
+
+    def __init__(self, elf):
+        self.strings = b""
+        self.base = 0
+        if elf and LOG_SECTION in elf.sections:
+            self.strings = elf.section_bytes(LOG_SECTION)
+            self.base = elf.sections[LOG_SECTION][3]
+
+    def __call__(self, name_id):
+        offset = (name_id - self.base) & 0xFFFF
+        if offset < len(self.strings) and (offset == 0 or self.strings[offset - 1] == 0):
+            end = self.strings.index(b"\0", offset)
+            return self.strings[offset:end].decode("utf-8", "replace")
+        return "0x%04x" % name_id
+
+
+def read_dump(stream):
+    """Skip to the magic (the port may carry other output too), return (hz, lost, events)."""
+    data = bytearray()
+
+    def need(count):
+        while len(data) < count:
+            chunk = stream.read(max(4096, count - len(data)))
+            if not chunk:
+                raise EOFError("The dump ended early")
+            data.extend(chunk)
+
+    while True:
+        need(HEADER.size)
+        start = data.find(MAGIC)
+        if start >= 0:
+            del data[:start]
+            need(HEADER.size)
+            break
+        del data[:-(len(MAGIC) - 1)]
+    _, hz, count, lost = HEADER.unpack_from(data)
+    need(HEADER.size + count * EVENT.size)
+    events = [EVENT.unpack_from(data, HEADER.size + i * EVENT.size) for i in range(count)]
+    return hz, lost, events
+
+
+def convert(hz, events, names):
+    """Returns the Chrome trace events and per interrupt statistics."""
+    trace = []
+    tracks = {MAIN_TID: "main", TASKS_TID: "tasks"}
+    # What's running: main, then any nested interrupts, with their entry times.
+    stack = [(MAIN_TID, None)]
+    stats = {}
+    task = None
+    cycles = 0
+    previous = events[0][0] if events else 0
+    for raw_cycles, name_id, kind, value in events:
+        # The counter wraps every 2^32 cycles, the gaps between events don't.
+        cycles += (raw_cycles - previous) & 0xFFFFFFFF
+        previous = raw_cycles
+        ts = cycles * 1e6 / hz
+        tid = stack[-1][0]
+        if kind == ISR_ENTER:
+            name = EXCEPTIONS.get(name_id, "Exception{}".format(name_id))
+            tracks[name_id] = name
+            trace.append({"name": name, "ph": "B", "ts": ts, "pid": 0, "tid": name_id})
+            stack.append((name_id, cycles))
+            entry = stats.setdefault(name, {"durations": [], "entries": []})
+            entry["entries"].append(cycles)
+        elif kind == ISR_EXIT:
+            # The buffer may start in the middle of a handler, with no entry for this exit.
+            if tid != name_id:
+                continue
+            _, entered = stack.pop()
+            name = tracks[name_id]
+            trace.append({"name": name, "ph": "E", "ts": ts, "pid": 0, "tid": name_id})
+            stats[name]["durations"].append(cycles - entered)
+        elif kind in (BEGIN, END):
+            trace.append({"name": names(name_id), "ph": "B" if kind == BEGIN else "E", "ts": ts,
+                          "pid": 0, "tid": tid})
+        elif kind == INSTANT:
+            trace.append({"name": names(name_id), "ph": "i", "s": "t", "ts": ts, "pid": 0,
+                          "tid": tid, "args": {"value": value}})
+        elif kind == TASK:
+            if task is not None:
+                trace.append({"name": task, "ph": "E", "ts": ts, "pid": 0, "tid": TASKS_TID})
+            task = names(name_id)
+            trace.append({"name": task, "ph": "B", "ts": ts, "pid": 0, "tid": TASKS_TID})
+    for tid, name in tracks.items():
+        trace.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": tid,
+                      "args": {"name": name}})
+        trace.append({"name": "thread_sort_index", "ph": "M", "pid": 0, "tid": tid,
+                      "args": {"sort_index": tid}})
+    return trace, stats
+
+
+def print_summary(hz, lost, events, stats, out):
+    span = sum((b[0] - a[0]) & 0xFFFFFFFF for a, b in zip(events, events[1:]))
+    print("{} events over {:.3f} ms at {} Hz, {} older events lost".format(
+        len(events), span * 1e3 / hz, hz, lost), file=out)
+    if not stats:
+        return
+    print("{:<18} {:>6} {:>30} {:>30}".format(
+        "interrupt", "count", "duration min/avg/max (us)", "period min/max (us)"), file=out)
+    us = 1e6 / hz
+    for name, entry in sorted(stats.items()):
+        durations = entry["durations"]
+        periods = [b - a for a, b in zip(entry["entries"], entry["entries"][1:])]
+        duration = "{:.1f}/{:.1f}/{:.1f}".format(
+            min(durations) * us, sum(durations) * us / len(durations),
+            max(durations) * us) if durations else "-"
+        period = "{:.1f}/{:.1f}".format(
+            min(periods) * us, max(periods) * us) if periods else "-"
+        print("{:<18} {:>6} {:>30} {:>30}".format(
+            name, len(entry["entries"]), duration, period), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", help="firmware ELF, for the names of user events")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="serial port or dump file (default: stdin)")
+    parser.add_argument("-o", "--output", default="-", help="JSON file (default: stdout)")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    args = parser.parse_args()
+
+    names = Names(Elf(args.elf))
+    hz, lost, events = read_dump(open_input(args.input, args.baud))
+    trace, stats = convert(hz, events, names)
+    document = {"traceEvents": trace, "displayTimeUnit": "ns"}
+    if args.output == "-":
+        json.dump(document, sys.stdout)
+    else:
+        with open(args.output, "w") as f:
+            json.dump(document, f)
+    print_summary(hz, lost, events, stats, sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+"""Update the firmware through the bootloader (projects/bootloader) over a serial port.
+
+Every image is linked for one of the two flash slots, so this takes the builds for both and sends
+the one the device asks for, which is the slot it isn't running from. Frames go out in a sliding
+window and get resent from wherever the device asks (or from the last acknowledged one after a
+timeout). See lib/boot.h for the protocol. Standard library only.
+
+    tools/uploader.py /dev/ttyACM0 bazel-bin/projects/update_demo/update_demo_a.bin \\
+        bazel-bin/projects/update_demo/update_demo_b.bin
+
+The start frame also gets a running application's attention: update_demo calls RequestUpdate() on
+its sync byte, and the start frame is repeated until the bootloader answers.
+"""
+
+import argparse
+import os
+import select
+import stat
+import struct
+import sys
+import time
+import zlib
+
+SYNC = 0x5A
+MAX_PAYLOAD = 256
+WINDOW = 4
+BAUD = 1000000
+
+START, DATA, FINISH = 0x01, 0x02, 0x03
+READY, ACK, NAK, DONE, FAILED = 0x81, 0x82, 0x83, 0x84, 0x85
+ERRORS = {1: "image too large", 2: "flash error", 3: "incomplete image", 4: "CRC mismatch"}
+
+HEADER = struct.Struct("<BBHI")
+CRC = struct.Struct("<I")
+
+
+class UpdateError(Exception):
+    pass
+
+
+def frame(kind, offset=0, payload=b""):
+    data = HEADER.pack(SYNC, kind, len(payload), offset) + payload
+    return data + CRC.pack(zlib.crc32(data))
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+    if stat.S_ISCHR(os.fstat(fd).st_mode):
+        import termios
+        import tty
+        tty.setraw(fd)
+        attributes = termios.tcgetattr(fd)
+        speed = getattr(termios, "B{}".format(baud))
+        attributes[4] = attributes[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attributes)
+    return fd
+
+
+class Port:
+    """Frames over a file descriptor, with timeouts."""
+
+    def __init__(self, fd):
+        self.fd = fd
+        self.pending = b""
+
+    def send(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def responses(self, timeout):
+        """Response frames (kind, offset) that arrive within `timeout` seconds of each other."""
+        while True:
+            ready, _, _ = select.select([self.fd], [], [], timeout)
+            if not ready:
+                return
+            data = os.read(self.fd, 4096)
+            if not data:
+                return
+            self.pending += data
+            while True:
+                start = self.pending.find(bytes([SYNC]))
+                if start < 0:
+                    self.pending = b""
+                    break
+                self.pending = self.pending[start:]
+                if len(self.pending) < HEADER.size + CRC.size:
+                    break
+                _, kind, length, offset = HEADER.unpack_from(self.pending)
+                crc, = CRC.unpack_from(self.pending, HEADER.size)
+                if length or crc != zlib.crc32(self.pending[:HEADER.size]):
+                    self.pending = self.pending[1:]
+                    continue
+                self.pending = self.pending[HEADER.size + CRC.size:]
+                yield kind, offset
+
+
+def load_image(path):
+    with open(path, "rb") as f:
+        image = f.read()
+    return image + b"\xff" * (-len(image) % 8)
+
+
+def start(port, images, timeout):
+    payload = b"".join(struct.pack("<II", len(image), zlib.crc32(image)) for image in images)
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        port.send(frame(START, 0, payload))
+        # Erasing a whole slot takes a few hundred milliseconds.
+        for kind, offset in port.responses(1.0):
+            if kind == READY:
+                return offset
+            if kind == FAILED:
+                raise UpdateError(ERRORS.get(offset, "error {}".format(offset)))
+    raise UpdateError("no answer from the bootloader")
+
+
+def send_image(port, image, window, progress):
+    base = 0          # Everything before this is acknowledged.
+    next_offset = 0   # Next frame to send.
+    retries = 0
+    while base < len(image):
+        while next_offset < len(image) and next_offset - base < window * MAX_PAYLOAD:
+            chunk = image[next_offset:next_offset + MAX_PAYLOAD]
+            port.send(frame(DATA, next_offset, chunk))
+            next_offset += len(chunk)
+        answered = False
+        for kind, offset in port.responses(0.2):
+            answered = True
+            if kind == ACK and offset > base:
+                base = offset
+                retries = 0
+                progress(base)
+            elif kind == NAK and offset < next_offset:
+                base = max(base, offset)
+                next_offset = offset
+            elif kind == FAILED:
+                raise UpdateError(ERRORS.get(offset, "error {}".format(offset)))
+            if next_offset - base < window * MAX_PAYLOAD:
+                break
+        if not answered:
+            retries += 1
+            if retries > 10:
+                raise UpdateError("no acknowledgement at offset {}".format(base))
+            next_offset = base
+
+
+def finish(port):
+    for _ in range(3):
+        port.send(frame(FINISH))
+        for kind, offset in port.responses(2.0):
+            if kind == DONE:
+                return offset
+            if kind == FAILED:
+                raise UpdateError(ERRORS.get(offset, "error {}".format(offset)))
+    raise UpdateError("no answer to the finish frame")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port")
+    parser.add_argument("slot_a", help="image linked for slot A (hal/stm32g031x8xx_slot_a.ld)")
+    parser.add_argument("slot_b", help="image linked for slot B (hal/stm32g031x8xx_slot_b.ld)")
+    parser.add_argument("--baud", type=int, default=BAUD, help="serial baud rate")
+    parser.add_argument("--window", type=int, default=WINDOW,
+                        help="frames in flight, at most the bootloader's UPDATE_WINDOW")
+    parser.add_argument("--timeout", type=float, default=30, help="seconds to wait for the device")
+    args = parser.parse_args()
+
+    images = [load_image(args.slot_a), load_image(args.slot_b)]
+    port = Port(open_port(args.port, args.baud))
+    began = time.monotonic()
+    try:
+        slot = start(port, images, args.timeout)
+        image = images[slot]
+        print("Sending {} bytes to slot {}".format(len(image), "AB"[slot]), file=sys.stderr)
+
+        def progress(done):
+            print("\r{:3d}%".format(100 * done // len(image)), end="", file=sys.stderr)
+
+        send_image(port, image, args.window, progress)
+        sequence = finish(port)
+    except UpdateError as e:
+        print("\nUpdate failed: {}".format(e), file=sys.stderr)
+        sys.exit(1)
+    print("\rUpdated slot {} (sequence {}) in {:.1f} s".format(
+        "AB"[slot], sequence, time.monotonic() - began), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""Host test of the update protocol: tools/uploader.py against lib/boot's receiver.
+
+Builds lib/boot_test.c, a simulated device with the two slots in RAM (kept in a file between
+boots), and runs uploads through uploader.py's own start/send_image/finish over a socket pair, with
+frames dropped and corrupted on the way, repeated start frames and power cuts during the finish.
+After each one, FindBootSlot() has to pick the right slot. Standard library and the host gcc only.
+
+    tools/uploader_test.py
+"""
+
+import os
+import random
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+import zlib
+
+import uploader
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SLOT_SIZE = 0x6000
+HEADER_SIZE = 0x100
+
+
+class FaultyPort(uploader.Port):
+    """A Port that loses and corrupts what it's told to, and remembers what came back.
+
+    `faults` maps the index of a frame sent (counting from 0) to "drop" or "corrupt", and
+    `lost_responses` holds the indexes of responses that never arrive."""
+
+    def __init__(self, fd, faults=None, lost_responses=()):
+        super().__init__(fd)
+        self.faults = faults or {}
+        self.lost_responses = set(lost_responses)
+        self.sent = 0
+        self.received = 0
+        self.kinds = []
+
+    def send(self, data):
+        fault = self.faults.get(self.sent)
+        self.sent += 1
+        if fault == "drop":
+            return
+        if fault == "corrupt":
+            data = bytearray(data)
+            data[len(data) // 2] ^= 0x10
+            data = bytes(data)
+        super().send(data)
+
+    def responses(self, timeout):
+        for kind, offset in super().responses(timeout):
+            self.received += 1
+            if self.received - 1 in self.lost_responses:
+                continue
+            self.kinds.append(kind)
+            yield kind, offset
+
+
+class Device:
+    """One boot of the simulated device, receiving an update."""
+
+    def __init__(self, binary, flash, cut=None):
+        self.socket, device_end = socket.socketpair()
+        command = [binary, flash, "receive"]
+        if cut:
+            command += [str(cut[0]), cut[1]]
+        self.process = subprocess.Popen(command, stdin=device_end, stdout=device_end,
+                                        stderr=subprocess.PIPE)
+        device_end.close()
+
+    def port(self, **faults):
+        return FaultyPort(self.socket.fileno(), **faults)
+
+    def close(self):
+        """Wait for the device to exit. Returns its exit status and number of flash steps."""
+        self.socket.close()
+        _, errors = self.process.communicate(timeout=10)
+        steps = int(errors.decode().rsplit("steps: ", 1)[1])
+        return self.process.returncode, steps
+
+
+class UploaderTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.directory = tempfile.TemporaryDirectory()
+        cls.binary = os.path.join(cls.directory.name, "boot_test")
+        subprocess.run([os.environ.get("CC", "gcc"), "-O2", "-Wall", "-Wextra", "-I", ROOT,
+                        os.path.join(ROOT, "lib", "boot_test.c"),
+                        os.path.join(ROOT, "lib", "boot.c"),
+                        os.path.join(ROOT, "lib", "crc.c"),
+                        "-o", cls.binary], check=True)
+        # Images of odd lengths, which load_image() pads to double words.
+        generator = random.Random(1)
+        cls.images = []
+        for i, size in enumerate([5003, 6500]):
+            path = os.path.join(cls.directory.name, "image_{}.bin".format("ab"[i]))
+            with open(path, "wb") as f:
+                f.write(bytes(generator.getrandbits(8) for _ in range(size)))
+            cls.images.append(uploader.load_image(path))
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def setUp(self):
+        self.flash = os.path.join(self.directory.name, "flash_{}.bin".format(self.id()))
+        if os.path.exists(self.flash):
+            os.remove(self.flash)
+
+    def boot(self):
+        """The slot FindBootSlot() picks and its sequence number, or None."""
+        result = subprocess.run([self.binary, self.flash, "boot"], check=True,
+                                capture_output=True)
+        words = result.stdout.decode().split()
+        return None if words == ["none"] else (words[0], int(words[1]))
+
+    def slot_contents(self, slot):
+        with open(self.flash, "rb") as f:
+            f.seek(slot * SLOT_SIZE)
+            return f.read(SLOT_SIZE)
+
+    def update(self, cut=None, faults=None, lost_responses=(), window=uploader.WINDOW):
+        """Run one upload. Returns the port, the device's exit status and flash steps, and the
+        sequence number uploader.finish() returned (None if it failed)."""
+        device = Device(self.binary, self.flash, cut)
+        port = device.port(faults=faults, lost_responses=lost_responses)
+        sequence = None
+        try:
+            slot = uploader.start(port, self.images, timeout=5)
+            uploader.send_image(port, self.images[slot], window, lambda done: None)
+            sequence = uploader.finish(port)
+        except (uploader.UpdateError, OSError):
+            pass
+        status, steps = device.close()
+        return port, status, steps, sequence
+
+    def check_slot(self, slot, sequence):
+        self.assertEqual(self.boot(), ("AB"[slot], sequence))
+        contents = self.slot_contents(slot)
+        image = self.images[slot]
+        magic, stored_sequence, size, crc = struct.unpack_from("<IIII", contents)
+        self.assertEqual(magic, 0x474D4931)
+        self.assertEqual(stored_sequence, sequence)
+        self.assertEqual(size, len(image))
+        self.assertEqual(crc, zlib.crc32(image))
+        self.assertEqual(contents[HEADER_SIZE:HEADER_SIZE + len(image)], image)
+
+    def test_updates_alternate_slots(self):
+        self.assertIsNone(self.boot())
+        for i, slot in enumerate([0, 1, 0]):
+            _, status, _, sequence = self.update()
+            self.assertEqual((status, sequence), (0, i + 1))
+            self.check_slot(slot, i + 1)
+
+    def test_dropped_frames(self):
+        # Frame 0 is the start frame. The frame after a gap gets a NAK, and the sender goes back to
+        # where the device asks, without waiting for a timeout.
+        faults = {3: "drop", 12: "drop", 13: "drop", 20: "drop"}
+        port, status, _, sequence = self.update(faults=faults)
+        self.assertEqual((status, sequence), (0, 1))
+        self.assertIn(uploader.NAK, port.kinds)
+        self.check_slot(0, 1)
+
+    def test_corrupted_frames(self):
+        # In the middle of a window, back to back, and on a resend after the NAK.
+        faults = {3: "corrupt", 6: "corrupt", 7: "corrupt", 9: "corrupt", 20: "corrupt"}
+        port, status, _, sequence = self.update(faults=faults)
+        self.assertEqual((status, sequence), (0, 1))
+        self.assertIn(uploader.NAK, port.kinds)
+        self.check_slot(0, 1)
+
+    def test_lost_acknowledgements(self):
+        # The sender times out and resends from the last acknowledgement it saw, and the device
+        # acknowledges the repeats again.
+        port, status, _, sequence = self.update(lost_responses=range(1, 12))
+        self.assertEqual((status, sequence), (0, 1))
+        self.check_slot(0, 1)
+
+    def test_lost_finish(self):
+        faults = {len(self.images[0]) // uploader.MAX_PAYLOAD + 2: "drop"}
+        _, status, _, sequence = self.update(faults=faults)
+        self.assertEqual((status, sequence), (0, 1))
+        self.check_slot(0, 1)
+
+    def test_repeated_start(self):
+        # The first kUpdateReady is lost, so start() sends the start frame again. The device answers
+        # with the same slot and doesn't erase it twice.
+        _, _, clean_steps, _ = self.update()
+        os.remove(self.flash)
+        port, status, steps, sequence = self.update(lost_responses=[0])
+        self.assertEqual((status, sequence), (0, 1))
+        self.assertEqual(port.kinds.count(uploader.READY), 1)
+        self.assertEqual(steps, clean_steps)
+        self.check_slot(0, 1)
+
+    def test_start_repeated_after_data_starts_over(self):
+        # A start frame after data has come in is a new update: the slot is erased again.
+        device = Device(self.binary, self.flash)
+        port = device.port()
+        slot = uploader.start(port, self.images, timeout=5)
+        port.send(uploader.frame(uploader.DATA, 0, self.images[slot][:uploader.MAX_PAYLOAD]))
+        self.assertEqual(uploader.start(port, self.images, timeout=5), slot)
+        uploader.send_image(port, self.images[slot], uploader.WINDOW, lambda done: None)
+        self.assertEqual(uploader.finish(port), 1)
+        status, _ = device.close()
+        self.assertEqual(status, 0)
+        self.check_slot(0, 1)
+
+    def test_interrupted_update_keeps_the_old_image(self):
+        self.update()
+        self.check_slot(0, 1)
+        with open(self.flash, "rb") as f:
+            first = f.read()
+        # Count the steps of a clean update into slot B: the erases, the image, then the header's
+        # size and CRC double word and last its magic and sequence number. Cut during the first
+        # erase, halfway through the image, on its last double word and on both of the header's.
+        _, _, steps, _ = self.update()
+        self.check_slot(1, 2)
+        for step in [1, steps // 2, steps - 2, steps - 1, steps]:
+            for mode in ["before", "torn", "after"]:
+                with self.subTest(step=step, mode=mode):
+                    with open(self.flash, "wb") as f:
+                        f.write(first)
+                    _, status, _, sequence = self.update(cut=(step, mode))
+                    self.assertEqual(status, 2)
+                    self.assertIsNone(sequence)
+                    if step == steps and mode == "after":
+                        # The magic word made it, so the new image is complete.
+                        self.assertEqual(self.boot(), ("B", 2))
+                    else:
+                        self.assertEqual(self.boot(), ("A", 1))
+
+    def test_corrupted_image_falls_back(self):
+        # FindBootSlot() checks the newer image's CRC, not just its header.
+        self.update()
+        self.update()
+        self.check_slot(1, 2)
+        with open(self.flash, "r+b") as f:
+            f.seek(SLOT_SIZE + HEADER_SIZE + 100)
+            byte = f.read(1)[0]
+            f.seek(SLOT_SIZE + HEADER_SIZE + 100)
+            f.write(bytes([byte ^ 1]))
+        self.assertEqual(self.boot(), ("A", 1))
+
+    def test_interrupted_finish_then_retry(self):
+        # Cut on the magic word, torn, then update again: the torn header has to be erased and the
+        # retry has to go to the same slot, since the old image is still the one that boots.
+        self.update()
+        _, _, steps, _ = self.update()
+        os.remove(self.flash)
+        self.update()
+        _, status, _, _ = self.update(cut=(steps, "torn"))
+        self.assertEqual(status, 2)
+        self.assertEqual(self.boot(), ("A", 1))
+        _, status, _, sequence = self.update()
+        self.assertEqual((status, sequence), (0, 2))
+        self.check_slot(1, 2)
+
+
+if __name__ == "__main__":
+    sys.exit(unittest.main())
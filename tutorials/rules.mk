@@ -8,8 +8,20 @@ OBJCOPY = $(PREFIX)-objcopy
 # memory constrained embedded systems.
 CFLAGS = -mcpu=cortex-m0plus -mthumb
 
-# Include debugging info in the output file and turn off compiler optimizations (for now).
-CFLAGS += -g -O0
+# Include debugging info in the output file. It doesn't take up any flash, only space in the .elf.
+CFLAGS += -g
+
+# Optimization profiles, the same as the Bazel rules' compilation modes (see rules.bzl). The
+# default, `fastbuild`, and `dbg` turn compiler optimizations off, which keeps the generated code
+# easy to follow in a debugger. `opt` optimizes for size. Pick one with e.g. `make MODE=opt`.
+MODE ?= fastbuild
+MODE_CFLAGS_fastbuild = -O0
+MODE_CFLAGS_dbg = -O0
+MODE_CFLAGS_opt = -Os
+ifeq ($(origin MODE_CFLAGS_$(MODE)),undefined)
+$(error Unknown MODE "$(MODE)", use fastbuild, dbg or opt)
+endif
+CFLAGS += $(MODE_CFLAGS_$(MODE))
 
 # Enable compiler warnings.
 CFLAGS += -Wall -Wextra
@@ -25,27 +37,74 @@ LDFLAGS = -nostartfiles
 # specific parts of libc and libgcc if needed (e.g., for custom implementation of printf).
 LDFLAGS += --specs=nano.specs --specs=nosys.specs -lc -lgcc
 
+# Optionally replace newlib-nano's byte at a time memcpy, memset and memmove with the word based
+# ones in lib/mem.c. Set MEM to `speed` or `size` in the project's Makefile (or `make MEM=speed`),
+# or leave it unset to keep newlib's.
+ROOT := $(dir $(lastword $(MAKEFILE_LIST)))..
+MEM_SOURCES = $(if $(filter speed size,$(MEM)),$(ROOT)/lib/mem.c)
+MEM_CFLAGS = $(if $(filter speed size,$(MEM)),-I$(ROOT) -DMEM_REPLACE_LIBC)
+MEM_CFLAGS += $(if $(filter size,$(MEM)),-DMEM_OPTIMIZE_SIZE)
+
 # Remove unused data and code after everything is linked together to reduce binary size.
 LDFLAGS += -Wl,--gc-sections
 
 # Print firmware image size after linking.
 LDFLAGS += -Wl,--print-memory-usage
 
+# The rules below need the project's SOURCES and LDSCRIPT, so include this file at the end of the
+# project's Makefile, after setting them.
+ifeq ($(strip $(SOURCES)),)
+$(error Set SOURCES before including rules.mk)
+endif
+
+# Everything the build makes goes in a directory per MODE, out of the source tree, so switching
+# modes doesn't mix up objects built with different flags. Set BUILD_ROOT to put them elsewhere.
+BUILD_ROOT ?= build
+BUILD_DIR = $(BUILD_ROOT)/$(MODE)
+
 # Output files.
-ELF = firmware.elf
-BIN = firmware.bin
+ELF = $(BUILD_DIR)/firmware.elf
+BIN = $(BUILD_DIR)/firmware.bin
+
+# Each source compiles to its own object, so a change only recompiles the sources it affects, and
+# `make -j` compiles them in parallel. Objects mirror the sources' paths under the build directory,
+# with `..` spelled `__` so sources from outside the project (like lib/mem.c) stay inside it too.
+object = $(BUILD_DIR)/$(subst ../,__/,$(basename $(1))).o
+OBJECTS = $(foreach source,$(SOURCES) $(MEM_SOURCES),$(call object,$(source)))
+
+# Have the compiler write out which headers each source includes (-MMD), as a makefile next to the
+# object that gets included below, so editing a header recompiles the sources that include it.
+# -MP adds an empty rule for each header, so deleting one doesn't break the build.
+DEPFLAGS = -MMD -MP
 
-# Compile and link sources into a .elf.
-$(ELF): $(SOURCES)
-	$(CC) $(CFLAGS) $(LDFLAGS) -T ${LDSCRIPT} $(SOURCES) -o $@
+# Changing the flags (a different MEM, say) has to rebuild everything too, and make only looks at
+# timestamps. So the flags go in a file that's rewritten whenever they change, and every object
+# depends on it.
+FLAGS_FILE = $(BUILD_DIR)/flags
+$(FLAGS_FILE): FORCE
+	@mkdir -p $(@D)
+	@echo '$(CFLAGS) $(MEM_CFLAGS)' | cmp -s - $@ || echo '$(CFLAGS) $(MEM_CFLAGS)' > $@
+
+define COMPILE_RULE
+$(call object,$(1)): $(1) $(FLAGS_FILE)
+	@mkdir -p $$(@D)
+	$$(CC) $$(CFLAGS) $$(MEM_CFLAGS) $$(DEPFLAGS) -c $$< -o $$@
+endef
+$(foreach source,$(SOURCES) $(MEM_SOURCES),$(eval $(call COMPILE_RULE,$(source))))
+
+-include $(OBJECTS:.o=.d)
+
+# Link the objects into a .elf.
+$(ELF): $(OBJECTS) $(LDSCRIPT)
+	$(CC) $(CFLAGS) -T $(LDSCRIPT) $(OBJECTS) $(LDFLAGS) -o $@
 
 # Convert the .elf to a simple binary .bin for flashing.
 $(BIN): $(ELF)
 	$(OBJCOPY) -O binary $< $@
 
-# Remove intermediate and output build files for a fresh build.
+# Remove intermediate and output build files, of every MODE, for a fresh build.
 clean:
-	rm -rf $(ELF) $(BIN)
+	rm -rf $(BUILD_ROOT)
 
 # Flash the final .bin to the STM32G031 Nucleo board via the onboard ST-Link programmer.
 flash: $(BIN)
@@ -53,4 +112,8 @@ flash: $(BIN)
 
 all: $(ELF)
 
-.PHONY: all clean flash
+.DEFAULT_GOAL := all
+
+FORCE:
+
+.PHONY: all clean flash FORCE